@@ -0,0 +1,188 @@
+# Name:    aio.py
+# Purpose: Asyncio facade for Nansat
+# Licence:
+# This file is part of NANSAT.
+# NANSAT is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3 of the License.
+# http://www.gnu.org/licenses/gpl-3.0.html
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+"""Asyncio facade for Nansat (Python 3.5+)
+
+Blocking Nansat calls run on a shared thread pool (Executor), so the event
+loop is not blocked and the number of threads is bounded. The number of
+simultaneous calls per source file is limited by an asyncio.Semaphore.
+
+GDAL datasets must not be used from several threads at once. Reading of
+bands uses a GDAL dataset opened in each worker thread from the VRT of the
+Nansat object; reading is done in blocks of lines and is stopped between
+blocks when the awaiting task is cancelled. Other calls (reproject, export,
+write_figure) use the Nansat object itself under a lock and run to the end
+even if cancelled.
+
+Examples
+--------
+>>> from nansat.aio import AsyncNansat
+>>> async def process(filename):
+...     n = await AsyncNansat.open(filename)
+...     a = await n.read('sigma0_HH')
+...     w = await n.read_window('sigma0_HH', 0, 0, 512, 512)
+...     await n.export('out.nc')
+
+"""
+from __future__ import absolute_import
+import os
+import asyncio
+import functools
+import threading
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+
+from nansat.nansat import Nansat
+from nansat.prefetch import thread_dataset
+from nansat.exceptions import NansatGDALError
+
+_executor = None
+
+# asyncio.get_running_loop is available from Python 3.7, get_event_loop
+# returns the running loop when called from a coroutine on 3.5 and 3.6
+_get_running_loop = getattr(asyncio, 'get_running_loop', asyncio.get_event_loop)
+
+
+class Executor(object):
+    """Thread pool with limit of simultaneous calls per source file"""
+
+    def __init__(self, max_workers=None, per_source=2):
+        """Create executor
+
+        Parameters
+        ----------
+        max_workers : int
+            number of threads. Default is number of CPUs + 4 (max 32)
+        per_source : int
+            maximum number of simultaneous calls for one source file
+
+        """
+        if max_workers is None:
+            max_workers = min(32, (os.cpu_count() or 1) + 4)
+        self.pool = ThreadPoolExecutor(max_workers)
+        self.per_source = per_source
+        self.semaphores = {}
+
+    async def run(self, source, func, *args, **kwargs):
+        """Run func(*args, **kwargs) in a thread, at most per_source at once for source"""
+        if source not in self.semaphores:
+            self.semaphores[source] = [asyncio.Semaphore(self.per_source), 0]
+        semaphore = self.semaphores[source]
+        semaphore[1] += 1
+        try:
+            async with semaphore[0]:
+                return await _get_running_loop().run_in_executor(
+                    self.pool, functools.partial(func, *args, **kwargs))
+        finally:
+            semaphore[1] -= 1
+            if semaphore[1] == 0:
+                del self.semaphores[source]
+
+    def shutdown(self, wait=True):
+        self.pool.shutdown(wait)
+
+
+def get_executor():
+    """Return default executor (created at first use)"""
+    global _executor
+    if _executor is None:
+        _executor = Executor()
+    return _executor
+
+
+class AsyncNansat(object):
+    """Awaitable wrapper of Nansat object"""
+
+    def __init__(self, nansat, executor=None):
+        """Wrap existing Nansat object. Use AsyncNansat.open() to open a file"""
+        self.nansat = nansat
+        self.executor = executor or get_executor()
+        # protects GDAL dataset of the Nansat object
+        self.lock = threading.Lock()
+
+    @classmethod
+    async def open(cls, filename, mapper='', executor=None, **kwargs):
+        """Open file with Nansat in a thread and return AsyncNansat"""
+        executor = executor or get_executor()
+        nansat = await executor.run(filename, Nansat, filename, mapper=mapper, **kwargs)
+        return cls(nansat, executor)
+
+    async def _run_locked(self, func, *args, **kwargs):
+        def locked():
+            with self.lock:
+                return func(*args, **kwargs)
+        return await self.executor.run(self.nansat.filename, locked)
+
+    async def read(self, band_id=1, block_lines=256):
+        """Read band as Nansat.__getitem__ does"""
+        return await self.read_window(band_id, block_lines=block_lines)
+
+    async def read_window(self, band_id=1, x_off=0, y_off=0, x_size=None, y_size=None,
+                          block_lines=256):
+        """Read window of band in blocks of <block_lines> lines
+
+        Fill values, infs and out-of-swath pixels are replaced with NaN as in
+        Nansat.__getitem__. Full band is read if x_size, y_size are None.
+        """
+        cancel = threading.Event()
+        try:
+            return await self.executor.run(self.nansat.filename, self._read_window, band_id,
+                                           x_off, y_off, x_size, y_size, block_lines, cancel)
+        except asyncio.CancelledError:
+            cancel.set()
+            raise
+
+    def _read_window(self, band_id, x_off, y_off, x_size, y_size, block_lines, cancel):
+        """Read window in the current thread, stop between blocks if cancel is set"""
+        with self.lock:
+            band_number = self.nansat.get_band_number(band_id)
+            swath_number = None
+            if self.nansat.has_band('swathmask'):
+                swath_number = self.nansat.get_band_number('swathmask')
+            # make sure XML in /vsimem is up to date
+            self.nansat.vrt.dataset.FlushCache()
+            dataset = thread_dataset(self.nansat.vrt.filename,
+                                     self.nansat.vrt.dataset.RasterCount)
+        x_size = dataset.RasterXSize - x_off if x_size is None else x_size
+        y_size = dataset.RasterYSize - y_off if y_size is None else y_size
+
+        def read_blocks(band):
+            band_data = None
+            for line in range(y_off, y_off + y_size, block_lines):
+                if cancel.is_set():
+                    raise asyncio.CancelledError()
+                lines = min(block_lines, y_off + y_size - line)
+                block = band.ReadAsArray(x_off, line, x_size, lines)
+                if block is None:
+                    raise NansatGDALError('Cannot read array from band %s' % str(band_id))
+                if band_data is None:
+                    band_data = np.empty((y_size, x_size), block.dtype)
+                band_data[line - y_off:line - y_off + lines] = block
+            return band_data
+
+        band = dataset.GetRasterBand(band_number)
+        band_data = read_blocks(band)
+        with self.lock:
+            return self.nansat._finalize_band_data(
+                band, band_data, lambda: read_blocks(dataset.GetRasterBand(swath_number)))
+
+    async def reproject(self, *args, **kwargs):
+        """Call Nansat.reproject in a thread"""
+        return await self._run_locked(self.nansat.reproject, *args, **kwargs)
+
+    async def export(self, *args, **kwargs):
+        """Call Nansat.export in a thread"""
+        return await self._run_locked(self.nansat.export, *args, **kwargs)
+
+    async def write_figure(self, *args, **kwargs):
+        """Call Nansat.write_figure in a thread"""
+        return await self._run_locked(self.nansat.write_figure, *args, **kwargs)
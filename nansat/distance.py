@@ -0,0 +1,243 @@
+# Name:    distance.py
+# Purpose: Distance to the nearest land pixel on the grid of a Domain
+# Licence:
+# This file is part of NANSAT.
+# NANSAT is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3 of the License.
+# http://www.gnu.org/licenses/gpl-3.0.html
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+"""Distance to the nearest land pixel (distance to coast) on a Domain grid
+
+Distances are computed with the exact Euclidean distance transform (EDT) of
+Felzenszwalb and Huttenlocher: a pass along columns gives squared distances
+to the nearest land pixel in the same column, a pass along lines combines
+them into squared distances to the nearest land pixel in the image. Each pass
+finds the lower envelope of parabolas in one line in linear time.
+
+Samples of a line are placed at their metric positions: the size of pixels
+(meters) is computed with the transformer of the Domain on a coarse grid,
+interpolated to each pixel and accumulated along lines and columns. Distances
+are therefore correct for grids with varying pixel size (e.g. lon/lat grids
+or swaths with GCPs), as long as the grid is not strongly sheared.
+
+The passes are computed by the C extension nansat._edt (compiled by
+setup.py) in tiles of lines, in several threads (the extension releases the
+GIL). Without the extension a (slow) pure Python implementation is used.
+
+Examples
+--------
+>>> from nansat.distance import distance_to_land
+>>> d = Domain(4326, '-te 5 58 12 62 -tr 0.002 0.002')
+>>> wm = Nansat.from_domain(d).watermask()
+>>> dist = distance_to_land(d, wm)
+>>> dist['distance_to_coast']
+
+"""
+from __future__ import absolute_import, division
+import multiprocessing
+
+try:
+    from concurrent.futures import ThreadPoolExecutor
+except ImportError:
+    ThreadPoolExecutor = None
+
+import numpy as np
+
+from nansat.nansat import Nansat
+from nansat.utils import haversine
+
+try:
+    from nansat import _edt
+except ImportError:
+    _edt = None
+
+
+def _envelope_python(f, positions, lines, length, out):
+    """Same as nansat._edt.envelope, but in pure Python (slow)"""
+    for line in range(lines):
+        fl, p, d = f[line], positions[line], out[line]
+        v, z = [], []
+        for q in range(length):
+            if not np.isfinite(fl[q]):
+                continue
+            s = -np.inf
+            while v:
+                k = v[-1]
+                s = ((fl[q] - fl[k]) + (p[q] - p[k]) * (p[q] + p[k])) / (2. * (p[q] - p[k]))
+                if s > z[-1]:
+                    break
+                v.pop()
+                z.pop()
+                s = -np.inf
+            v.append(q)
+            z.append(s)
+        if not v:
+            d[:] = np.inf
+            continue
+        z.append(np.inf)
+        k = 0
+        for q in range(length):
+            while z[k + 1] < p[q]:
+                k += 1
+            d[q] = (p[q] - p[v[k]]) ** 2 + fl[v[k]]
+
+
+def envelope(f, positions):
+    """Squared distance transform along lines of f
+
+    Parameters
+    ----------
+    f : numpy.ndarray
+        2D array with 0 for land (feature) pixels, inf for other pixels or
+        squared distances from the previous pass
+    positions : numpy.ndarray
+        2D array with increasing coordinates of pixels along lines (meters)
+
+    Returns
+    -------
+    d : numpy.ndarray
+        d[l, q] = min_k f[l, k] + (positions[l, q] - positions[l, k])**2
+
+    """
+    f = np.ascontiguousarray(f, np.float64)
+    positions = np.ascontiguousarray(positions, np.float64)
+    out = np.empty(f.shape, np.float64)
+    lines, length = f.shape
+    if _edt is None:
+        _envelope_python(f, positions, lines, length, out)
+    else:
+        _edt.envelope(f, positions, lines, length, out)
+    return out
+
+
+def pixel_sizes(domain, step=32):
+    """Size of pixels (meters) along X and Y axes on a coarse grid
+
+    Parameters
+    ----------
+    domain : Domain
+        input domain
+    step : int
+        size of cells of the coarse grid (pixels)
+
+    Returns
+    -------
+    rows, cols : numpy.ndarray
+        pixel/line coordinates of the centers of the cells
+    dx, dy : numpy.ndarray
+        2D arrays with size of pixels along X and Y axes in the centers
+
+    """
+    height, width = domain.shape()
+    rows = (np.arange(int(np.ceil(height / float(step)))) + 0.5) * step
+    cols = (np.arange(int(np.ceil(width / float(step)))) + 0.5) * step
+    rows = np.minimum(rows, height - 0.5)
+    cols = np.minimum(cols, width - 0.5)
+    grid_rows, grid_cols = [grid.ravel() for grid in np.meshgrid(rows, cols, indexing='ij')]
+
+    def size(x0, y0, x1, y1):
+        lon0, lat0 = domain.transform_points(x0, y0)
+        lon1, lat1 = domain.transform_points(x1, y1)
+        with np.errstate(invalid='ignore'):
+            size = haversine(lon0, lat0, lon1, lat1)
+        valid = np.isfinite(size) & (size > 0)
+        if not valid.any():
+            raise ValueError('Size of pixels can not be computed from geolocation of the Domain')
+        size[~valid] = np.median(size[valid])
+        return size.reshape(len(rows), len(cols))
+
+    dx = size(grid_cols - 0.5, grid_rows, grid_cols + 0.5, grid_rows)
+    dy = size(grid_cols, grid_rows - 0.5, grid_cols, grid_rows + 0.5)
+    return rows, cols, dx, dy
+
+
+def _interpolate(values, rows, cols, dst_rows, dst_cols):
+    """Bilinear interpolation of a coarse grid into dst_rows x dst_cols pixels"""
+    values = np.array([np.interp(dst_cols, cols, line) for line in values])
+    return np.array([np.interp(dst_rows, rows, column) for column in values.T]).T
+
+
+def _positions(sizes):
+    """Coordinates of pixels along lines from sizes of pixels"""
+    positions = np.zeros(sizes.shape)
+    positions[:, 1:] = np.cumsum(0.5 * (sizes[:, 1:] + sizes[:, :-1]), axis=1)
+    return positions
+
+
+def distance_to_land(domain, mask=None, land_values=(0,), threads=None, step=32, tile_lines=256):
+    """Compute distance to the nearest land pixel on the grid of a Domain
+
+    Parameters
+    ----------
+    domain : Domain
+        destination domain
+    mask : Nansat or numpy.ndarray
+        mask with the shape of domain. Boolean array: True for land. Other
+        arrays or the first band of Nansat: land pixels have one of land_values.
+        Nansat.watermask(dst_domain=domain) is used if None
+    land_values : list
+        values of land pixels in mask (0 in the watermask from Nansat.watermask)
+    threads : int
+        number of threads. Number of CPUs if None
+    step : int
+        size of cells (pixels) of the coarse grid of pixel sizes
+    tile_lines : int
+        number of lines computed by one task
+
+    Returns
+    --------
+    distance : Nansat
+        object on the grid of domain with band 'distance_to_coast': distance
+        to the nearest land pixel (km), 0 on land, NaN if there is no land
+
+    """
+    if mask is None:
+        mask = Nansat.from_domain(domain).watermask(dst_domain=domain)
+    if isinstance(mask, Nansat):
+        mask = mask[1]
+    mask = np.asarray(mask)
+    if mask.shape != domain.shape():
+        raise ValueError('Shape of mask %s differs from shape of domain %s' %
+                         (str(mask.shape), str(domain.shape())))
+    if mask.dtype == bool:
+        land = mask
+    else:
+        land = np.isin(mask, land_values)
+
+    height, width = land.shape
+    rows, cols, dx, dy = pixel_sizes(domain, step)
+    squared = np.empty((height, width), np.float64)
+    distance = np.empty((height, width), np.float32)
+
+    def column_pass(col0, col1):
+        f = np.where(land[:, col0:col1].T, 0., np.inf)
+        sizes = _interpolate(dy, rows, cols, np.arange(height) + 0.5, np.arange(col0, col1) + 0.5)
+        squared[:, col0:col1] = envelope(f, _positions(sizes.T)).T
+
+    def line_pass(row0, row1):
+        sizes = _interpolate(dx, rows, cols, np.arange(row0, row1) + 0.5, np.arange(width) + 0.5)
+        result = np.sqrt(envelope(squared[row0:row1], _positions(sizes))) / 1000.
+        result[~np.isfinite(result)] = np.nan
+        distance[row0:row1] = result
+
+    pool = None
+    if ThreadPoolExecutor is not None:
+        pool = ThreadPoolExecutor(threads or multiprocessing.cpu_count())
+    try:
+        for compute, size in [(column_pass, width), (line_pass, height)]:
+            tiles = [(start, min(start + tile_lines, size)) for start in range(0, size, tile_lines)]
+            if pool is None:
+                for start, stop in tiles:
+                    compute(start, stop)
+            else:
+                for future in [pool.submit(compute, start, stop) for start, stop in tiles]:
+                    future.result()
+    finally:
+        if pool is not None:
+            pool.shutdown(wait=True)
+
+    return Nansat.from_domain(domain, distance, {'name': 'distance_to_coast',
+                                                  'units': 'km'})
@@ -236,6 +236,28 @@ class Domain(object):
         out_str += corners_temp % (corners[0][1], corners[1][1], corners[0][3], corners[1][3])
         return out_str
 
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def close(self):
+        """Release the VRTs of the object immediately (see VRT.close)
+
+        Files in /vsimem and GDAL datasets are released without waiting for
+        garbage collection. The object can not be used after that.
+
+        Examples
+        --------
+        >>> with Nansat(filename) as n:
+        >>>     a = n[1]
+
+        """
+        if self.vrt is not None:
+            self.vrt.close()
+        self.vrt = None
+
     def write_kml(self, xmlFileName=None, kmlFileName=None):
         """Write KML file with domains
 
@@ -854,6 +876,46 @@ class Domain(object):
         a = np.vstack((a, a[-1, :]))
         return a
 
+    def rotation_angle(self, dst_domain, step=16):
+        """Calculate angle between pixel axes of self and of dst_domain on a coarse grid
+
+        The angle is computed in centers of cells of step x step pixels of dst_domain. Each center
+        is transformed to lon/lat and into pixel/line of self. Azimuths of the X-axes of both
+        domains are found from points half a pixel away along the X-axis. A grid-relative vector
+        (u, v) of self, with v directed 90 degrees counter-clockwise from u, is converted to a
+        grid-relative vector of dst_domain by counter-clockwise rotation by the angle.
+
+        Parameters
+        -----------
+        dst_domain : Domain
+            destination domain
+        step : int
+            size of cells of the coarse grid (pixels of dst_domain)
+
+        Returns
+        -------
+        angle : numpy array
+            ceil(ySize / step) x ceil(xSize / step) array with angles in degrees in
+            range -180 - 180. Zero where points can not be transformed.
+
+        """
+        y_size, x_size = dst_domain.shape()
+        shape = (int(np.ceil(y_size / float(step))), int(np.ceil(x_size / float(step))))
+        rows, cols = [(grid.ravel() + 0.5) * step for grid in np.indices(shape)]
+
+        def x_azimuth(domain, x, y):
+            lon0, lat0 = domain.transform_points(x, y)
+            lon1, lat1 = domain.transform_points(x + 0.5, y)
+            return initial_bearing(lon0, lat0, lon1, lat1)
+
+        lon, lat = dst_domain.transform_points(cols, rows)
+        src_cols, src_rows = self.transform_points(lon, lat, DstToSrc=1)
+        with np.errstate(invalid='ignore'):
+            angle = x_azimuth(dst_domain, cols, rows) - x_azimuth(self, src_cols, src_rows)
+            angle = (angle + 180.) % 360. - 180.
+        angle[~np.isfinite(angle)] = 0
+        return angle.reshape(shape)
+
     def shape(self):
         """Return Numpy-like shape of Domain object (ySize, xSize)
 
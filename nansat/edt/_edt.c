@@ -0,0 +1,147 @@
+/******************************************************************************
+ *
+ * Project:  NANSAT
+ * Purpose:  One-dimensional pass of the exact Euclidean distance transform
+ *           (lower envelope of parabolas, Felzenszwalb and Huttenlocher) with
+ *           arbitrary positions of samples along lines.
+ *           Used by nansat/distance.py
+ *
+ ******************************************************************************
+ * This file is part of NANSAT. You can redistribute it or modify
+ * under the terms of GNU General Public License, v.3
+ * http://www.gnu.org/licenses/gpl-3.0.html
+ *****************************************************************************/
+
+#include <Python.h>
+#include <math.h>
+#include <stdlib.h>
+
+/* Squared distance transform of one line:
+ * d[q] = min_k f[k] + (p[q] - p[k])^2 for finite f[k], infinity if there is none.
+ * Positions p must increase. v and z are work arrays of n and n + 1 elements. */
+static void envelope_line(const double *f, const double *p, Py_ssize_t n, double *d,
+                          Py_ssize_t *v, double *z)
+{
+    Py_ssize_t q, k = -1;
+    double s;
+
+    for (q = 0; q < n; q++) {
+        if (!(f[q] < HUGE_VAL))
+            continue;
+        if (k < 0) {
+            k = 0;
+            v[0] = q;
+            z[0] = -HUGE_VAL;
+            z[1] = HUGE_VAL;
+            continue;
+        }
+        /* intersection with the rightmost parabola of the envelope */
+        while (1) {
+            s = ((f[q] - f[v[k]]) + (p[q] - p[v[k]]) * (p[q] + p[v[k]])) /
+                (2. * (p[q] - p[v[k]]));
+            if (s > z[k] || k == 0)
+                break;
+            k--;
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = HUGE_VAL;
+    }
+
+    if (k < 0) {
+        for (q = 0; q < n; q++)
+            d[q] = HUGE_VAL;
+        return;
+    }
+    k = 0;
+    for (q = 0; q < n; q++) {
+        while (z[k + 1] < p[q])
+            k++;
+        d[q] = (p[q] - p[v[k]]) * (p[q] - p[v[k]]) + f[v[k]];
+    }
+}
+
+static char envelope_docstring[] =
+    "envelope(f, positions, lines, length, out)\n\n"
+    "Compute squared distance transform along each line:\n"
+    "out[l, q] = min_k f[l, k] + (positions[l, q] - positions[l, k])^2\n"
+    "f : float64 buffer of lines x length values (0 for feature pixels, inf for others,\n"
+    "    or squared distances from the previous pass)\n"
+    "positions : float64 buffer of lines x length increasing coordinates along lines\n"
+    "out : float64 buffer of lines x length\n"
+    "The GIL is released during computation.";
+
+static PyObject *envelope(PyObject *self, PyObject *args)
+{
+    Py_buffer f, positions, out;
+    Py_ssize_t lines, length, line;
+    Py_ssize_t *v = NULL;
+    double *z = NULL;
+    PyObject *result = NULL;
+
+    if (!PyArg_ParseTuple(args, "s*s*nnw*", &f, &positions, &lines, &length, &out))
+        return NULL;
+
+    if (lines < 0 || length < 1) {
+        PyErr_SetString(PyExc_ValueError, "Wrong number of lines or length");
+        goto done;
+    }
+    if (f.len < (Py_ssize_t)(lines * length * sizeof(double)) ||
+            positions.len < (Py_ssize_t)(lines * length * sizeof(double)) ||
+            out.len < (Py_ssize_t)(lines * length * sizeof(double))) {
+        PyErr_SetString(PyExc_ValueError, "Buffer is smaller than lines x length");
+        goto done;
+    }
+
+    v = (Py_ssize_t *)malloc(length * sizeof(Py_ssize_t));
+    z = (double *)malloc((length + 1) * sizeof(double));
+    if (v == NULL || z == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (line = 0; line < lines; line++)
+        envelope_line((const double *)f.buf + line * length,
+                      (const double *)positions.buf + line * length,
+                      length, (double *)out.buf + line * length, v, z);
+    Py_END_ALLOW_THREADS
+
+    Py_INCREF(Py_None);
+    result = Py_None;
+
+done:
+    free(v);
+    free(z);
+    PyBuffer_Release(&f);
+    PyBuffer_Release(&positions);
+    PyBuffer_Release(&out);
+    return result;
+}
+
+static PyMethodDef module_methods[] = {
+    {"envelope", (PyCFunction)envelope, METH_VARARGS, envelope_docstring},
+    {NULL, NULL, 0, NULL}
+};
+
+#if PY_MAJOR_VERSION >= 3
+static struct PyModuleDef _edt =
+{
+    PyModuleDef_HEAD_INIT,
+    "_edt", /* name of module */
+    "Euclidean distance transform", /* module documentation */
+    -1,
+    module_methods
+};
+
+PyMODINIT_FUNC PyInit__edt(void)
+{
+    return PyModule_Create(&_edt);
+}
+#else
+PyMODINIT_FUNC init_edt(void)
+{
+    Py_InitModule3("_edt", module_methods, "Euclidean distance transform");
+}
+#endif
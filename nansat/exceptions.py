@@ -31,3 +31,14 @@ class WrongMapperError(Exception):
     """ Error for handling data that does not fit a given mapper """
     pass
 
+
+class NansatServiceError(Exception):
+    """ Error returned by the Nansat worker service """
+    def __init__(self, message, status=500):
+        super(NansatServiceError, self).__init__(message)
+        self.status = status
+
+class NansatServiceBusyError(NansatServiceError):
+    """ Request is rejected by the service due to concurrency or memory limits """
+    def __init__(self, message):
+        super(NansatServiceBusyError, self).__init__(message, 503)
@@ -27,6 +27,10 @@ from netCDF4 import Dataset
 from nansat.vrt import VRT
 from nansat.node import Node
 from nansat.utils import NUMPY_TO_GDAL_TYPE_MAP
+from nansat import tracing
+from nansat import iostats
+from nansat import memprofile
+from nansat import prefetch
 
 from nansat.exceptions import NansatGDALError
 
@@ -39,8 +43,14 @@ class Exporter(object):
     UNWANTED_METADATA = ['dataType', 'SourceFilename', 'SourceBand', '_Unsigned', 'FillValue',
                          '_FillValue', 'type', 'scale', 'offset', 'NETCDF_VARNAME']
 
+    @tracing.traced('Nansat.export',
+                    lambda self, filename='', bands=None, *args, **kwargs: {
+                        'file': self.filename, 'filename': filename, 'bands': bands})
+    @iostats.recorded('export')
+    @memprofile.profiled('export')
     def export(self, filename='', bands=None, rm_metadata=None, add_geolocation=True,
-               driver='netCDF', options='FORMAT=NC4', hardcopy=False):
+               driver='netCDF', options='FORMAT=NC4', hardcopy=False, prefetch=0,
+               prefetch_memory=None, staging_pool=None):
         """Export Nansat object into netCDF or GTiff file
 
         Parameters
@@ -64,6 +74,17 @@ class Exporter(object):
             See also http://www.gdal.org/frmt_netcdf.html
         hardcopy : bool
             Evaluate all bands just before export?
+        prefetch : int
+            Write bands in blocks of lines with <prefetch> blocks read ahead in
+            background threads. Useful for slow sources (/vsizip, /vsitar,
+            network file systems). Requires a driver with Create() and bands of
+            the same data type, otherwise bands are written by CreateCopy
+        prefetch_memory : int
+            maximum memory (bytes) of blocks read ahead
+        staging_pool : nansat.sharedmem.SharedBufferPool
+            Evaluate all bands just before export into shared memory buffers
+            of the pool (implies hardcopy). The buffers are not copied into
+            /vsimem and stay in the pool after export
 
         Returns
         -------
@@ -102,22 +123,31 @@ class Exporter(object):
         export_vrt.fix_band_metadata(rm_metadata)
         export_vrt.fix_global_metadata(rm_metadata)
 
-        # if output filename is the same as input one
-        if self.filename == filename or hardcopy:
-            export_vrt.hardcopy_bands()
+        try:
+            # if output filename is the same as input one
+            if self.filename == filename or hardcopy or staging_pool is not None:
+                export_vrt.hardcopy_bands(prefetch, max_memory=prefetch_memory, pool=staging_pool)
+                prefetch = 0
 
-        if driver == 'GTiff':
-            add_gcps = export_vrt.prepare_export_gtiff()
-        else:
-            add_gcps = export_vrt.prepare_export_netcdf()
+            if driver == 'GTiff':
+                add_gcps = export_vrt.prepare_export_gtiff()
+            else:
+                add_gcps = export_vrt.prepare_export_netcdf()
 
-        # Create output file using GDAL
-        dataset = gdal.GetDriverByName(driver).CreateCopy(filename, export_vrt.dataset,
-                                                          options=options)
-        del dataset
-        # add GCPs into netCDF file as separate float variables
-        if add_gcps:
-            Exporter._add_gcps(filename, export_vrt.dataset.GetGCPs())
+            # Create output file using GDAL
+            gdal_driver = gdal.GetDriverByName(driver)
+            if prefetch > 0 and Exporter._can_write_blocks(gdal_driver, export_vrt.dataset):
+                Exporter._write_blocks(gdal_driver, filename, export_vrt, options,
+                                       prefetch, prefetch_memory)
+            else:
+                dataset = gdal_driver.CreateCopy(filename, export_vrt.dataset, options=options)
+                del dataset
+            # add GCPs into netCDF file as separate float variables
+            if add_gcps:
+                Exporter._add_gcps(filename, export_vrt.dataset.GetGCPs())
+        finally:
+            # release temporary VRTs (e.g. hardcopy of bands) also if export fails
+            export_vrt.close()
 
         if driver=='netCDF':
             # Rename variable names to get rid of the band numbers
@@ -127,6 +157,44 @@ class Exporter(object):
 
         self.logger.debug('Export - OK!')
 
+    @staticmethod
+    def _can_write_blocks(gdal_driver, dataset):
+        """Can bands of dataset be written block by block with gdal_driver.Create()?"""
+        data_types = set(dataset.GetRasterBand(i).DataType
+                         for i in range(1, dataset.RasterCount + 1))
+        return (gdal_driver.GetMetadataItem(gdal.DCAP_CREATE) == 'YES' and
+                len(data_types) == 1)
+
+    @staticmethod
+    def _write_blocks(gdal_driver, filename, vrt, options, prefetch_depth, max_memory=None):
+        """Create file with gdal_driver.Create() and write bands of vrt in blocks of
+        lines, which are read ahead in background threads (see nansat.prefetch)
+        """
+        src = vrt.dataset
+        dst = gdal_driver.Create(filename, src.RasterXSize, src.RasterYSize, src.RasterCount,
+                                 src.GetRasterBand(1).DataType, options=options)
+        if dst is None:
+            raise NansatGDALError('Cannot create %s with driver %s' % (
+                                  filename, gdal_driver.ShortName))
+        if src.GetGCPCount() > 0:
+            dst.SetGCPs(src.GetGCPs(), src.GetGCPProjection())
+        else:
+            dst.SetGeoTransform(src.GetGeoTransform())
+            dst.SetProjection(src.GetProjection())
+        dst.SetMetadata(src.GetMetadata())
+        for i in range(1, src.RasterCount + 1):
+            src_band, dst_band = src.GetRasterBand(i), dst.GetRasterBand(i)
+            dst_band.SetMetadata(src_band.GetMetadata())
+            if src_band.GetNoDataValue() is not None:
+                dst_band.SetNoDataValue(src_band.GetNoDataValue())
+
+        reader = prefetch.BlockReader(vrt, None, depth=prefetch_depth, max_memory=max_memory)
+        for y_off, blocks in reader:
+            for i, block in enumerate(blocks):
+                dst.GetRasterBand(i + 1).WriteArray(block, 0, y_off)
+        dst.FlushCache()
+        dst = None
+
     @staticmethod
     def rename_attributes(filename):
         """ Rename global attributes to get rid of the "GDAL_"-string
@@ -37,6 +37,7 @@ except:
     from PIL import Image, ImageDraw, ImageFont
 
 from nansat.utils import add_logger
+from nansat import tracing
 
 
 class Figure(object):
@@ -821,6 +822,8 @@ class Figure(object):
         if self.pilImgLegend is not None:
             self.pilImg.paste(self.pilImgLegend, (0, self.height))
 
+    @tracing.traced('Figure.process',
+                    lambda self, **kwargs: {'shape': self.array.shape})
     def process(self, **kwargs):
         """Do all common operations for preparation of a figure for saving
 
@@ -0,0 +1,249 @@
+/******************************************************************************
+ *
+ * Project:  NANSAT
+ * Purpose:  Grey level co-occurrence matrix (GLCM) texture features computed
+ *           in sliding windows with incremental update of the matrix.
+ *           Used by nansat/texture.py
+ *
+ ******************************************************************************
+ * This file is part of NANSAT. You can redistribute it or modify
+ * under the terms of GNU General Public License, v.3
+ * http://www.gnu.org/licenses/gpl-3.0.html
+ *****************************************************************************/
+
+#include <Python.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Order of features in the output array (see FEATURES in nansat/texture.py) */
+enum {
+    CONTRAST, DISSIMILARITY, HOMOGENEITY, ASM, ENERGY,
+    ENTROPY, CORRELATION, MEAN, VARIANCE, N_FEATURES
+};
+
+typedef struct {
+    const unsigned char *image;   /* quantized image, values >= levels are invalid */
+    Py_ssize_t width;
+    Py_ssize_t height;
+    int levels;
+    int window;
+    int step;
+    const int *offsets;           /* pairs (dx, dy) */
+    int n_offsets;
+    unsigned int *counts;         /* symmetric co-occurrence matrix, levels x levels */
+    double total;                 /* sum of counts */
+} GLCM;
+
+/* Add (delta=1) or remove (delta=-1) pairs with reference pixels in column x,
+ * lines y0..y1-1, for offset k */
+static void update_column(GLCM *g, int k, Py_ssize_t x, Py_ssize_t y0, Py_ssize_t y1, int delta)
+{
+    int dx = g->offsets[2 * k];
+    int dy = g->offsets[2 * k + 1];
+    Py_ssize_t y;
+    unsigned int a, b;
+
+    for (y = y0; y < y1; y++) {
+        a = g->image[y * g->width + x];
+        b = g->image[(y + dy) * g->width + x + dx];
+        if (a >= (unsigned int)g->levels || b >= (unsigned int)g->levels)
+            continue;
+        g->counts[a * g->levels + b] += delta;
+        g->counts[b * g->levels + a] += delta;
+        g->total += 2 * delta;
+    }
+}
+
+/* Range [*x0, *x1) of reference pixels with both pixels of pair inside the
+ * window starting at c0, for offset d along the axis */
+static void pair_range(int window, Py_ssize_t c0, int d, Py_ssize_t *x0, Py_ssize_t *x1)
+{
+    *x0 = c0 + (d < 0 ? -d : 0);
+    *x1 = c0 + window - (d > 0 ? d : 0);
+}
+
+/* Compute all features from the current matrix */
+static void compute_features(const GLCM *g, float *values)
+{
+    int i, j, n = g->levels;
+    double p, d, mean = 0, mean2 = 0, cross = 0, var, cov;
+    double contrast = 0, dissimilarity = 0, homogeneity = 0, asm_ = 0, entropy = 0;
+
+    if (g->total <= 0) {
+        for (i = 0; i < N_FEATURES; i++)
+            values[i] = (float)NAN;
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            if (g->counts[i * n + j] == 0)
+                continue;
+            p = g->counts[i * n + j] / g->total;
+            d = i - j;
+            contrast += d * d * p;
+            dissimilarity += fabs(d) * p;
+            homogeneity += p / (1. + d * d);
+            asm_ += p * p;
+            entropy -= p * log(p);
+            mean += i * p;
+            mean2 += (double)i * i * p;
+            cross += (double)i * j * p;
+        }
+    }
+    /* matrix is symmetric, so marginal distributions are equal */
+    var = mean2 - mean * mean;
+    cov = cross - mean * mean;
+
+    values[CONTRAST] = (float)contrast;
+    values[DISSIMILARITY] = (float)dissimilarity;
+    values[HOMOGENEITY] = (float)homogeneity;
+    values[ASM] = (float)asm_;
+    values[ENERGY] = (float)sqrt(asm_);
+    values[ENTROPY] = (float)entropy;
+    values[CORRELATION] = (float)(var > 1e-12 ? cov / var : 1.);
+    values[MEAN] = (float)mean;
+    values[VARIANCE] = (float)(var > 0 ? var : 0);
+}
+
+/* Compute features for output lines row0..row1-1, write into out[N_FEATURES][row1-row0][cols] */
+static void compute_rows(GLCM *g, int row0, int row1, float *out)
+{
+    Py_ssize_t cols = (g->width - g->window) / g->step + 1;
+    Py_ssize_t rows = row1 - row0;
+    Py_ssize_t r0, c0, x, x0, x1, old0, old1, y0, y1;
+    int row, k, f, levels2 = g->levels * g->levels;
+    float values[N_FEATURES];
+
+    for (row = row0; row < row1; row++) {
+        r0 = (Py_ssize_t)row * g->step;
+        memset(g->counts, 0, levels2 * sizeof(unsigned int));
+        g->total = 0;
+        for (c0 = 0; c0 + g->window <= g->width; c0 += g->step) {
+            for (k = 0; k < g->n_offsets; k++) {
+                pair_range(g->window, r0, g->offsets[2 * k + 1], &y0, &y1);
+                pair_range(g->window, c0, g->offsets[2 * k], &x0, &x1);
+                if (c0 == 0) {
+                    for (x = x0; x < x1; x++)
+                        update_column(g, k, x, y0, y1, 1);
+                    continue;
+                }
+                /* window moved by step: remove columns which left, add new ones */
+                old0 = x0 - g->step;
+                old1 = x1 - g->step;
+                for (x = old0; x < (old1 < x0 ? old1 : x0); x++)
+                    update_column(g, k, x, y0, y1, -1);
+                for (x = (old1 > x0 ? old1 : x0); x < x1; x++)
+                    update_column(g, k, x, y0, y1, 1);
+            }
+            compute_features(g, values);
+            for (f = 0; f < N_FEATURES; f++)
+                out[(f * rows + row - row0) * cols + c0 / g->step] = values[f];
+        }
+    }
+}
+
+static char features_docstring[] =
+    "features(image, width, height, levels, window, step, offsets, row0, row1, out)\n\n"
+    "Compute GLCM texture features in windows of <window> pixels moved by <step> pixels.\n"
+    "image : uint8 buffer of height x width quantized values (>= levels - invalid)\n"
+    "offsets : intc buffer with pairs (dx, dy) of pixel offsets, combined into one matrix\n"
+    "row0, row1 : range of output lines to compute\n"
+    "out : float32 buffer of N_FEATURES x (row1 - row0) x ((width - window) / step + 1)\n"
+    "The GIL is released during computation.";
+
+static PyObject *features(PyObject *self, PyObject *args)
+{
+    Py_buffer image, offsets, out;
+    GLCM g;
+    int row0, row1, k, max_row;
+    Py_ssize_t cols;
+    PyObject *result = NULL;
+
+    if (!PyArg_ParseTuple(args, "s*nniiis*iiw*", &image, &g.width, &g.height, &g.levels,
+                          &g.window, &g.step, &offsets, &row0, &row1, &out))
+        return NULL;
+
+    g.image = (const unsigned char *)image.buf;
+    g.offsets = (const int *)offsets.buf;
+    g.n_offsets = (int)(offsets.len / (2 * sizeof(int)));
+    g.counts = NULL;
+    cols = (g.width - g.window) / g.step + 1;
+    max_row = g.step > 0 ? (int)((g.height - g.window) / g.step + 1) : 0;
+
+    if (g.levels < 1 || g.levels > 255 || g.window < 1 || g.step < 1 ||
+            g.width < g.window || g.height < g.window) {
+        PyErr_SetString(PyExc_ValueError, "Wrong levels, window, step or image size");
+        goto done;
+    }
+    if (image.len < g.width * g.height) {
+        PyErr_SetString(PyExc_ValueError, "Image buffer is smaller than width x height");
+        goto done;
+    }
+    if (row0 < 0 || row1 > max_row || row0 > row1) {
+        PyErr_SetString(PyExc_ValueError, "Wrong range of output lines");
+        goto done;
+    }
+    for (k = 0; k < g.n_offsets; k++) {
+        if (abs(g.offsets[2 * k]) >= g.window || abs(g.offsets[2 * k + 1]) >= g.window) {
+            PyErr_SetString(PyExc_ValueError, "Offset is larger than window");
+            goto done;
+        }
+    }
+    if (out.len < (Py_ssize_t)(N_FEATURES * (row1 - row0) * cols * sizeof(float))) {
+        PyErr_SetString(PyExc_ValueError, "Output buffer is too small");
+        goto done;
+    }
+
+    g.counts = (unsigned int *)calloc(g.levels * g.levels, sizeof(unsigned int));
+    if (g.counts == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    compute_rows(&g, row0, row1, (float *)out.buf);
+    Py_END_ALLOW_THREADS
+
+    Py_INCREF(Py_None);
+    result = Py_None;
+
+done:
+    free(g.counts);
+    PyBuffer_Release(&image);
+    PyBuffer_Release(&offsets);
+    PyBuffer_Release(&out);
+    return result;
+}
+
+static PyMethodDef module_methods[] = {
+    {"features", (PyCFunction)features, METH_VARARGS, features_docstring},
+    {NULL, NULL, 0, NULL}
+};
+
+#if PY_MAJOR_VERSION >= 3
+static struct PyModuleDef _glcm =
+{
+    PyModuleDef_HEAD_INIT,
+    "_glcm", /* name of module */
+    "GLCM texture features", /* module documentation */
+    -1,
+    module_methods
+};
+
+PyMODINIT_FUNC PyInit__glcm(void)
+{
+    PyObject *m = PyModule_Create(&_glcm);
+    if (m != NULL)
+        PyModule_AddIntConstant(m, "N_FEATURES", N_FEATURES);
+    return m;
+}
+#else
+PyMODINIT_FUNC init_glcm(void)
+{
+    PyObject *m = Py_InitModule3("_glcm", module_methods, "GLCM texture features");
+    if (m != NULL)
+        PyModule_AddIntConstant(m, "N_FEATURES", N_FEATURES);
+}
+#endif
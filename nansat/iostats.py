@@ -0,0 +1,213 @@
+# Name:    iostats.py
+# Purpose: GDAL cache, /vsimem and I/O statistics of Nansat operations
+# Licence:
+# This file is part of NANSAT.
+# NANSAT is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3 of the License.
+# http://www.gnu.org/licenses/gpl-3.0.html
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+"""Statistics of GDAL block cache, /vsimem and file I/O
+
+IOStats measures an operation: change of memory used by the GDAL block
+cache, change of number and size of files in /vsimem, bytes read by the
+process (on Linux) and the source files which the operation reads through
+the chain of VRTs, with number of references to each of them. A source
+file referenced several times (e.g. by several pixel function bands) is
+read several times unless the blocks are kept in the cache.
+
+Examples
+--------
+>>> n.start_io_stats()
+>>> a = n['sigma0_VV']
+>>> n.export('out.nc')
+>>> for record in n.stop_io_stats():
+>>>     print(record['operation'], record['cache_used_delta'], record['source_files'])
+
+"""
+from __future__ import absolute_import
+import os
+import time
+import functools
+
+from nansat.utils import gdal
+from nansat.node import Node
+from nansat.vrt import VRT
+
+# tags of VRT elements with <SourceFilename>
+SOURCE_TAGS = ['SimpleSource', 'ComplexSource', 'AveragedSource', 'KernelFilteredSource']
+
+
+def vsimem_usage():
+    """Return number of files and total size (bytes) of files in /vsimem"""
+    files = gdal.ReadDirRecursive('/vsimem/') or []
+    n_files, n_bytes = 0, 0
+    for filename in files:
+        stat = gdal.VSIStatL('/vsimem/' + filename)
+        if stat is not None and not stat.IsDirectory():
+            n_files += 1
+            n_bytes += stat.size
+    return n_files, n_bytes
+
+
+def process_bytes_read():
+    """Return number of bytes read by the process so far (None if unknown)
+
+    Uses /proc/self/io, i.e. available on Linux only. The value includes all
+    reads of the process, also from files opened by other libraries.
+    """
+    try:
+        with open('/proc/self/io') as io_file:
+            for line in io_file:
+                if line.startswith('rchar:'):
+                    return int(line.split()[1])
+    except (IOError, OSError):
+        pass
+    return None
+
+
+def source_files(vrt_filename, band=None, counts=None):
+    """Count references to source files in a chain of VRT files
+
+    Parameters
+    ----------
+    vrt_filename : str
+        name of VRT file (e.g. VRT.filename)
+    band : int
+        band number. If None, sources of all bands are counted
+    counts : dict
+        counts to update (used in recursion)
+
+    Returns
+    -------
+    counts : dict
+        number of references to each non-VRT source file
+
+    """
+    if counts is None:
+        counts = {}
+    xml = VRT.read_vsi(vrt_filename)
+    if not xml:
+        return counts
+    root = Node.create(xml)
+
+    # warped VRT: sources are in the warping options
+    warp_options = root.node('GDALWarpOptions')
+    if warp_options:
+        src_band = band
+        band_list = warp_options.node('BandList')
+        for band_mapping in band_list.nodeList('BandMapping') if band_list else []:
+            if band is not None and int(band_mapping.getAttribute('dst')) == band:
+                src_band = int(band_mapping.getAttribute('src'))
+        _count_source(source_filename(warp_options.node('SourceDataset'), vrt_filename),
+                      src_band, counts)
+        return counts
+
+    for band_node in root.nodeList('VRTRasterBand'):
+        if band is not None and int(band_node.getAttribute('band')) != band:
+            continue
+        for source_node in band_node.children:
+            if source_node.tag not in SOURCE_TAGS:
+                continue
+            src_band = source_node.node('SourceBand')
+            _count_source(source_filename(source_node.node('SourceFilename'), vrt_filename),
+                          int(src_band.value) if src_band else 1, counts)
+    return counts
+
+
+def source_filename(filename_node, vrt_filename):
+    """Return name of source file from <SourceFilename> or <SourceDataset> node"""
+    filename = filename_node.value
+    if filename_node.attributes.get('relativeToVRT') == '1':
+        filename = os.path.join(os.path.dirname(vrt_filename), filename)
+    return filename
+
+
+def _count_source(filename, band, counts):
+    """Add reference to file or to sources of VRT file"""
+    if filename.lower().endswith('.vrt'):
+        source_files(filename, band, counts)
+    else:
+        counts[filename] = counts.get(filename, 0) + 1
+
+
+class IOStats(object):
+    """Context manager measuring GDAL cache, /vsimem and I/O during operation"""
+
+    def __init__(self, operation, vrt_filename=None, band=None, **attrs):
+        """Prepare measurement of <operation>
+
+        Parameters
+        ----------
+        operation : str
+            name of operation (e.g. 'read' or 'export')
+        vrt_filename : str
+            name of VRT file which is read in the operation
+        band : int
+            number of band in the VRT file (all bands if None)
+        **attrs : dict
+            other attributes added to the record
+
+        """
+        self.record = dict(attrs, operation=operation, band=band)
+        self.vrt_filename = vrt_filename
+
+    def __enter__(self):
+        self.cache_used = gdal.GetCacheUsed()
+        self.vsimem_files, self.vsimem_bytes = vsimem_usage()
+        self.bytes_read = process_bytes_read()
+        self.start = time.time()
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.record['seconds'] = time.time() - self.start
+        cache_used = gdal.GetCacheUsed()
+        vsimem_files, vsimem_bytes = vsimem_usage()
+        bytes_read = process_bytes_read()
+        self.record['cache_used'] = cache_used
+        self.record['cache_max'] = gdal.GetCacheMax()
+        self.record['cache_used_delta'] = cache_used - self.cache_used
+        self.record['vsimem_files_delta'] = vsimem_files - self.vsimem_files
+        self.record['vsimem_bytes_delta'] = vsimem_bytes - self.vsimem_bytes
+        self.record['bytes_read'] = None
+        if bytes_read is not None and self.bytes_read is not None:
+            self.record['bytes_read'] = bytes_read - self.bytes_read
+        self.record['source_files'] = {}
+        if self.vrt_filename is not None:
+            for filename, references in source_files(self.vrt_filename,
+                                                     self.record['band']).items():
+                stat = gdal.VSIStatL(filename)
+                self.record['source_files'][filename] = {
+                    'references': references,
+                    'size': None if stat is None else stat.size}
+        return False
+
+
+def recorded(operation, band_id=None):
+    """Decorator adding IOStats record of a Nansat method to Nansat.io_records
+
+    Parameters
+    ----------
+    operation : str
+        name of operation
+    band_id : callable
+        called with arguments of the method, returns band id (name or number)
+
+    """
+    def decorator(func):
+        @functools.wraps(func)
+        def wrapper(self, *args, **kwargs):
+            records = getattr(self, 'io_records', None)
+            if records is None:
+                return func(self, *args, **kwargs)
+            band = None
+            if band_id is not None:
+                band = self.get_band_number(band_id(self, *args, **kwargs))
+            with IOStats(operation, self.vrt.filename, band) as stats:
+                result = func(self, *args, **kwargs)
+            records.append(stats.record)
+            return result
+        return wrapper
+    return decorator
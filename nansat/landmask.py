@@ -0,0 +1,250 @@
+# Name:    landmask.py
+# Purpose: Land masks from vector coastline polygons on the grid of a Domain
+# Licence:
+# This file is part of NANSAT.
+# NANSAT is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3 of the License.
+# http://www.gnu.org/licenses/gpl-3.0.html
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+"""Land masks from vector coastline polygons (e.g. GSHHG or OSM land polygons)
+
+Polygons are read with OGR from any vector dataset (shapefile, GeoPackage,
+etc) in lon/lat coordinates. Only polygons which intersect the border of the
+Domain are read: the spatial filter of OGR uses the spatial index of the
+dataset (.qix of shapefiles, R-tree of GeoPackages). Polygons are clipped by
+the border (with a margin), densified and transformed into pixel/line
+coordinates with the inverse transformer of the Domain, so swaths with GCPs
+or geolocation arrays are supported as well as projected grids.
+
+Polygons are filled with a scanline algorithm (even-odd rule, holes such as
+lakes are kept) with an active edge table sorted by lines. Each line is
+sampled by <supersample> scanlines and coverage of pixels along the scanlines
+is exact, which gives anti-aliased fractional coverage of pixels by land.
+
+Filling is done by the C extension nansat._scanfill (compiled by setup.py)
+in tiles of lines, in several threads (the extension releases the GIL).
+Without the extension a (slow) NumPy implementation is used.
+
+Examples
+--------
+>>> from nansat.landmask import landmask
+>>> d = Domain(4326, '-te 5 58 12 62 -tr 0.002 0.002')
+>>> lm = landmask(d, 'GSHHS_f_L1.shp')
+>>> lf = landmask(d, 'land_polygons.gpkg', coverage=True)
+>>> lf['land_fraction']
+
+"""
+from __future__ import absolute_import, division
+import multiprocessing
+
+try:
+    from concurrent.futures import ThreadPoolExecutor
+except ImportError:
+    ThreadPoolExecutor = None
+
+import numpy as np
+
+from nansat.nansat import Nansat
+from nansat.utils import ogr
+
+try:
+    from nansat import _scanfill
+except ImportError:
+    _scanfill = None
+
+
+def _fill_numpy(edges, n_edges, width, supersample, row0, row1, out):
+    """Same as nansat._scanfill.fill, but with NumPy (slow)"""
+    x0, y0, x1, y1 = edges[:n_edges].T
+    pixels = np.arange(width)
+    for row in range(row0, row1):
+        for k in range(supersample):
+            y = row + (k + 0.5) / supersample
+            active = (y0 <= y) & (y1 > y)
+            xs = np.sort(x0[active] + (y - y0[active]) * (x1[active] - x0[active]) /
+                         (y1[active] - y0[active]))
+            xa, xb = xs[0:len(xs) - 1:2], xs[1::2]
+            spans = (np.minimum(xb[:, None], pixels + 1) - np.maximum(xa[:, None], pixels))
+            out[row - row0] += np.clip(spans, 0, 1).sum(axis=0) / supersample
+
+
+def fill(edges, width, height, supersample=4, threads=None, tile_lines=64):
+    """Fill polygons given by edges and compute fractional coverage of pixels
+
+    Parameters
+    ----------
+    edges : numpy.ndarray
+        N x 4 array with edges (x0, y0, x1, y1) of polygons in pixel/line coordinates
+    width, height : int
+        size of the output array
+    supersample : int
+        number of scanlines per line
+    threads : int
+        number of threads. Number of CPUs if None
+    tile_lines : int
+        number of lines filled by one task
+
+    Returns
+    -------
+    coverage : numpy.ndarray
+        height x width float32 array with fraction of pixels inside polygons
+
+    """
+    edges = np.asarray(edges, np.float64).reshape(-1, 4)
+    # orient edges downwards, remove horizontal edges, sort by the first line
+    edges = np.where((edges[:, 1] > edges[:, 3])[:, None], edges[:, [2, 3, 0, 1]], edges)
+    edges = edges[(edges[:, 1] < edges[:, 3]) & np.isfinite(edges).all(axis=1)]
+    edges = np.ascontiguousarray(edges[np.argsort(edges[:, 1], kind='mergesort')])
+    coverage = np.zeros((height, width), np.float32)
+
+    def compute(row0, row1):
+        if _scanfill is None:
+            _fill_numpy(edges, len(edges), width, supersample, row0, row1, coverage[row0:row1])
+        else:
+            _scanfill.fill(edges, len(edges), width, supersample, row0, row1, coverage[row0:row1])
+
+    tiles = [(start, min(start + tile_lines, height)) for start in range(0, height, tile_lines)]
+    if ThreadPoolExecutor is None:
+        for start, stop in tiles:
+            compute(start, stop)
+    else:
+        pool = ThreadPoolExecutor(threads or multiprocessing.cpu_count())
+        try:
+            for future in [pool.submit(compute, start, stop) for start, stop in tiles]:
+                future.result()
+        finally:
+            pool.shutdown(wait=True)
+    return np.clip(coverage, 0, 1, out=coverage)
+
+
+def _rings(geometry):
+    """Yield arrays with lon/lat of rings of polygons in (multi)polygons and collections"""
+    geometry_type = ogr.GT_Flatten(geometry.GetGeometryType())
+    if geometry_type == ogr.wkbPolygon:
+        for i in range(geometry.GetGeometryCount()):
+            points = geometry.GetGeometryRef(i).GetPoints()
+            if points and len(points) > 2:
+                yield np.array(points)[:, :2]
+    elif geometry_type in [ogr.wkbMultiPolygon, ogr.wkbGeometryCollection]:
+        for i in range(geometry.GetGeometryCount()):
+            for ring in _rings(geometry.GetGeometryRef(i)):
+                yield ring
+
+
+def read_polygons(domain, filename, layer=0, where=None, margin=2, segment_length=None):
+    """Read rings of coastline polygons which intersect the domain
+
+    Parameters
+    ----------
+    domain : Domain
+        destination domain
+    filename : str
+        name of vector dataset with land polygons in lon/lat coordinates
+    layer : int or str
+        number or name of layer
+    where : str
+        attribute filter (e.g. 'level = 1' for GSHHG)
+    margin : float
+        margin around the border of the domain (pixels)
+    segment_length : float
+        maximum length of segments (degrees) after densification. Two pixels
+        if None
+
+    Returns
+    -------
+    rings : list of numpy.ndarray
+        N x 2 arrays with lon/lat of vertices of rings (first equal to last)
+
+    """
+    try:
+        dataset = ogr.Open(filename)
+    except RuntimeError:
+        dataset = None
+    if dataset is None:
+        raise IOError('Cannot open coastline dataset %s' % filename)
+    ogr_layer = dataset.GetLayer(layer)
+    if ogr_layer is None:
+        raise ValueError('Layer %s does not exist in %s' % (str(layer), filename))
+    srs = ogr_layer.GetSpatialRef()
+    if srs is not None and not srs.IsGeographic():
+        raise ValueError('Coastline layer must have geographic coordinates (lon/lat)')
+
+    lon, lat = domain.get_border(n_points=50, fix_lon=False)
+    height, width = domain.shape()
+    degrees_per_pixel = min((lon.max() - lon.min()) / width, (lat.max() - lat.min()) / height)
+    if segment_length is None:
+        segment_length = 2 * degrees_per_pixel
+    clip = domain.get_border_geometry(n_points=50, fix_lon=False).Buffer(margin * degrees_per_pixel)
+    envelope = clip.GetEnvelope()
+
+    ogr_layer.SetSpatialFilterRect(envelope[0], envelope[2], envelope[1], envelope[3])
+    if where is not None:
+        ogr_layer.SetAttributeFilter(where)
+    rings = []
+    for feature in ogr_layer:
+        geometry = feature.GetGeometryRef()
+        if geometry is None:
+            continue
+        geometry = geometry.Intersection(clip)
+        if geometry is None or geometry.IsEmpty():
+            continue
+        if segment_length > 0:
+            geometry.Segmentize(segment_length)
+        rings.extend(_rings(geometry))
+    ogr_layer.SetSpatialFilter(None)
+    return rings
+
+
+def landmask(domain, filename, layer=0, where=None, coverage=False, supersample=4,
+             threads=None, tile_lines=64, segment_length=None):
+    """Rasterize vector coastline polygons onto the grid of a Domain
+
+    Parameters
+    ----------
+    domain : Domain
+        destination domain (projected grid or swath with GCPs or geolocation)
+    filename : str
+        name of vector dataset (shapefile, GeoPackage, etc) with land polygons
+        in lon/lat coordinates (e.g. GSHHG or OSM land polygons)
+    layer : int or str
+        number or name of layer
+    where : str
+        attribute filter of polygons (e.g. 'level = 1' for GSHHG)
+    coverage : bool
+        return fraction of pixels covered by land instead of binary mask
+    supersample : int
+        number of scanlines per line for computing coverage
+    threads : int
+        number of threads. Number of CPUs if None
+    tile_lines : int
+        number of lines filled by one task
+    segment_length : float
+        maximum length of segments of polygons (degrees) before transformation
+
+    Returns
+    -------
+    landmask : Nansat
+        object on the grid of domain with band 'land_fraction' (float32, 0 - 1)
+        if coverage is True or band 'landmask' (uint8, 1 - land, 0 - water)
+
+    """
+    height, width = domain.shape()
+    rings = read_polygons(domain, filename, layer, where, segment_length=segment_length)
+    edges = np.zeros((0, 4))
+    if rings:
+        lon, lat = np.vstack(rings).T
+        x, y = domain.transform_points(lon, lat, DstToSrc=1)
+        # edges connect consecutive vertices within each ring
+        ends = np.cumsum([len(ring) for ring in rings])
+        valid = np.ones(len(x) - 1, bool)
+        valid[ends[:-1] - 1] = False
+        edges = np.column_stack([x[:-1], y[:-1], x[1:], y[1:]])[valid]
+    land_fraction = fill(edges, width, height, supersample, threads, tile_lines)
+
+    if coverage:
+        return Nansat.from_domain(domain, land_fraction, {'name': 'land_fraction'})
+    return Nansat.from_domain(domain, (land_fraction >= 0.5).astype(np.uint8),
+                              {'name': 'landmask'})
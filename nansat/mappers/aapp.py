@@ -0,0 +1,163 @@
+# Name:         aapp.py
+# Purpose:      Record layout and decoding shared by AAPP mappers
+# Author:       Knut-Frode Dagestad
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+
+# Description of file format:
+# http://research.metoffice.gov.uk/research/interproj/nwpsaf/aapp/NWPSAF-MF-UD-003_Formats.pdf
+import os
+import datetime
+
+import numpy as np
+
+from nansat.utils import gdal
+from nansat.exceptions import WrongMapperError
+
+# number of AVHRR pixels per scanline, channels and geolocation tie points
+AVHRR_PIXELS = 2048
+AVHRR_CHANNELS = 5
+TIE_POINTS = 51
+
+
+def _record_dtype(fields, itemsize):
+    """Make structured dtype of a record from list of (name, format, offset)"""
+    names, formats, offsets = zip(*fields)
+    return np.dtype({'names': names, 'formats': formats,
+                     'offsets': offsets, 'itemsize': itemsize})
+
+# AAPP level 1b (AVHRR): header and scanline records have the same length
+L1B_RECORD_LENGTH = 22016
+L1B_HEADER = _record_dtype([
+    ('sat_id', '<u2', 72),
+    ('data_format', '<u2', 76),
+    ('year', '<u2', 84),
+    ('day_of_year', '<u2', 86),
+    ('milliseconds', '<i4', 88),
+    ('num_scan_lines', '<u2', 128),
+    ('num_calibrated_scan_lines', '<u2', 130),
+    ('missing_scan_lines', '<u2', 132),
+    ('radtempcnv', ('<i4', (3, 3)), 280),
+], L1B_RECORD_LENGTH)
+L1B_RECORD = _record_dtype([
+    ('scan_line_number', '<u2', 0),
+    ('earth_location', ('<i4', (TIE_POINTS, 2)), 640),
+    ('channels', ('<u2', (AVHRR_PIXELS, AVHRR_CHANNELS)), 1264),
+], L1B_RECORD_LENGTH)
+
+# AAPP level 1c (AVHRR)
+L1C_RECORD_LENGTH = 29808
+L1C_HEADER = _record_dtype([
+    ('sat_id', '<i4', 24),
+    ('year', '<i4', 44),
+    ('day_of_year', '<i4', 48),
+    ('milliseconds', '<i4', 52),
+    ('num_scan_lines', '<i4', 72),
+    ('missing_scan_lines', '<i4', 76),
+    ('num_calibrated_scan_lines', '<i4', 80),
+    ('data_format', '<i4', 88),
+], L1C_RECORD_LENGTH)
+L1C_RECORD = _record_dtype([
+    ('scan_line_bits', '<u4', 20),
+    ('earth_location', ('<i4', (TIE_POINTS, 2)), 676),
+    ('channels', ('<u2', (AVHRR_PIXELS, AVHRR_CHANNELS)), 1092),
+], L1C_RECORD_LENGTH)
+
+
+def read_header(filename, header_dtype):
+    """Decode header record of AAPP file with one read
+
+    Raises WrongMapperError if the file is not readable or too short
+
+    """
+    try:
+        header = np.fromfile(filename, dtype=header_dtype, count=1)
+    except (IOError, OSError, ValueError):
+        raise WrongMapperError
+    if header.size != 1:
+        raise WrongMapperError
+    return header[0]
+
+
+def read_records(filename, record_dtype, num_lines):
+    """Map scanline records of AAPP file (without reading) as numpy.memmap
+
+    The number of records is limited by the actual size of the file.
+
+    """
+    num_lines = min(int(num_lines),
+                    os.path.getsize(filename) // record_dtype.itemsize - 1)
+    if num_lines <= 0:
+        raise WrongMapperError
+    return np.memmap(filename, dtype=record_dtype, mode='r',
+                     offset=record_dtype.itemsize, shape=(num_lines,))
+
+
+def header_time(header):
+    """Get time of the first scanline from header record"""
+    try:
+        return (datetime.datetime(int(header['year']), 1, 1) +
+                datetime.timedelta(int(header['day_of_year']) - 1,
+                                   milliseconds=int(header['milliseconds'])))
+    except (ValueError, OverflowError):
+        raise WrongMapperError
+
+
+def tie_point_lonlat(records):
+    """Get longitude and latitude at geolocation tie points of all scanlines
+
+    Returns
+    -------
+    lon, lat : numpy.ndarray
+        2D float32 arrays (lines x 51) with coordinates of every 40th pixel,
+        starting from pixel 25
+
+    """
+    earth_location = (records['earth_location'].astype('float32') *
+                      np.float32(1e-4))
+    return earth_location[:, :, 1], earth_location[:, :, 0]
+
+
+def l1b_ir_calibration(header):
+    """Get constants for conversion of radiance to brightness temperature
+    of AVHRR channels 3B, 4 and 5
+
+    Parameters
+    ----------
+    header : numpy.void
+        header record
+
+    Returns
+    -------
+    coefficients : dict
+        'central_wavenumber', 'c1', 'c2' : arrays with 3 values (per channel)
+
+    """
+    radtempcnv = header['radtempcnv'].astype('float64')
+    return {'central_wavenumber': radtempcnv[:, 0] / [1E2, 1E3, 1E3],
+            'c1': radtempcnv[:, 1] / 1E5,
+            'c2': radtempcnv[:, 2] / 1E6}
+
+
+def channel_band_source(filename, record_dtype, channel, num_lines,
+                        data_type=gdal.GDT_UInt16):
+    """Make source of VRTRawRasterBand for AVHRR channel (1 - 5)
+
+    Offsets are taken from the record layout: channels are interleaved
+    by pixel within each scanline record.
+
+    """
+    field_dtype, field_offset = record_dtype.fields['channels'][:2]
+    item_size = field_dtype.base.itemsize
+    return {'SourceFilename': filename,
+            'SourceBand': 0,
+            'SourceType': 'RawRasterBand',
+            'DataType': data_type,
+            'ImageOffset': (record_dtype.itemsize + field_offset +
+                            (channel - 1) * item_size),
+            'PixelOffset': item_size * AVHRR_CHANNELS,
+            'LineOffset': record_dtype.itemsize,
+            'ByteOrder': 'LSB',
+            'xSize': AVHRR_PIXELS,
+            'ySize': num_lines}
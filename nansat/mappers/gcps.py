@@ -0,0 +1,146 @@
+# Name:        gcps
+# Purpose:     Generation of GCPs from geolocation arrays of swath data
+# Authors:      Anton Korosov
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+import numpy as np
+
+from nansat.utils import gdal
+
+
+def gcp_steps(y_size, x_size, gcp_count):
+    """Get step of GCPs along lines and pixels for given number of GCPs"""
+    return (max(1, int(float(y_size) / gcp_count)),
+            max(1, int(float(x_size) / gcp_count)))
+
+
+def read_rows(band, rows):
+    """Read only the given rows of a band (one line window per row)
+
+    Parameters
+    ----------
+    band : gdal.Band
+        band with geolocation array
+    rows : numpy.ndarray
+        indices of rows to read
+
+    Returns
+    -------
+    data : numpy.ndarray
+        2D array (len(rows) x band.XSize)
+
+    """
+    return np.vstack([band.ReadAsArray(0, int(row), band.XSize, 1)
+                      for row in rows])
+
+
+def interpolation_error(lon, lat, cols):
+    """Estimate error of linear interpolation of lon/lat between columns
+
+    Parameters
+    ----------
+    lon, lat : numpy.ndarray
+        2D arrays with full rows of longitude and latitude
+    cols : numpy.ndarray
+        sorted indices of sampled columns
+
+    Returns
+    -------
+    mid_cols : numpy.ndarray
+        indices of columns in the middle of each interval between cols
+    error : numpy.ndarray
+        maximum (over rows) distance in degrees between the actual and the
+        interpolated coordinates at mid_cols
+
+    """
+    mid_cols = (cols[:-1] + cols[1:]) // 2
+    weight = (mid_cols - cols[:-1]) / (cols[1:] - cols[:-1]).astype('float64')
+    lon0, lon1, lon_mid = lon[:, cols[:-1]], lon[:, cols[1:]], lon[:, mid_cols]
+    lat0, lat1, lat_mid = lat[:, cols[:-1]], lat[:, cols[1:]], lat[:, mid_cols]
+    # longitude differences across the dateline are wrapped
+    dlon = (lon1 - lon0 + 180.) % 360. - 180.
+    dlon_mid = (lon0 + weight * dlon - lon_mid + 180.) % 360. - 180.
+    dlat_mid = lat0 + weight * (lat1 - lat0) - lat_mid
+    error = np.hypot(dlon_mid * np.cos(np.radians(lat_mid)), dlat_mid)
+    # invalid geolocation does not trigger refinement
+    error[~np.isfinite(error)] = 0
+    error[(np.abs(lat_mid) > 90) | (np.abs(lon_mid) > 360)] = 0
+    return mid_cols, error.max(axis=0)
+
+
+def refine_cols(lon, lat, cols, tolerance, max_iterations=5):
+    """Add columns where linear interpolation of lon/lat is not accurate
+
+    Error is checked in the middle of each interval between sampled columns
+    and intervals with error above tolerance are split in two. This mostly
+    adds columns near the swath edges where the geolocation is curved most.
+
+    """
+    cols = np.unique(np.append(cols, lon.shape[1] - 1))
+    for _ in range(max_iterations):
+        mid_cols, error = interpolation_error(lon, lat, cols)
+        new_cols = mid_cols[(error > tolerance) & (mid_cols > cols[:-1])]
+        if new_cols.size == 0:
+            break
+        cols = np.union1d(cols, new_cols)
+    return cols
+
+
+def get_swath_gcps(lon_band, lat_band, gcp_count=10, step0=None, step1=None,
+                   line_step=1., pixel_step=1., offset=0.5,
+                   tolerance=None, max_iterations=5):
+    """Create GCPs from geolocation arrays without reading the full arrays
+
+    Only rows with GCPs are read from the geolocation bands. Columns are
+    sampled from these rows and optionally refined near the swath edges.
+
+    Parameters
+    ----------
+    lon_band, lat_band : gdal.Band
+        bands with longitude and latitude
+    gcp_count : int
+        number of GCPs along each dimension (if steps are not given)
+    step0, step1 : int
+        step of GCPs along lines and pixels of the geolocation arrays
+    line_step, pixel_step : float
+        size of geolocation array cell in lines/pixels of the dataset
+    offset : float
+        offset of GCP pixel/line (0.5 - center of pixel)
+    tolerance : float
+        if given, columns are added where the error of linear interpolation
+        of lon/lat between GCPs exceeds tolerance (degrees). The last row
+        and column are also added to cover the swath edges.
+    max_iterations : int
+        maximum number of refinement iterations
+
+    Returns
+    -------
+    gcps : list of gdal.GCP
+        GCPs with valid lon/lat only
+
+    """
+    y_size, x_size = lon_band.YSize, lon_band.XSize
+    default_step0, default_step1 = gcp_steps(y_size, x_size, gcp_count)
+    rows = np.arange(0, y_size, step0 or default_step0)
+    cols = np.arange(0, x_size, step1 or default_step1)
+    if tolerance is not None:
+        rows = np.unique(np.append(rows, y_size - 1))
+
+    lon = read_rows(lon_band, rows).astype('float64')
+    lat = read_rows(lat_band, rows).astype('float64')
+
+    if tolerance is not None and cols.size > 1:
+        cols = refine_cols(lon, lat, cols, tolerance, max_iterations)
+
+    # all GCP coordinates are generated at once
+    lon = lon[:, cols].flatten()
+    lat = lat[:, cols].flatten()
+    lines, pixels = np.meshgrid(rows * line_step + offset,
+                                cols * pixel_step + offset, indexing='ij')
+    valid = ((lon >= -180) * (lon <= 180) * (lat >= -90) * (lat <= 90))
+
+    return [gdal.GCP(float(x), float(y), 0, float(p), float(l))
+            for x, y, p, l in zip(lon[valid], lat[valid],
+                                  pixels.flatten()[valid],
+                                  lines.flatten()[valid])]
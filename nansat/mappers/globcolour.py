@@ -6,6 +6,10 @@
 #               http://www.gnu.org/licenses/gpl-3.0.html
 from copy import deepcopy
 
+import numpy as np
+
+from nansat.vrt import VRT
+
 
 class Globcolour():
     ''' Mapper for GLOBCOLOR L3M products'''
@@ -45,3 +49,163 @@ class Globcolour():
             metaEntry = None
 
         return metaEntry
+
+
+class BinnedGrid(object):
+    """ Index of GLOBCOLOUR L3B bins for remapping onto an arbitrary lon/lat grid
+
+    The binned products store only valid bins with their row and column on the
+    integerized sinusoidal GLOBCOLOUR grid. Instead of scattering the bins into the
+    full global raster and gathering them back through index grids, the bins are
+    sorted by row once, a compact index of row starts is built and each pixel of
+    the destination grid is looked up directly inside its row.
+
+    Parameters
+    ----------
+    rows : numpy.ndarray
+        1-based row of each bin (variable 'row' in the L3B file)
+    cols : numpy.ndarray
+        1-based column of each bin (variable 'col' in the L3B file)
+
+    """
+    # shape of the GLOBCOLOUR grid
+    ROWS = 180 * 24
+    COLS = 360 * 24
+
+    def __init__(self, rows, cols):
+        rows = np.asarray(rows, 'int64').ravel()
+        cols = np.asarray(cols, 'int64').ravel()
+        # order of bins sorted by row and by column within each row
+        self.order = np.lexsort((cols, rows))
+        # compact sorted key of each bin
+        self.keys = rows[self.order] * (self.COLS + 2) + cols[self.order]
+        # column of each sorted bin
+        self.sorted_cols = cols[self.order].astype('int32')
+        # start of each row in the sorted bins (row_start[i]:row_start[i+1] is row i)
+        self.row_start = np.searchsorted(rows[self.order], np.arange(self.ROWS + 3))
+
+    @classmethod
+    def from_dataset(cls, dataset):
+        """ Read row/col bin index from netCDF4.Dataset with L3B data """
+        return cls(dataset.variables['row'][:], dataset.variables['col'][:])
+
+    @classmethod
+    def grid_rows_cols(cls, lat, lon):
+        """ Get GLOBCOLOUR rows and columns for given latitudes and longitudes
+
+        Parameters
+        ----------
+        lat, lon : numpy.ndarray
+            latitudes and longitudes of the destination grid
+
+        Returns
+        -------
+        rows, cols : numpy.ndarray
+            1-based row and column of GLOBCOLOUR grid for each destination pixel
+
+        """
+        lat = np.asarray(lat, 'float32')
+        lon = np.asarray(lon, 'float32')
+        rows = np.rint(1 + (cls.ROWS - 1) * (lat + 90) / 180.).astype('int64')
+        lon_step = 24. * np.cos(np.pi * lat / 180.)
+        cols = np.rint(1 + (lon + 180) * lon_step).astype('int64')
+        return rows, cols
+
+    def get_index(self, rows, cols):
+        """ Find bin for each pixel of the destination grid
+
+        Parameters
+        ----------
+        rows, cols : numpy.ndarray
+            1-based GLOBCOLOUR rows and columns of the destination grid (from grid_rows_cols())
+
+        Returns
+        -------
+        index : numpy.ndarray
+            index of the bin in the original (unsorted) bin order or -1 if
+            the pixel has no valid bin. Shape is the same as of <rows>.
+
+        """
+        shape = rows.shape
+        rows = np.clip(rows.ravel(), 0, self.ROWS + 1)
+        cols = cols.ravel()
+        index = np.zeros(rows.size, 'int64') - 1
+        if self.keys.size == 0:
+            return index.reshape(shape)
+
+        # search only pixels in rows which have any bins
+        gpi = np.nonzero(self.row_start[rows] < self.row_start[rows + 1])[0]
+        dst_keys = rows[gpi] * (self.COLS + 2) + cols[gpi]
+        pos = np.minimum(np.searchsorted(self.keys, dst_keys), self.keys.size - 1)
+        found = self.keys[pos] == dst_keys
+        index[gpi[found]] = self.order[pos[found]]
+
+        return index.reshape(shape)
+
+    @staticmethod
+    def remap(values, index, fill_value=0):
+        """ Fill destination grid with binned values using index from get_index()
+
+        Parameters
+        ----------
+        values : numpy.ndarray
+            1D array with binned values
+        index : numpy.ndarray
+            index of bins from get_index()
+        fill_value : float
+            value for pixels without valid bin
+
+        Returns
+        -------
+        grid : numpy.ndarray
+            array with the shape of <index>
+
+        """
+        values = np.ma.filled(values, fill_value).astype('float32')
+        grid = np.zeros(index.shape, 'float32') + fill_value
+        valid = index >= 0
+        grid[valid] = values[index[valid]]
+        return grid
+
+    def get_tables(self, values):
+        """ Make tables of bins for pixel function GlobcolourBins
+
+        The bins are remapped by the pixel function when a window of the
+        destination grid is read: row and column of each pixel are computed
+        from its latitude and longitude and the bin is searched inside its row.
+
+        Parameters
+        ----------
+        values : numpy.ndarray
+            1D array with binned values (masked values are replaced by 0)
+
+        Returns
+        -------
+        tables : dict
+            VRTs with 'row_start' (int32), 'cols' (int32) and 'values'
+            (float32) of bins sorted by row and by column within each row
+
+        """
+        values = np.ma.filled(values, 0).astype('float32')[self.order]
+        arrays = {'row_start': self.row_start.astype('int32'),
+                  'cols': self.sorted_cols,
+                  'values': values}
+        if values.size == 0:
+            # bands can not be empty, the dummy bin is not in any row
+            arrays.update({'cols': np.zeros(1, 'int32'),
+                           'values': np.zeros(1, 'float32')})
+        return dict((key, VRT.from_array(arrays[key].reshape(1, arrays[key].size)))
+                    for key in arrays)
+
+    @staticmethod
+    def get_pixfun_arguments(tables, mask=False):
+        """ Make arguments of pixel function GlobcolourBins from get_tables()
+
+        The pixel function reads the binary files of the VRTs (see
+        VRT.from_array) directly from /vsimem/ without copying.
+
+        """
+        arguments = dict((key, tables[key].filename.replace('.vrt', '.raw'))
+                         for key in tables)
+        arguments['mask'] = int(mask)
+        return arguments
@@ -0,0 +1,350 @@
+# Name:        grib_index
+# Purpose:     Inventory of messages in GRIB files for direct access
+# Authors:      Anton Korosov
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+import os
+import json
+import struct
+import hashlib
+import datetime
+
+from nansat.utils import gdal
+from nansat.exceptions import WrongMapperError
+
+# short names of parameters (as in wgrib and GDAL)
+# GRIB1: parameter number in WMO table 2
+GRIB1_PARAMETERS = {1: 'PRES', 2: 'PRMSL', 7: 'HGT', 11: 'TMP', 33: 'UGRD',
+                    34: 'VGRD', 52: 'RH', 61: 'APCP', 71: 'TCDC'}
+# GRIB2: (discipline, category, number)
+GRIB2_PARAMETERS = {(0, 0, 0): 'TMP', (0, 1, 1): 'RH', (0, 1, 8): 'APCP',
+                    (0, 2, 2): 'UGRD', (0, 2, 3): 'VGRD', (0, 3, 0): 'PRES',
+                    (0, 3, 1): 'PRMSL', (0, 3, 5): 'HGT', (0, 6, 1): 'TCDC'}
+
+# short names of level types
+GRIB1_LEVELS = {1: 'SFC', 100: 'ISBL', 102: 'MSL', 105: 'HTGL', 109: 'HYBL'}
+GRIB2_LEVELS = {1: 'SFC', 100: 'ISBL', 101: 'MSL', 103: 'HTGL', 105: 'HYBL'}
+
+# units of forecast time in seconds (GRIB1 table 4, GRIB2 table 4.4)
+TIME_UNITS = {0: 60, 1: 3600, 2: 86400, 10: 10800, 11: 21600, 12: 43200,
+              13: 1, 254: 1}
+
+
+def _sign_magnitude(value, bits):
+    """Decode integer with sign in the highest bit (as in GRIB)"""
+    sign_bit = 1 << (bits - 1)
+    if value & sign_bit:
+        return -(value & (sign_bit - 1))
+    return value
+
+
+def _message_length(header):
+    """Length of message from the first 16 bytes (section 0), None if not GRIB1/2"""
+    if len(header) < 16 or header[:4] != b'GRIB':
+        return None
+    if header[7:8] == b'\x01':
+        return struct.unpack('>I', b'\x00' + header[4:7])[0]
+    if header[7:8] == b'\x02':
+        return struct.unpack('>Q', header[8:16])[0]
+    return None
+
+
+def _valid_time(reference_time, unit, value):
+    """Add forecast time to reference time, None if unit is unknown"""
+    if unit not in TIME_UNITS:
+        return None
+    return reference_time + datetime.timedelta(seconds=TIME_UNITS[unit] * value)
+
+
+class GribIndex(object):
+    """Inventory of messages in a GRIB (edition 1 or 2) file
+
+    Only the headers of each message are read: section 0 gives the length of
+    the message and the following sections are skipped except those with
+    time, parameter and level. Each field is then opened with GDAL from
+    /vsisubfile/ covering just its message, so GDAL scans and decodes only
+    the messages used in a VRT and not all messages in the file.
+
+    If <cachedir> is given, the inventory is saved there and reused when the
+    same file (same full path, size and modification time) is opened again.
+
+    Each entry of GribIndex.messages is a dict with keys:
+        offset, length : position of the message in the file (bytes)
+        band : number of the field in the message (starting from 1)
+        parameter : short name of the parameter (e.g. UGRD)
+        level_type : short name of the level type (e.g. HTGL)
+        level : value of the level in SI units (m, Pa)
+        reference_time, valid_time : ISO formatted times (or None)
+
+    """
+    INDEX_SUFFIX = '.index.json'
+    # maximum number of bytes before and between messages
+    SEARCH_LIMIT = 1024
+
+    def __init__(self, filename, cachedir=None):
+        """Create inventory of messages in GRIB file
+
+        Parameters
+        ----------
+        filename : str
+            name of GRIB file
+        cachedir : str
+            existing directory for the inventory
+
+        """
+        self.filename = filename
+        self.index_filename = None
+        self.messages = None
+        if cachedir is not None and os.path.isdir(cachedir):
+            self.index_filename = self._index_filename(cachedir)
+            self.messages = self._load_index()
+
+        if self.messages is None:
+            self.messages = self._create_index()
+            if self.index_filename is not None:
+                with open(self.index_filename, 'w') as index_file:
+                    json.dump({'file': self._file_stat(),
+                               'messages': self.messages}, index_file)
+
+    def _file_stat(self):
+        """Size and modification time of the file to validate the cache"""
+        stat = os.stat(self.filename)
+        return [stat.st_size, stat.st_mtime]
+
+    def _index_filename(self, cachedir):
+        """Name of inventory in cachedir, unique for full path, size and mtime of the file"""
+        key = '%s|%d|%r' % ((os.path.abspath(self.filename),) + tuple(self._file_stat()))
+        return os.path.join(cachedir, '%s.%s%s' % (
+            os.path.basename(self.filename),
+            hashlib.md5(key.encode('utf-8')).hexdigest()[:16],
+            self.INDEX_SUFFIX))
+
+    def _load_index(self):
+        """Load inventory saved for the same file, None if not available"""
+        if not os.path.exists(self.index_filename):
+            return None
+        with open(self.index_filename) as index_file:
+            index = json.load(index_file)
+        if index.get('file') != self._file_stat():
+            return None
+        return index['messages']
+
+    def _create_index(self):
+        """Read headers of all messages"""
+        try:
+            grib_file = open(self.filename, 'rb')
+        except (IOError, OSError):
+            raise WrongMapperError
+        messages = []
+        with grib_file:
+            offset = self._find_message(grib_file, 0)
+            while offset is not None:
+                grib_file.seek(offset)
+                header = grib_file.read(16)
+                length = _message_length(header)
+                if not length:
+                    break
+                if header[7:8] == b'\x01':
+                    fields = self._read_grib1(grib_file, offset)
+                else:
+                    fields = self._read_grib2(grib_file, offset, header[6:7])
+                for band, field in enumerate(fields):
+                    field.update({'offset': offset,
+                                  'length': length,
+                                  'band': band + 1})
+                    messages.append(field)
+                offset = self._find_message(grib_file, offset + length)
+
+        if not messages:
+            raise WrongMapperError
+        return messages
+
+    def _find_message(self, grib_file, offset):
+        """Find start of the next message, None if not found"""
+        grib_file.seek(offset)
+        position = grib_file.read(self.SEARCH_LIMIT + 4).find(b'GRIB')
+        if position < 0:
+            return None
+        return offset + position
+
+    @staticmethod
+    def _read_grib1(grib_file, offset):
+        """Read parameter, level and time of GRIB1 message"""
+        grib_file.seek(offset + 8)
+        pds = bytearray(grib_file.read(28))
+        reference_time = datetime.datetime((pds[24] - 1) * 100 + pds[12],
+                                           pds[13], pds[14], pds[15], pds[16])
+        level_type = pds[9]
+        level = float(pds[10] * 256 + pds[11])
+        if level_type == 100:
+            # hPa -> Pa
+            level *= 100
+        time_range = pds[20]
+        if time_range == 10:
+            forecast_time = pds[18] * 256 + pds[19]
+        elif time_range in (2, 3, 4, 5):
+            forecast_time = pds[19]
+        else:
+            forecast_time = pds[18]
+        if pds[3] < 128:
+            parameter = GRIB1_PARAMETERS.get(pds[8], 'var%d' % pds[8])
+        else:
+            parameter = 'var%d' % pds[8]
+        valid_time = _valid_time(reference_time, pds[17], forecast_time)
+        return [{'parameter': parameter,
+                 'level_type': GRIB1_LEVELS.get(level_type, str(level_type)),
+                 'level': level,
+                 'reference_time': reference_time.isoformat(),
+                 'valid_time': valid_time and valid_time.isoformat()}]
+
+    @staticmethod
+    def _read_grib2(grib_file, offset, discipline):
+        """Read parameter, level and time of all fields in GRIB2 message"""
+        discipline = bytearray(discipline)[0]
+        reference_time = None
+        fields = []
+        position = offset + 16
+        while True:
+            grib_file.seek(position)
+            section_header = grib_file.read(5)
+            if len(section_header) < 5 or section_header[:4] == b'7777':
+                break
+            length, number = struct.unpack('>IB', section_header)
+            if length < 5:
+                break
+            if number == 1:
+                section = bytearray(grib_file.read(14))
+                reference_time = datetime.datetime(
+                    section[7] * 256 + section[8], *section[9:14])
+            elif number == 4:
+                section = bytearray(grib_file.read(29))
+                template, category, parameter_number = struct.unpack(
+                    '>HBB', bytes(section[2:6]))
+                field = {'parameter': GRIB2_PARAMETERS.get(
+                            (discipline, category, parameter_number),
+                            'var%d_%d_%d' % (discipline, category,
+                                             parameter_number)),
+                         'level_type': None,
+                         'level': None,
+                         'reference_time': (reference_time and
+                                            reference_time.isoformat()),
+                         'valid_time': None}
+                # templates 4.0 - 4.15 share time and level octets
+                if template <= 15:
+                    unit = section[12]
+                    forecast_time, = struct.unpack('>I', bytes(section[13:17]))
+                    level_type = section[17]
+                    scale, value = struct.unpack('>BI', bytes(section[18:23]))
+                    field['level_type'] = GRIB2_LEVELS.get(level_type,
+                                                           str(level_type))
+                    if value != 0xFFFFFFFF:
+                        field['level'] = float(
+                            _sign_magnitude(value, 32) *
+                            10. ** -_sign_magnitude(scale, 8))
+                    if reference_time is not None:
+                        valid_time = _valid_time(
+                            reference_time, unit,
+                            _sign_magnitude(forecast_time, 32))
+                        field['valid_time'] = (valid_time and
+                                               valid_time.isoformat())
+                fields.append(field)
+            position += length
+        return fields
+
+    def select(self, parameter, level_type=None, level=None):
+        """Find messages with given parameter and level
+
+        Parameters
+        ----------
+        parameter : str
+            short name of parameter (e.g. UGRD)
+        level_type : str
+            short name of level type (e.g. HTGL), any if None
+        level : float
+            value of level in SI units (e.g. 10 [m]), any if None
+
+        Returns
+        -------
+        messages : list of dict
+            entries of the inventory in order of the file
+
+        """
+        return [message for message in self.messages
+                if message['parameter'] == parameter and
+                level_type in (None, message['level_type']) and
+                (level is None or message['level'] == level)]
+
+    def vsi_filename(self, message):
+        """Name of single message for opening with GDAL"""
+        return '/vsisubfile/%d_%d,%s' % (message['offset'], message['length'],
+                                        self.filename)
+
+    def first_dataset(self):
+        """GDAL dataset with the first message only (size and geotransform of the grid)
+
+        GDAL scans all messages when the whole GRIB file is opened, the
+        dataset of the first message is enough for creating VRT of a mapper.
+
+        """
+        if not self.messages:
+            raise WrongMapperError('%s: no GRIB messages' % self.filename)
+        return gdal.Open(self.vsi_filename(self.messages[0]))
+
+    def band_source(self, parameter, level_type=None, level=None, **kwargs):
+        """Source of VRT band with the first message matching parameter/level
+
+        Parameters
+        ----------
+        parameter, level_type, level
+            see GribIndex.select
+        **kwargs
+            other keys of the source (e.g. xSize, ySize, NODATA)
+
+        Returns
+        -------
+        src : dict
+            with SourceFilename, SourceBand and DataType
+
+        Raises
+        ------
+        WrongMapperError
+            if the file has no matching messages
+
+        """
+        messages = self.select(parameter, level_type, level)
+        if not messages:
+            raise WrongMapperError('%s: no %s at %s %s' % (
+                self.filename, parameter, level, level_type))
+        return self._source(messages[0], **kwargs)
+
+    def field_source(self, number, **kwargs):
+        """Source of VRT band with the <number>-th field of the file
+
+        Fields are numbered from 1 in order of the file, as bands of the
+        dataset opened by GDAL. Use it for files with local parameter tables,
+        where short names of parameters are not known.
+
+        Raises
+        ------
+        WrongMapperError
+            if the file has less than <number> fields
+
+        """
+        if not 1 <= number <= len(self.messages):
+            raise WrongMapperError('%s: no field %d' % (self.filename, number))
+        return self._source(self.messages[number - 1], **kwargs)
+
+    def _source(self, message, **kwargs):
+        """Source of VRT band reading one field from its message"""
+        # GDAL returns all GRIB fields as Float64
+        src = {'SourceFilename': self.vsi_filename(message),
+               'SourceBand': message['band'],
+               'DataType': gdal.GDT_Float64}
+        src.update(kwargs)
+        return src
+
+    def valid_times(self):
+        """Sorted unique valid times of all messages"""
+        return sorted(set(message['valid_time'] for message in self.messages
+                          if message['valid_time'] is not None))
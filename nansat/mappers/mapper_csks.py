@@ -115,66 +115,86 @@ class Mapper(VRT):
         #res='SBI'
 
         # Use only full size "original" datasets
-        for i, elem in enumerate(filenames):
-            if filenames[i][-3:] == 'SBI':
+        sbiFilenames = [f for f in filenames if f[-3:] == 'SBI']
+
+        # pixel functions with arguments are available from GDAL 3.4
+        hasPixelFunctionArguments = int(gdal.VersionInfo()) >= 3040000
+
+        rawBands = {}
+        for sbiFilename in sbiFilenames:
+            polarisation = gdalMetadata[sbiFilename[-7:-4]+'_Polarisation']
+            sbiDataset = gdal.Open(sbiFilename)
+            sbiDataType = sbiDataset.GetRasterBand(1).DataType
+            if (hasPixelFunctionArguments and sbiDataset.RasterCount == 1 and
+                    gdal.DataTypeIsComplex(sbiDataType)):
+                # SBI is read as one band with interleaved complex data
+                rawBands[sbiFilename] = {'SourceFilename': sbiFilename,
+                                         'SourceBand': 1,
+                                         'SourceType': 'SimpleSource',
+                                         'DataType': sbiDataType}
                 # Add real and imaginary raw counts as bands
-                src = {'SourceFilename': filenames[i],
-                       'SourceBand': 1,
-                       'DataType': gdal.GDT_Int16}
-                dst = {'dataType': gdal.GDT_Float32,
-                       'name': 'RawCounts_%s_real' %
-                       gdalMetadata[filenames[i][-7:-4]+'_Polarisation']}
-                self.create_band(src, dst)
-
-                src = {'SourceFilename': filenames[i],
-                       'SourceBand': 2,
+                for part in ['real', 'imaginary']:
+                    dst = {'dataType': gdal.GDT_Float32,
+                           'name': 'RawCounts_%s_%s' % (polarisation, part),
+                           'PixelFunctionType': part[:4],
+                           'SourceTransferType':
+                                gdal.GetDataTypeName(sbiDataType)}
+                    self.create_band(rawBands[sbiFilename], dst)
+                continue
+
+            # Add real and imaginary raw counts as bands
+            rawBands[sbiFilename] = []
+            for sourceBand, part in [(1, 'real'), (2, 'imaginary')]:
+                src = {'SourceFilename': sbiFilename,
+                       'SourceBand': sourceBand,
                        'DataType': gdal.GDT_Int16}
                 dst = {'dataType': gdal.GDT_Float32,
-                       'name': 'RawCounts_%s_imaginary' %
-                       gdalMetadata[filenames[i][-7:-4] + '_Polarisation']}
+                       'name': 'RawCounts_%s_%s' % (polarisation, part)}
                 self.create_band(src, dst)
-
-                self.dataset.FlushCache()
-
-        for i, elem in enumerate(filenames):
-            if filenames[i][-3:] == 'SBI':
-                # Calculate sigma0 scaling factor
-                Rref = float(gdalMetadata['Reference_Slant_Range'])
-                Rexp = float(gdalMetadata['Reference_Slant_Range_Exponent'])
-                alphaRef = float(gdalMetadata['Reference_Incidence_Angle'])
-                F = float(gdalMetadata['Rescaling_Factor'])
-                K = float(gdalMetadata[filenames[i][-7:-4] +
-                          '_Calibration_Constant'])
-                Ftot = Rref**(2.*Rexp)
-                Ftot *= np.sin(alphaRef*np.pi / 180.0)
-                Ftot /= F**2.
-                Ftot /= K
-
-                #print Ftot
-
+                rawBands[sbiFilename].append(self.dataset.RasterCount)
+
+            self.dataset.FlushCache()
+
+        for sbiFilename in sbiFilenames:
+            polarisation = gdalMetadata[sbiFilename[-7:-4]+'_Polarisation']
+            # Calculate sigma0 scaling factor
+            Rref = float(gdalMetadata['Reference_Slant_Range'])
+            Rexp = float(gdalMetadata['Reference_Slant_Range_Exponent'])
+            alphaRef = float(gdalMetadata['Reference_Incidence_Angle'])
+            F = float(gdalMetadata['Rescaling_Factor'])
+            K = float(gdalMetadata[sbiFilename[-7:-4] +
+                      '_Calibration_Constant'])
+            Ftot = Rref**(2.*Rexp)
+            Ftot *= np.sin(alphaRef*np.pi / 180.0)
+            Ftot /= F**2.
+            Ftot /= K
+
+            dst = {'wkv': 'surface_backwards_scattering_coefficient_of_radar_wave',
+                   'polarisation': polarisation,
+                   'name': 'sigma0_%s' % polarisation,
+                   'SatelliteID': gdalMetadata['Satellite_ID'],
+                   'dataType': gdal.GDT_Float32}
+                   #'pass': gdalMetadata['']
+                   #         - I can't find this in the metadata...
+
+            if isinstance(rawBands[sbiFilename], dict):
+                # intensity of complex raw counts is computed in one pass
+                # and calibrated with Ftot as pixel function argument
+                src = rawBands[sbiFilename]
+                dst['PixelFunctionType'] = 'ScaledIntensity'
+                dst['PixelFunctionArguments'] = {'scale': repr(float(Ftot))}
+                dst['SourceTransferType'] = gdal.GetDataTypeName(src['DataType'])
+            else:
                 src = [{'SourceFilename': self.filename,
                         'DataType': gdal.GDT_Float32,
-                        'SourceBand': 2*i+1,
-                        'ScaleRatio': np.sqrt(Ftot)},
-                       {'SourceFilename': self.filename,
-                        'DataType': gdal.GDT_Float32,
-                        'SourceBand': 2*i+2,
-                        'ScaleRatio': np.sqrt(Ftot)}]
-                dst = {'wkv': 'surface_backwards_scattering_coefficient_of_radar_wave',
-                       'PixelFunctionType': 'RawcountsToSigma0_CosmoSkymed_SBI',
-                       'polarisation': gdalMetadata[filenames[i][-7:-4] +
-                                                    '_Polarisation'],
-                       'name': 'sigma0_%s' % gdalMetadata[filenames[i][-7:-4] +
-                                                          '_Polarisation'],
-                       'SatelliteID': gdalMetadata['Satellite_ID'],
-                       'dataType': gdal.GDT_Float32}
-                       #'pass': gdalMetadata['']
-                       #         - I can't find this in the metadata...
-
-                self.create_band(src, dst)
+                        'SourceBand': bandNo,
+                        'ScaleRatio': np.sqrt(Ftot)}
+                       for bandNo in rawBands[sbiFilename]]
+                dst['PixelFunctionType'] = 'RawcountsToSigma0_CosmoSkymed_SBI'
 
+            self.create_band(src, dst)
 
-                self.dataset.FlushCache()
+            self.dataset.FlushCache()
 
         self.dataset.SetMetadataItem('time_coverage_start',
                     parse_time(gdalMetadata['Scene_Sensing_Start_UTC']).isoformat())
@@ -9,8 +9,6 @@ import glob
 import os
 import datetime
 import json
-import tempfile
-import shutil
 
 import numpy as np
 
@@ -20,14 +18,23 @@ import pythesint as pti
 
 from nansat.exceptions import WrongMapperError
 from nansat.vrt import VRT
-from nansat.mappers.globcolour import Globcolour
+from nansat.nsr import NSR
+from nansat.domain import Domain
+from nansat.utils import gdal
+from nansat.mappers.globcolour import Globcolour, BinnedGrid
 
 
 class Mapper(VRT, Globcolour):
-    ''' Create VRT with mapping of WKV for MERIS Level 2 (FR or RR)'''
+    ''' Create VRT with mapping of WKV for MERIS Level 2 (FR or RR)
+
+    Bins are not remapped onto the destination grid when the file is opened:
+    bands are made with pixel function GlobcolourBins which remaps the bins of
+    the read window only (see globcolour.BinnedGrid.get_tables). With GDAL
+    older than 3.4 the bins are remapped once when the file is opened.
+    '''
 
     def __init__(self, filename, gdalDataset, gdalMetadata, latlonGrid=None,
-                 mask='', **kwargs):
+                 mask='', domain=None, **kwargs):
 
         ''' Create MER2 VRT
 
@@ -37,6 +44,9 @@ class Mapper(VRT, Globcolour):
         gdalDataset : gdal dataset
         gdalMetadata : gdal metadata
         latlonGrid : numpy 2 layered 2D array with lat/lons of desired grid
+        domain : Domain
+            destination grid. If neither <domain> nor <latlonGrid> is given,
+            global regular lat/lon grid with GLOBCOLOUR resolution is used.
         '''
         # test if input files is GLOBCOLOUR L3B
         iDir, iFile = os.path.split(filename)
@@ -50,19 +60,26 @@ class Mapper(VRT, Globcolour):
                      or gdalDataset.RasterCount > 0))):
             raise WrongMapperError
 
-        # define shape of GLOBCOLOUR grid
-        GLOBCOLOR_ROWS = 180 * 24
-        GLOBCOLOR_COLS = 360 * 24
-
-        # define lon/lat grids for projected var
-        if latlonGrid is None:
-            latlonGrid = np.mgrid[90:-90:4320j,
-                                  -180:180:8640j].astype('float32')
-            #latlonGrid = np.mgrid[80:50:900j, -10:30:1200j].astype('float16')
-            #latlonGrid = np.mgrid[47:39:300j, 25:45:500j].astype('float32')
-
-        # create empty VRT dataset with geolocation only
-        self._init_from_lonlat(latlonGrid[1], latlonGrid[0])
+        # define destination grid
+        if latlonGrid is None and domain is None:
+            domain = Domain(NSR(), '-te -180 -90 180 90 -ts %d %d' % (BinnedGrid.COLS,
+                                                                    BinnedGrid.ROWS))
+
+        if domain is None:
+            # create empty VRT dataset with geolocation only
+            self._init_from_lonlat(latlonGrid[1], latlonGrid[0])
+        else:
+            # create empty VRT dataset with georeference of the domain
+            self._init_from_gdal_dataset(domain.vrt.dataset,
+                                         geolocation=domain.vrt.geolocation)
+        lazy = int(gdal.VersionInfo()) >= 3040000
+        if lazy:
+            # latitude and longitude of the destination grid are sources of the bands
+            lat_vrt, lon_vrt = self._get_latlon_vrts(domain, latlonGrid)
+            self.band_vrts = {'lat': lat_vrt, 'lon': lon_vrt}
+        else:
+            lat, lon = self._get_latlon_grids(domain, latlonGrid)
+            self.band_vrts = {'mask': [], 'lonlat': []}
 
         # get list of similar (same date) files in the directory
         simFilesMask = os.path.join(iDir, iFileName[0:30] + '*' + mask + '.nc')
@@ -70,32 +87,10 @@ class Mapper(VRT, Globcolour):
         simFiles.sort()
 
         metaDict = []
-        self.band_vrts = {'mask': [], 'lonlat': []}
         mask = None
         for simFile in simFiles:
-            print('sim: ', simFile)
-            # copy simFile to a temporary file
-            tmpf = tempfile.mkstemp()
-            shutil.copyfile(simFile, tmpf[1])
-            f = Dataset(tmpf[1])
-
-            # get iBinned, index for converting from binned into GLOBCOLOR-grid
-            colBinned = f.variables['col'][:]
-            rowBinned = f.variables['row'][:]
-            iBinned = (colBinned.astype('uint32') +
-                      (rowBinned.astype('uint32') - 1) * GLOBCOLOR_COLS)
-            colBinned = None
-            rowBinned = None
-
-            # get iRawPro, index for converting
-            # from GLOBCOLOR-grid to latlonGrid
-            yRawPro = np.rint(1 + (GLOBCOLOR_ROWS - 1) *
-                              (latlonGrid[0] + 90) / 180.)
-            lon_step_Mat = 24. * np.cos(np.pi * latlonGrid[0] / 180.)
-            xRawPro = np.rint(1 + (latlonGrid[1] + 180) * lon_step_Mat)
-            iRawPro = xRawPro.astype('uint32') + (yRawPro.astype('uint32') - 1) * GLOBCOLOR_COLS
-            yRawPro = None
-            xRawPro = None
+            self.logger.debug('sim: %s' % simFile)
+            f = Dataset(simFile)
 
             for varName in f.variables:
                 # find variable with _mean, eg CHL1_mean
@@ -110,40 +105,38 @@ class Mapper(VRT, Globcolour):
             # get WKV
             varWKV = self.varname2wkv[varName]
 
-            # read binned data
-            varBinned = var[:]
-
-            # convert to GLOBCOLOR grid
-            varRawPro = np.zeros([GLOBCOLOR_ROWS, GLOBCOLOR_COLS], 'float32')
-            varRawPro.flat[iBinned] = varBinned
-
-            # convert to latlonGrid
-            varPro = varRawPro.flat[iRawPro.flat[:]].reshape(iRawPro.shape)
+            grid = BinnedGrid.from_dataset(f)
+            if lazy:
+                # keep only the tables of bins, remap them on reading
+                tables = grid.get_tables(var[:])
+                for key in tables:
+                    self.band_vrts['%s_%s' % (varName, key)] = tables[key]
+            else:
+                varPro = BinnedGrid.remap(var[:], grid.get_index(
+                    *BinnedGrid.grid_rows_cols(lat, lon)))
 
             # add mask band
             if mask is None:
-                mask = np.zeros(varPro.shape, 'uint8')
-                mask[:] = 1
-                mask[varPro > 0] = 64
-
-                # add VRT with array with data from projected variable
-                self.band_vrts['mask'].append(VRT.from_array(mask))
-
-                # add metadata to the dictionary
-                metaDict.append({
-                    'src': {'SourceFilename': (self.band_vrts['mask'][-1].
-                                               filename),
-                            'SourceBand':  1},
-                    'dst': {'name': 'mask'}})
-
-            # add VRT with array with data from projected variable
-            self.band_vrts['lonlat'].append(VRT.from_array(varPro))
+                if lazy:
+                    mask = self._binned_meta_entry(tables, mask=True)
+                else:
+                    self.band_vrts['mask'].append(VRT.from_array(
+                        np.where(varPro > 0, 64, 1).astype('uint8')))
+                    mask = {'src': {'SourceFilename': self.band_vrts['mask'][-1].filename,
+                                    'SourceBand':  1},
+                            'dst': {}}
+                mask['dst']['name'] = 'mask'
+                metaDict.append(mask)
 
             # add metadata to the dictionary
-            metaEntry = {
-                'src': {'SourceFilename': self.band_vrts['lonlat'][-1].filename,
-                        'SourceBand':  1},
-                'dst': {'wkv': varWKV, 'original_name': varName}}
+            if lazy:
+                metaEntry = self._binned_meta_entry(tables)
+            else:
+                self.band_vrts['lonlat'].append(VRT.from_array(varPro))
+                metaEntry = {'src': {'SourceFilename': self.band_vrts['lonlat'][-1].filename,
+                                     'SourceBand':  1},
+                             'dst': {}}
+            metaEntry['dst'].update({'wkv': varWKV, 'original_name': varName})
 
             # add wavelength for nLw
             longName = 'Fully normalised water leaving radiance'
@@ -163,8 +156,6 @@ class Mapper(VRT, Globcolour):
             if metaEntry2 is not None:
                 metaDict.append(metaEntry2)
 
-            os.remove(tmpf[1])
-
         instrument = f.title.strip().split(' ')[-2].split('/')[0]
         mm = pti.get_gcmd_instrument(instrument)
         self.dataset.SetMetadataItem('instrument', json.dumps(mm))
@@ -188,3 +179,53 @@ class Mapper(VRT, Globcolour):
         # Adding valid time to dataset
         self.dataset.SetMetadataItem('time_coverage_start', startDate.isoformat())
         self.dataset.SetMetadataItem('time_coverage_end', startDate.isoformat())
+
+    def _binned_meta_entry(self, tables, mask=False):
+        ''' Make metaEntry for a band with pixel function remapping bins from <tables> '''
+        return {
+            'src': [{'SourceFilename': vrt.filename,
+                     'SourceBand': 1,
+                     'xSize': vrt.dataset.RasterXSize,
+                     'ySize': vrt.dataset.RasterYSize,
+                     'dstXSize': self.dataset.RasterXSize,
+                     'dstYSize': self.dataset.RasterYSize}
+                    for vrt in [self.band_vrts['lat'], self.band_vrts['lon']]],
+            'dst': {'PixelFunctionType': 'GlobcolourBins',
+                    'SourceTransferType': 'Float64',
+                    'PixelFunctionArguments': BinnedGrid.get_pixfun_arguments(tables, mask),
+                    'dataType': gdal.GDT_Byte if mask else gdal.GDT_Float32}}
+
+    @staticmethod
+    def _get_latlon_grids(domain, latlonGrid):
+        ''' Get latitude and longitude grids of the destination grid '''
+        if domain is None:
+            return latlonGrid[0], latlonGrid[1]
+        lon, lat = domain.get_geolocation_grids()
+        return lat, lon
+
+    @classmethod
+    def _get_latlon_vrts(cls, domain, latlonGrid):
+        ''' Get VRTs with latitude and longitude of the destination grid
+
+        For a regular lat/lon domain (e.g. the default global grid), latitude
+        is one column and longitude is one row which are stretched to the
+        size of the domain by the band sources, so no full size grids are
+        created. Otherwise full size latitude and longitude grids are used.
+
+        Returns
+        -------
+        lat_vrt, lon_vrt : VRT
+            VRTs with latitude and longitude
+        '''
+        if domain is not None:
+            projection, source = domain.vrt.get_projection()
+            gt = domain.vrt.dataset.GetGeoTransform()
+            if (source == 'dataset' and NSR(projection).IsGeographic() and
+                    gt[2] == 0 and gt[4] == 0):
+                y_size, x_size = domain.shape()
+                lat = gt[3] + np.arange(y_size) * gt[5]
+                lon = gt[0] + np.arange(x_size) * gt[1]
+                return (VRT.from_array(lat.reshape(y_size, 1)),
+                        VRT.from_array(lon.reshape(1, x_size)))
+        lat, lon = cls._get_latlon_grids(domain, latlonGrid)
+        return VRT.from_array(lat), VRT.from_array(lon)
@@ -5,13 +5,11 @@
 # Licence:      This file is part of NANSAT. You can redistribute it or modify
 #               under the terms of GNU General Public License, v.3
 #               http://www.gnu.org/licenses/gpl-3.0.html
-import datetime
 import json
 
-import numpy
-
 from nansat.vrt import VRT
 from nansat.exceptions import WrongMapperError
+from nansat.mappers.grib_index import GribIndex
 
 import pythesint as pti
 
@@ -19,7 +17,8 @@ import pythesint as pti
 class Mapper(VRT):
     ''' VRT with mapping of WKV for HIRLAM '''
 
-    def __init__(self, filename, gdalDataset, gdalMetadata, **kwargs):
+    def __init__(self, filename, gdalDataset, gdalMetadata, cachedir=None,
+                 **kwargs):
 
         try:
             geo_transform = gdalDataset.GetGeoTransform()[0:5]
@@ -28,40 +27,32 @@ class Mapper(VRT):
         if geo_transform != (-12.1, 0.2, 0.0, 81.95, 0.0):
             raise WrongMapperError
 
-        metaDict = [{'src': {'SourceFilename': filename,
-                             'SourceBand': 2,
-                             'NODATA': 9999},
+        # HIRLAM files use local parameter tables: wind at the first time
+        # step is in fields 2 and 3, read from their messages only
+        grib_index = GribIndex(filename, cachedir)
+        # VRT is created from the first message, not from the whole file
+        grid_dataset = grib_index.first_dataset()
+        size = {'xSize': grid_dataset.RasterXSize,
+                'ySize': grid_dataset.RasterYSize}
+        u_src = grib_index.field_source(2, **size)
+        v_src = grib_index.field_source(3, **size)
+
+        metaDict = [{'src': dict(u_src, NODATA=9999),
                      'dst': {'wkv': 'eastward_wind',
                              'height': '10 m'}
                      },
-                    {'src': {'SourceFilename': filename,
-                             'SourceBand': 3,
-                             'NODATA': 9999},
+                    {'src': dict(v_src, NODATA=9999),
                      'dst': {'wkv': 'northward_wind',
                              'height': '10 m'}
                      },
-                    {'src': [{'SourceFilename': filename,
-                              'SourceBand': 2,
-                              'DataType': gdalDataset.GetRasterBand(2).DataType
-                              },
-                             {'SourceFilename': filename,
-                              'SourceBand': 3,
-                              'DataType': gdalDataset.GetRasterBand(3).DataType
-                              }],
+                    {'src': [u_src, v_src],
                      'dst': {'wkv': 'wind_speed',
                              'name': 'windspeed',
                              'height': '10 m',
                              'PixelFunctionType': 'UVToMagnitude',
                              'NODATA': 9999}
                      },
-                    {'src': [{'SourceFilename': filename,
-                              'SourceBand': 2,
-                              'DataType': gdalDataset.GetRasterBand(2).DataType
-                              },
-                             {'SourceFilename': filename,
-                              'SourceBand': 3,
-                              'DataType': gdalDataset.GetRasterBand(3).DataType
-                              }],
+                    {'src': [u_src, v_src],
                      'dst': {'wkv': 'wind_from_direction',
                              'name': 'winddirection',
                              'height': '10 m',
@@ -71,7 +62,7 @@ class Mapper(VRT):
                      }]
 
         # create empty VRT dataset with geolocation only
-        self._init_from_gdal_dataset(gdalDataset, metadata=gdalMetadata)
+        self._init_from_gdal_dataset(grid_dataset, metadata=gdalMetadata)
 
         # Create bands
         self.create_bands(metaDict)
@@ -79,18 +70,16 @@ class Mapper(VRT):
         # set source, start_date, stop_date
         self.dataset.SetMetadataItem('source', 'HIRLAM')
 
-        # Adding valid time from the GRIB file to dataset
-        start_date = gdalDataset.GetRasterBand(1).GetMetadata()['GRIB_VALID_TIME']
-        self.dataset.SetMetadataItem('time_coverage_start',
-                datetime.datetime.utcfromtimestamp(
-                int(start_date.strip().split(' ')[0])).isoformat() + '+00:00')
-
-        stop_date = gdalDataset.GetRasterBand(gdalDataset.RasterCount).GetMetadata()['GRIB_VALID_TIME']
-        self.dataset.SetMetadataItem('time_coverage_end',
-                datetime.datetime.utcfromtimestamp(
-                int(stop_date.strip().split(' ')[0])).isoformat() + '+00:00')
+        # Adding valid time of all messages in the GRIB file to dataset
+        # (not available if units of forecast time are unknown)
+        valid_times = grib_index.valid_times()
+        if valid_times:
+            self.dataset.SetMetadataItem('time_coverage_start',
+                                         valid_times[0] + '+00:00')
+            self.dataset.SetMetadataItem('time_coverage_end',
+                                         valid_times[-1] + '+00:00')
 
         mm = pti.get_gcmd_instrument('computer')
         self.dataset.SetMetadataItem('instrument', json.dumps(mm))
         ee = pti.get_gcmd_platform('merged analysis')
-        self.dataset.SetMetadataItem('platform', json.dump(ee))
+        self.dataset.SetMetadataItem('platform', json.dumps(ee))
@@ -6,7 +6,6 @@
 #               http://www.gnu.org/licenses/gpl-3.0.html
 import os
 import glob
-import tarfile
 import warnings
 import datetime
 import json
@@ -15,6 +14,7 @@ import pythesint as pti
 
 from nansat.utils import gdal, np, parse_time
 from nansat.vrt import VRT
+from nansat.mappers.tar_index import TarIndex
 
 from nansat.exceptions import WrongMapperError
 
@@ -22,10 +22,20 @@ class Mapper(VRT):
     ''' Mapper for LANDSAT5,6,7,8 .tar.gz or tif files'''
 
     def __init__(self, filename, gdalDataset, gdalMetadata,
-                       resolution='low', **kwargs):
-        ''' Create LANDSAT VRT from multiple tif files or single tar.gz file'''
+                       resolution='low', cachedir=None, **kwargs):
+        ''' Create LANDSAT VRT from multiple tif files or single tar.gz file
+
+        Parameters
+        ----------
+        resolution : str
+            'low' or 'high' - use bands with lowest or highest resolution
+        cachedir : str
+            existing directory for keeping decompressed .tar.gz archive and
+            index of its members for fast random access to the bands
+        '''
         mtlFileName = ''
         bandFileNames = []
+        bandSuffixes = []
         bandSizes = []
         bandDatasets = []
         fname = os.path.split(filename)[1]
@@ -33,30 +43,27 @@ class Mapper(VRT):
         if   (filename.endswith('.tar') or
               filename.endswith('.tar.gz') or
               filename.endswith('.tgz')):
-            # try to open .tar or .tar.gz or .tgz file with tar
-            try:
-                tarFile = tarfile.open(filename)
-            except:
-                raise WrongMapperError
+            # index members of .tar or .tar.gz or .tgz file
+            tarIndex = TarIndex(filename, cachedir)
 
             # collect names of bands and corresponding sizes
             # into bandsInfo dict and bandSizes list
-            tarNames = sorted(tarFile.getnames())
-            for tarName in tarNames:
+            for tarName in tarIndex.names():
                 # check if TIF files inside TAR qualify
                 if   (tarName[0] in ['L', 'M'] and
                       os.path.splitext(tarName)[1] in ['.TIF', '.tif']):
                     # open TIF file from TAR using VSI
-                    sourceFilename = '/vsitar/%s/%s' % (filename, tarName)
+                    sourceFilename = tarIndex.vsi_filename(tarName)
                     gdalDatasetTmp = gdal.Open(sourceFilename)
                     # keep name, GDALDataset and size
                     bandFileNames.append(sourceFilename)
+                    bandSuffixes.append(self._band_suffix(tarName))
                     bandSizes.append(gdalDatasetTmp.RasterXSize)
                     bandDatasets.append(gdalDatasetTmp)
                 elif (tarName.endswith('MTL.txt') or
                       tarName.endswith('MTL.TXT')):
                     # get mtl file
-                    mtlFileName = tarName
+                    mtlFileName = tarIndex.vsi_filename(tarName)
 
         elif ((fname.startswith('L') or fname.startswith('M')) and
               (fname.endswith('.tif') or
@@ -73,11 +80,13 @@ class Mapper(VRT):
                 gdalDatasetTmp = gdal.Open(sourceFilename)
                 # keep name, GDALDataset and size
                 bandFileNames.append(sourceFilename)
+                bandSuffixes.append(self._band_suffix(tifName))
                 bandSizes.append(gdalDatasetTmp.RasterXSize)
                 bandDatasets.append(gdalDatasetTmp)
 
             # get mtl file
-            mtlFiles = glob.glob(coreName+'*[mM][tT][lL].[tT][xX][tT]')
+            mtlFiles = glob.glob(os.path.join(path,
+                                    coreName+'*[mM][tT][lL].[tT][xX][tT]'))
             if len(mtlFiles) > 0:
                 mtlFileName = mtlFiles[0]
         else:
@@ -98,13 +107,9 @@ class Mapper(VRT):
 
         # find bands with appropriate size and put to metaDict
         metaDict = []
-        for bandFileName, bandSize, bandDataset in zip(bandFileNames,
-                                                       bandSizes,
-                                                       bandDatasets):
+        for bandFileName, bandSuffix, bandSize, bandDataset in zip(
+                bandFileNames, bandSuffixes, bandSizes, bandDatasets):
             if bandSize == bandXSise:
-                # let last part of file name be suffix
-                bandSuffix = os.path.splitext(bandFileName)[0].split('_')[-1]
-
                 metaDict.append({
                     'src': {'SourceFilename': bandFileName,
                             'SourceBand':  1,
@@ -120,8 +125,6 @@ class Mapper(VRT):
         self.create_bands(metaDict)
 
         if len(mtlFileName) > 0:
-            mtlFileName = os.path.join(os.path.split(bandFileNames[0])[0],
-                                        mtlFileName)
             mtlFileLines = [line.strip() for line in self.read_vsi(mtlFileName).split('\n')]
             dateString = [line.split('=')[1].strip()
                           for line in mtlFileLines
@@ -158,3 +161,7 @@ class Mapper(VRT):
         ee = pti.get_gcmd_instrument(instrument)
         self.dataset.SetMetadataItem('instrument', json.dumps(ee))
 
+    @staticmethod
+    def _band_suffix(bandFileName):
+        ''' Let last part of file name be suffix '''
+        return os.path.splitext(bandFileName)[0].split('_')[-1]
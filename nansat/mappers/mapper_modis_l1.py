@@ -16,13 +16,24 @@ from nansat.utils import gdal, ogr
 from nansat.exceptions import WrongMapperError
 from nansat.vrt import VRT
 from nansat.mappers.hdf4_mapper import HDF4Mapper
+from nansat.mappers.gcps import get_swath_gcps
 
 
 class Mapper(HDF4Mapper):
     ''' VRT with mapping of WKV for MODIS Level 1 (QKM, HKM, 1KM) '''
 
-    def __init__(self, filename, gdalDataset, gdalMetadata, GCP_COUNT=30, **kwargs):
-        ''' Create MODIS_L1 VRT '''
+    def __init__(self, filename, gdalDataset, gdalMetadata, GCP_COUNT=30,
+                 GCP_TOLERANCE=None, **kwargs):
+        ''' Create MODIS_L1 VRT
+
+        Parameters
+        ----------
+        GCP_COUNT : int
+            number of GCPs along each dimention
+        GCP_TOLERANCE : float
+            if given, GCPs are added near swath edges where error of linear
+            interpolation of lon/lat between GCPs exceeds tolerance (degrees)
+        '''
 
         #list of available modis names:resolutions
         modisResolutions = {'MYD02QKM': 250, 'MOD02QKM': 250,
@@ -370,17 +381,12 @@ class Mapper(HDF4Mapper):
         latSubdataset = [subdatasetName[0]
                          for subdatasetName in gdalDataset.GetSubDatasets()
                          if 'Latitude' in subdatasetName[1]][0]
-        lons = gdal.Open(lonSubdataset).ReadAsArray()
-        lats = gdal.Open(latSubdataset).ReadAsArray()
-        gcps = []
-        rows = range(0, lons.shape[0], int(lons.shape[0]/GCP_COUNT))
-        cols = range(0, lons.shape[1], int(lons.shape[1]/GCP_COUNT))
-        factor = self.dataset.RasterYSize / lons.shape[0]
-        for r in rows:
-            for c in cols:
-                gcps.append(gdal.GCP(float(lons[r,c]),
-                                     float(lats[r,c]), 0,
-                                     factor*c+0.5,
-                                     factor*r+0.5))
+        lonDataset = gdal.Open(lonSubdataset)
+        latDataset = gdal.Open(latSubdataset)
+        factor = self.dataset.RasterYSize / lonDataset.RasterYSize
+        gcps = get_swath_gcps(lonDataset.GetRasterBand(1),
+                              latDataset.GetRasterBand(1), GCP_COUNT,
+                              line_step=factor, pixel_step=factor,
+                              tolerance=GCP_TOLERANCE)
         self.dataset.SetGCPs(gcps, self.dataset.GetGCPProjection())
         self.tps = True
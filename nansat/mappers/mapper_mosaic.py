@@ -0,0 +1,259 @@
+# Name:        mapper_mosaic
+# Purpose:     Virtual mosaic of several granules or tiles opened as one dataset
+# Authors:      Anton Korosov
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+#
+# Usage:
+#    n = Nansat('mosaic:/path/to/A2014*.L2_LAC_OC.nc')
+#    n = Nansat('mosaic:', mosaic_files=[filename1, filename2])
+import glob
+
+from nansat.vrt import VRT
+from nansat.geolocation import Geolocation
+from nansat.nsr import NSR
+from nansat.utils import gdal
+from nansat.exceptions import WrongMapperError
+from nansat.nansat import Nansat
+
+# metadata of granule bands which are not copied to the mosaic bands
+SKIP_METADATA = ['SourceFilename', 'SourceBand', 'PixelFunctionType',
+                 'SourceTransferType', 'dataType']
+
+
+class Mapper(VRT):
+    """Virtual mosaic of granules or tiles of the same product
+
+    Each file is opened with Nansat and the mosaic band references the bands
+    of all granules at their offsets in the mosaic. Nothing is read when the
+    mosaic is created and reading (or cropping) a window opens only the
+    granules which overlap with the window.
+
+    Gridded granules (with geotransform) must have the same projection and
+    pixel size, they are placed by their geotransform. Swath granules (with
+    GCPs or geolocation arrays) must have the same width, they are
+    concatenated along track in the given order: GCPs are transformed to the
+    GCP projection of the first granule and shifted by the line offset of
+    each granule, geolocation arrays (of the same width and SRS) are
+    concatenated into a mosaic of geolocation arrays (height of granules must
+    be the number of geolocation lines times LINE_STEP).
+
+    Only bands available in all granules are added (names from the first
+    granule).
+
+    Parameters
+    ----------
+    filename : str
+        'mosaic:' followed by a glob pattern of the granules
+    gdalDataset : None
+    gdalMetadata : None
+    mosaic_files : list of str
+        names of granules (instead of the pattern)
+    mosaic_mapper : str
+        name of the mapper for opening the granules
+    **kwargs
+        other arguments for opening the granules
+
+    """
+    def __init__(self, filename, gdalDataset, gdalMetadata,
+                 mosaic_files=None, mosaic_mapper='', **kwargs):
+        keyword_base = 'mosaic:'
+        if not filename.startswith(keyword_base):
+            raise WrongMapperError
+
+        if mosaic_files is None:
+            mosaic_files = sorted(glob.glob(filename[len(keyword_base):]))
+        if not mosaic_files:
+            raise WrongMapperError('%s: no files found' % filename)
+
+        granules = [Nansat(granule_file, mapper=mosaic_mapper, **kwargs)
+                    for granule_file in mosaic_files]
+
+        if all(self._is_gridded(granule) for granule in granules):
+            offsets = self._init_gridded(granules)
+        else:
+            offsets = self._init_swath(granules)
+
+        # granule VRTs are kept for reading the mosaic bands
+        for i, granule in enumerate(granules):
+            self.band_vrts['granule_%d' % i] = granule.vrt
+
+        self._create_mosaic_bands(granules, offsets)
+
+        # valid time of the mosaic covers all granules
+        for key, select in [('time_coverage_start', min),
+                            ('time_coverage_end', max)]:
+            times = [granule.get_metadata(key) for granule in granules
+                     if key in granule.get_metadata()]
+            if times:
+                self.dataset.SetMetadataItem(key, select(times))
+
+    @staticmethod
+    def _is_gridded(granule):
+        """Has granule a geotransform (and no GCPs or geolocation)?"""
+        geolocation = granule.vrt.geolocation
+        return (granule.vrt.dataset.GetGCPCount() == 0 and
+                (geolocation is None or len(geolocation.data) == 0) and
+                granule.vrt.dataset.GetGeoTransform() != (0, 1, 0, 0, 0, 1))
+
+    def _init_gridded(self, granules):
+        """Init mosaic with union of granule extents, return granule offsets"""
+        geo_transforms = [granule.vrt.dataset.GetGeoTransform()
+                          for granule in granules]
+        projection = granules[0].vrt.dataset.GetProjection()
+        x_res, y_res = geo_transforms[0][1], geo_transforms[0][5]
+        for granule, geo_transform in zip(granules, geo_transforms):
+            if (granule.vrt.dataset.GetProjection() != projection or
+                    geo_transform[1] != x_res or geo_transform[5] != y_res or
+                    geo_transform[2] != 0 or geo_transform[4] != 0):
+                raise ValueError('Granules have different projection or '
+                                 'resolution: %s' % granule.filename)
+
+        x_min = min(gt[0] for gt in geo_transforms)
+        x_max = max(gt[0] + x_res * granule.vrt.dataset.RasterXSize
+                    for gt, granule in zip(geo_transforms, granules))
+        # select(y) gives the first line (top for north-up grids)
+        select = max if y_res < 0 else min
+        y_first = select(gt[3] for gt in geo_transforms)
+        y_last = select(gt[3] + y_res * granule.vrt.dataset.RasterYSize
+                        for gt, granule in zip(geo_transforms, granules))
+        self._init_from_dataset_params(
+            int(round((x_max - x_min) / x_res)),
+            int(round((y_last - y_first) / y_res)),
+            (x_min, x_res, 0, y_first, 0, y_res), projection)
+
+        return [(int(round((gt[0] - x_min) / x_res)),
+                 int(round((gt[3] - y_first) / y_res)))
+                for gt in geo_transforms]
+
+    def _init_swath(self, granules):
+        """Init mosaic of granules concatenated along track, return offsets"""
+        x_size = granules[0].vrt.dataset.RasterXSize
+        if any(granule.vrt.dataset.RasterXSize != x_size
+               for granule in granules):
+            raise ValueError('Swath granules have different width')
+        y_offsets = [0]
+        for granule in granules:
+            y_offsets.append(y_offsets[-1] +
+                             granule.vrt.dataset.RasterYSize)
+
+        has_geolocation = [granule.vrt.geolocation is not None and
+                           len(granule.vrt.geolocation.data) > 0
+                           for granule in granules]
+        if all(has_geolocation):
+            self._init_from_dataset_params(
+                x_size, y_offsets[-1], (0, 1, 0, y_offsets[-1], 0, -1),
+                granules[0].vrt.geolocation.data['SRS'])
+            self._add_geolocation(self._concatenate_geolocation(granules))
+        elif any(has_geolocation):
+            raise ValueError('Some swath granules have no geolocation arrays')
+        else:
+            gcp_projection = (granules[0].vrt.dataset.GetGCPProjection() or
+                              NSR().wkt)
+            gcps = []
+            for granule, y_offset in zip(granules, y_offsets):
+                gcps += self._shift_gcps(granule, y_offset, NSR(gcp_projection))
+            self._init_from_dataset_params(
+                x_size, y_offsets[-1], (0, 1, 0, y_offsets[-1], 0, -1),
+                NSR().wkt, gcps=gcps, gcp_projection=gcp_projection)
+
+        return [(0, y_offset) for y_offset in y_offsets[:-1]]
+
+    @staticmethod
+    def _shift_gcps(granule, y_offset, dst_srs):
+        """GCPs of granule in dst_srs with lines shifted by y_offset"""
+        granule_gcps = granule.vrt.dataset.GetGCPs()
+        if not granule_gcps:
+            raise ValueError('Swath granule has no GCPs: %s' % granule.filename)
+        x = [gcp.GCPX for gcp in granule_gcps]
+        y = [gcp.GCPY for gcp in granule_gcps]
+        z = [gcp.GCPZ for gcp in granule_gcps]
+        src_srs = NSR(granule.vrt.dataset.GetGCPProjection() or NSR().wkt)
+        if not src_srs.IsSame(dst_srs):
+            x, y, z = VRT.transform_coordinates(src_srs, (x, y, z), dst_srs)
+        return [gdal.GCP(float(x[i]), float(y[i]), float(z[i]), gcp.GCPPixel,
+                         gcp.GCPLine + y_offset)
+                for i, gcp in enumerate(granule_gcps)]
+
+    def _concatenate_geolocation(self, granules):
+        """Geolocation with mosaics of X and Y geolocation arrays"""
+        data0 = granules[0].vrt.geolocation.data
+        keys = ['SRS', 'LINE_OFFSET', 'LINE_STEP', 'PIXEL_OFFSET', 'PIXEL_STEP']
+        datasets = []
+        for granule in granules:
+            data = granule.vrt.geolocation.data
+            if any(data.get(key) != data0.get(key) for key in keys):
+                raise ValueError('Granules have different geolocation: %s' %
+                                 granule.filename)
+            datasets.append((gdal.Open(data['X_DATASET']),
+                             gdal.Open(data['Y_DATASET'])))
+            if (datasets[-1][0].RasterXSize != datasets[0][0].RasterXSize or
+                    datasets[-1][1].RasterXSize != datasets[0][0].RasterXSize or
+                    datasets[-1][0].RasterYSize != datasets[-1][1].RasterYSize):
+                raise ValueError('Geolocation arrays of granules have '
+                                 'different size: %s' % granule.filename)
+            # lines of geolocation arrays are stacked: offset and step of the
+            # first granule are valid for the next granules only if each
+            # granule (but the last) has exactly RasterYSize / LINE_STEP lines
+            if (granule is not granules[-1] and
+                    datasets[-1][0].RasterYSize * float(data['LINE_STEP']) !=
+                    granule.vrt.dataset.RasterYSize):
+                raise ValueError('Height of granule is not a multiple of the step '
+                                 'of geolocation lines: %s' % granule.filename)
+
+        x_size = datasets[0][0].RasterXSize
+        y_size = sum(x_dataset.RasterYSize for x_dataset, _ in datasets)
+        mosaic_vrts = []
+        for i, (key, band_key) in enumerate([('X_DATASET', 'X_BAND'),
+                                             ('Y_DATASET', 'Y_BAND')]):
+            mosaic_vrt = VRT(x_size=x_size, y_size=y_size)
+            srcs = []
+            y_offset = 0
+            for granule, granule_datasets in zip(granules, datasets):
+                data = granule.vrt.geolocation.data
+                band = granule_datasets[i].GetRasterBand(int(data[band_key]))
+                srcs.append({'SourceFilename': data[key],
+                             'SourceBand': int(data[band_key]),
+                             'DataType': band.DataType,
+                             'xSize': band.XSize,
+                             'ySize': band.YSize,
+                             'dstYOff': y_offset})
+                y_offset += band.YSize
+            mosaic_vrt.create_band(srcs, {'dataType': srcs[0]['DataType']})
+            mosaic_vrts.append(mosaic_vrt)
+
+        return Geolocation(mosaic_vrts[0], mosaic_vrts[1],
+                           srs=data0['SRS'],
+                           line_offset=data0['LINE_OFFSET'],
+                           line_step=data0['LINE_STEP'],
+                           pixel_offset=data0['PIXEL_OFFSET'],
+                           pixel_step=data0['PIXEL_STEP'])
+
+    def _create_mosaic_bands(self, granules, offsets):
+        """Add bands referencing the same band of all granules at offsets"""
+        granule_bands = [dict((band['name'], (band_number, band))
+                              for band_number, band in granule.bands().items())
+                         for granule in granules]
+        for band_number, metadata in sorted(granules[0].bands().items()):
+            name = metadata['name']
+            if not all(name in bands for bands in granule_bands):
+                continue
+            srcs = []
+            for granule, bands, (x_offset, y_offset) in zip(granules,
+                                                            granule_bands,
+                                                            offsets):
+                granule_band_number = bands[name][0]
+                srcs.append({'SourceFilename': granule.vrt.filename,
+                             'SourceBand': granule_band_number,
+                             'DataType': granule.vrt.dataset.GetRasterBand(
+                                 granule_band_number).DataType,
+                             'xSize': granule.vrt.dataset.RasterXSize,
+                             'ySize': granule.vrt.dataset.RasterYSize,
+                             'dstXOff': x_offset,
+                             'dstYOff': y_offset})
+            dst = dict((key, metadata[key]) for key in metadata
+                       if key not in SKIP_METADATA)
+            dst['dataType'] = srcs[0]['DataType']
+            self.create_band(srcs, dst)
+        self.dataset.FlushCache()
@@ -6,9 +6,8 @@
 #               http://www.gnu.org/licenses/gpl-3.0.html
 #
 # Made for GRIB files downloaded from http://nomads.ncep.noaa.gov/
-# NB: Band numbers is hardcoded for band subsets extracted at NERSC,
-# mapper will not work for other NCEP GFS files before made more generic
-import datetime
+# Bands are selected by parameter and level from the inventory of GRIB
+# messages (see nansat.mappers.grib_index)
 import json
 import numpy as np
 from dateutil.parser import parse
@@ -16,81 +15,62 @@ import pythesint as pti
 
 from nansat.vrt import VRT
 from nansat.exceptions import WrongMapperError
+from nansat.mappers.grib_index import GribIndex
 
 
 class Mapper(VRT):
     ''' VRT with mapping of WKV for NCEP GFS '''
 
-    def __init__(self, filename, gdalDataset, gdalMetadata, **kwargs):
+    def __init__(self, filename, gdalDataset, gdalMetadata, cachedir=None,
+                 **kwargs):
         ''' Create NCEP VRT '''
 
         if not gdalDataset:
             raise WrongMapperError(filename)
 
         geotransform = gdalDataset.GetGeoTransform()
-        if (geotransform == (-0.25, 0.5, 0.0, 90.25, 0.0, -0.5) or
-                geotransform == (-0.5, 1.0, 0.0, 90.5, 0.0, -1.0)):
-            if gdalDataset.RasterCount == 4:
-                srcBandId = {'temperature': 2,
-                             'u-component': 3,
-                             'v-component': 4}
-            elif gdalDataset.RasterCount == 9:
-                srcBandId = {'temperature': 6,
-                             'u-component': 8,
-                             'v-component': 9}
-            else:
-                raise WrongMapperError(filename)
-        else:
+        if (geotransform != (-0.25, 0.5, 0.0, 90.25, 0.0, -0.5) and
+                geotransform != (-0.5, 1.0, 0.0, 90.5, 0.0, -1.0)):
             raise WrongMapperError(filename)  # Not water proof
 
+        # only the needed messages are decoded by GDAL
+        grib_index = GribIndex(filename, cachedir)
+        # VRT is created from the first message, not from the whole file
+        grid_dataset = grib_index.first_dataset()
+        size = {'xSize': grid_dataset.RasterXSize,
+                'ySize': grid_dataset.RasterYSize}
+        u_src = grib_index.band_source('UGRD', 'HTGL', 10, **size)
+        v_src = grib_index.band_source('VGRD', 'HTGL', 10, **size)
+        t_src = grib_index.band_source('TMP', 'HTGL', 2, **size)
+
         # Adding valid time from the GRIB file to dataset
-        band = gdalDataset.GetRasterBand(srcBandId['u-component'])
-        validTime = band.GetMetadata()['GRIB_VALID_TIME']
-        time_isoformat = (datetime.datetime.utcfromtimestamp(
-            int(validTime.strip().split(' ')[0])).isoformat())
+        time_isoformat = grib_index.select('UGRD', 'HTGL', 10)[0]['valid_time']
 
         # Set band metadata time_iso_8601 for use in OpenWind
         time_iso_8601 = np.datetime64(parse(time_isoformat))
-        metaDict = [{'src': {'SourceFilename': filename,
-                             'SourceBand': srcBandId['u-component']},
+        metaDict = [{'src': u_src,
                      'dst': {'wkv': 'eastward_wind',
                              'height': '10 m',
                              'time_iso_8601': time_iso_8601}},
-                    {'src': {'SourceFilename': filename,
-                             'SourceBand': srcBandId['v-component']},
+                    {'src': v_src,
                      'dst': {'wkv': 'northward_wind',
                              'height': '10 m',
                              'time_iso_8601': time_iso_8601}},
-                    {'src': [{'SourceFilename': filename,
-                              'SourceBand': srcBandId['u-component'],
-                              'DataType': (gdalDataset.GetRasterBand(srcBandId['u-component']).DataType)
-                              },
-                             {'SourceFilename': filename,
-                              'SourceBand': srcBandId['v-component'],
-                              'DataType': gdalDataset.GetRasterBand(srcBandId['v-component']).DataType
-                              }],
+                    {'src': [u_src, v_src],
                      'dst': {'wkv': 'wind_speed',
                              'PixelFunctionType': 'UVToMagnitude',
                              'name': 'windspeed',
                              'height': '2 m',
                              'time_iso_8601': time_iso_8601
                              }},
-                    {'src': [{'SourceFilename': filename,
-                              'SourceBand': srcBandId['u-component'],
-                              'DataType': gdalDataset.GetRasterBand(srcBandId['u-component']).DataType
-                              },
-                             {'SourceFilename': filename,
-                              'SourceBand': srcBandId['v-component'],
-                              'DataType': gdalDataset.GetRasterBand(srcBandId['v-component']).DataType
-                              }],
+                    {'src': [u_src, v_src],
                      'dst': {'wkv': 'wind_from_direction',
                              'PixelFunctionType': 'UVToDirectionFrom',
                              'name': 'winddirection',
                              'height': '2 m',
                              'time_iso_8601': time_iso_8601
                              }},
-                    {'src': {'SourceFilename': filename,
-                             'SourceBand': srcBandId['temperature']},
+                    {'src': t_src,
                      'dst': {'wkv': 'air_temperature',
                              'name': 'air_t',
                              'height': '2 m',
@@ -98,7 +78,7 @@ class Mapper(VRT):
                      }]
 
         # create empty VRT dataset with geolocation only
-        self._init_from_gdal_dataset(gdalDataset)
+        self._init_from_gdal_dataset(grid_dataset)
 
         # add bands with metadata and corresponding values to the empty VRT
         self.create_bands(metaDict)
@@ -7,57 +7,52 @@
 #               http://www.gnu.org/licenses/gpl-3.0.html
 #
 # Made for GRIB files downloaded from http://nomads.ncep.noaa.gov/data/gfs4/
-import datetime
 import json
 import pythesint as pti
 
 from nansat.vrt import VRT
 from nansat.exceptions import WrongMapperError
+from nansat.mappers.grib_index import GribIndex
 
 
 class Mapper(VRT):
     ''' VRT with mapping of WKV for NCEP GFS '''
 
-    def __init__(self, filename, gdalDataset, gdalMetadata, **kwargs):
+    def __init__(self, filename, gdalDataset, gdalMetadata, cachedir=None,
+                 **kwargs):
         ''' Create NCEP VRT '''
 
         if not gdalDataset:
             raise WrongMapperError(filename)
 
         geotransform = gdalDataset.GetGeoTransform()
-        if (geotransform != (-0.25, 0.5, 0.0, 90.25, 0.0, -0.5) or
-                gdalDataset.RasterCount != 2):  # Not water proof
+        if geotransform != (-0.25, 0.5, 0.0, 90.25, 0.0, -0.5):
             raise WrongMapperError(filename)
 
-        metaDict = [{'src': {'SourceFilename': filename,
-                             'SourceBand': 1},
+        # bands are selected by parameter and level from inventory of messages
+        grib_index = GribIndex(filename, cachedir)
+        if len(grib_index.messages) != 2:  # Not water proof
+            raise WrongMapperError(filename)
+        # VRT is created from the first message, not from the whole file
+        grid_dataset = grib_index.first_dataset()
+        size = {'xSize': grid_dataset.RasterXSize,
+                'ySize': grid_dataset.RasterYSize}
+        u_src = grib_index.band_source('UGRD', 'HTGL', 10, **size)
+        v_src = grib_index.band_source('VGRD', 'HTGL', 10, **size)
+
+        metaDict = [{'src': u_src,
                      'dst': {'wkv': 'eastward_wind',
                              'height': '10 m'}},
-                    {'src': {'SourceFilename': filename,
-                             'SourceBand': 2},
+                    {'src': v_src,
                      'dst': {'wkv': 'northward_wind',
                              'height': '10 m'}},
-                    {'src': [{'SourceFilename': filename,
-                              'SourceBand': 1,
-                              'DataType': gdalDataset.GetRasterBand(1).DataType
-                              },
-                             {'SourceFilename': filename,
-                              'SourceBand': 2,
-                              'DataType': gdalDataset.GetRasterBand(2).DataType
-                              }],
+                    {'src': [u_src, v_src],
                      'dst': {'wkv': 'wind_speed',
                              'PixelFunctionType': 'UVToMagnitude',
                              'name': 'windspeed',
                              'height': '2 m'
                              }},
-                    {'src': [{'SourceFilename': filename,
-                              'SourceBand': 1,
-                              'DataType': gdalDataset.GetRasterBand(1).DataType
-                              },
-                             {'SourceFilename': filename,
-                              'SourceBand': 2,
-                              'DataType': gdalDataset.GetRasterBand(2).DataType
-                              }],
+                    {'src': [u_src, v_src],
                      'dst': {'wkv': 'wind_from_direction',
                              'PixelFunctionType': 'UVToDirectionFrom',
                              'name': 'winddirection',
@@ -66,19 +61,15 @@ class Mapper(VRT):
                      }]
 
         # create empty VRT dataset with geolocation only
-        self._init_from_gdal_dataset(gdalDataset)
+        self._init_from_gdal_dataset(grid_dataset)
 
         # add bands with metadata and corresponding values to the empty VRT
         self.create_bands(metaDict)
 
         # Adding valid time from the GRIB file to dataset
-        validTime = gdalDataset.GetRasterBand(1).GetMetadata()['GRIB_VALID_TIME']
-        self.dataset.SetMetadataItem('time_coverage_start',
-            (datetime.datetime.utcfromtimestamp(
-                int(validTime.strip().split(' ')[0])).isoformat()))
-        self.dataset.SetMetadataItem('time_coverage_end',
-            (datetime.datetime.utcfromtimestamp(
-                int(validTime.strip().split(' ')[0])).isoformat()))
+        validTime = grib_index.select('UGRD', 'HTGL', 10)[0]['valid_time']
+        self.dataset.SetMetadataItem('time_coverage_start', validTime)
+        self.dataset.SetMetadataItem('time_coverage_end', validTime)
 
         # Get dictionary describing the instrument and platform according to
         # the GCMD keywords
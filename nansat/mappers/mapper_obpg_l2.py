@@ -9,12 +9,14 @@ from math import ceil
 from dateutil.parser import parse
 
 import json
+import numpy as np
 import pythesint as pti
 
 from nansat.utils import gdal, ogr
 from nansat.vrt import VRT
 from nansat.nsr import NSR
 from nansat.mappers.obpg import OBPGL2BaseClass
+from nansat.mappers.gcps import gcp_steps, get_swath_gcps
 
 from nansat.exceptions import WrongMapperError
 
@@ -27,12 +29,15 @@ class Mapper(OBPGL2BaseClass):
     '''
 
     def __init__(self, filename, gdalDataset, gdalMetadata,
-                 GCP_COUNT=10, **kwargs):
+                 GCP_COUNT=10, GCP_TOLERANCE=None, **kwargs):
         ''' Create VRT
         Parameters
         ----------
         GCP_COUNT : int
             number of GCPs along each dimention
+        GCP_TOLERANCE : float
+            if given, GCPs are added near swath edges where error of linear
+            interpolation of lon/lat between GCPs exceeds tolerance (degrees)
         '''
 
         # should raise error in case of not obpg_l2 file
@@ -217,9 +222,6 @@ class Mapper(OBPGL2BaseClass):
         yDatasetSource = geolocationMetadata['Y_DATASET']
         yDataset = gdal.Open(yDatasetSource)
 
-        longitude = xDataset.ReadAsArray()
-        latitude = yDataset.ReadAsArray()
-
         # estimate pixel/line step of the geolocation arrays
         pixelStep = int(ceil(float(gdalSubDataset.RasterXSize) /
                              float(xDataset.RasterXSize)))
@@ -230,46 +232,29 @@ class Mapper(OBPGL2BaseClass):
         # ==== ADD GCPs and Pojection ====
 
         # estimate step of GCPs
-        step0 = max(1, int(float(latitude.shape[0]) / GCP_COUNT))
-        step1 = max(1, int(float(latitude.shape[1]) / GCP_COUNT))
+        step0, step1 = gcp_steps(xDataset.RasterYSize, xDataset.RasterXSize,
+                                 GCP_COUNT)
         if str(title) == 'VIIRSN Level-2 Data':
             step0 = 64
         self.logger.debug('gcpCount: >%s<, %d %d %f %d %d',
                           title,
-                          latitude.shape[0], latitude.shape[1],
+                          xDataset.RasterYSize, xDataset.RasterXSize,
                           GCP_COUNT, step0, step1)
 
-        # generate list of GCPs
-        dx = .5
-        dy = .5
-        gcps = []
-        k = 0
-        center_lon = 0
-        center_lat = 0
-        for i0 in range(0, latitude.shape[0], step0):
-            for i1 in range(0, latitude.shape[1], step1):
-                # create GCP with X,Y,pixel,line from lat/lon matrices
-                lon = float(longitude[i0, i1])
-                lat = float(latitude[i0, i1])
-                if (lon >= -180 and lon <= 180 and lat >= -90 and lat <= 90):
-                    gcp = gdal.GCP(lon, lat, 0, i1 * pixelStep + dx,
-                                   i0 * lineStep + dy)
-                    self.logger.debug('%d %d %d %f %f',
-                                      k, gcp.GCPPixel, gcp.GCPLine,
-                                      gcp.GCPX, gcp.GCPY)
-                    gcps.append(gcp)
-                    center_lon += gcp.GCPX
-                    center_lat += gcp.GCPY
-                    k += 1
-
+        # generate list of GCPs (only rows with GCPs are read)
+        gcps = get_swath_gcps(xDataset.GetRasterBand(1),
+                              yDataset.GetRasterBand(1),
+                              step0=step0, step1=step1,
+                              line_step=lineStep, pixel_step=pixelStep,
+                              tolerance=GCP_TOLERANCE)
+        center_lon = np.mean([gcp.GCPX for gcp in gcps])
+        center_lat = np.mean([gcp.GCPY for gcp in gcps])
 
         # append GCPs and lat/lon projection to the vsiDataset
         self.dataset.SetGCPs(gcps, NSR().wkt)
         self._remove_geolocation()
 
         # reproject GCPs
-        center_lon /= k
-        center_lat /= k
         srs = '+proj=stere +datum=WGS84 +ellps=WGS84 +lon_0=%f +lat_0=%f +no_defs' % (center_lon, center_lat)
         self.reproject_gcps(srs)
 
@@ -91,59 +91,51 @@ class Mapper(VRT):
         self._init_from_gdal_dataset(gdalDataset)
         self.dataset.SetGCPs(self.dataset.GetGCPs(), NSR().wkt)
 
+        # range-only calibration LUTs (one value per column)
+        luts = {}
+        for lut_name in ['Sigma', 'Beta']:
+            offset, gains = self.read_lut(inputFileName, 'lut%s.xml' % lut_name)
+            self.band_vrts['lut%s' % lut_name] = VRT.from_array(
+                gains.reshape(1, gains.size))
+            luts[lut_name] = {'vrt': self.band_vrts['lut%s' % lut_name],
+                              'offset': offset,
+                              'gains': gains}
+
         # define dictionary of metadata and band specific parameters
         pol = []
         metaDict = []
-
-        # Get the subdataset with calibrated sigma0 only
-        for dataset in gdalDataset.GetSubDatasets():
-            if dataset[1] == 'Sigma Nought calibrated':
-                s0dataset = gdal.Open(dataset[0])
-                s0datasetName = dataset[0][:]
-                band = s0dataset.GetRasterBand(1)
-                s0datasetPol = band.GetMetadata()['POLARIMETRIC_INTERP']
-                for i in range(1, s0dataset.RasterCount+1):
-                    iBand = s0dataset.GetRasterBand(i)
-                    polString = iBand.GetMetadata()['POLARIMETRIC_INTERP']
-                    suffix = polString
-                    # The nansat data will be complex
-                    # if the SAR data is of type 10
-                    dtype = iBand.DataType
-                    if dtype == 10:
-                        # add intensity band
-                        metaDict.append(
-                            {'src': {'SourceFilename':
-                                     ('RADARSAT_2_CALIB:SIGMA0:'
-                                      + filename + '/product.xml'),
-                                     'SourceBand': i,
-                                     'DataType': dtype},
-                             'dst': {'wkv': 'surface_backwards_scattering_coefficient_of_radar_wave',
-                                     'PixelFunctionType': 'intensity',
-                                     'SourceTransferType': gdal.GetDataTypeName(dtype),
-                                     'suffix': suffix,
-                                     'polarization': polString,
-                                     'dataType': 6}})
-                        # modify suffix for adding the compled band below
-                        suffix = polString+'_complex'
-                    pol.append(polString)
-                    metaDict.append(
-                        {'src': {'SourceFilename': ('RADARSAT_2_CALIB:SIGMA0:'
-                                                    + filename
-                                                    + '/product.xml'),
-                                 'SourceBand': i,
-                                 'DataType': dtype},
-                         'dst': {'wkv': 'surface_backwards_scattering_coefficient_of_radar_wave',
-                                 'suffix': suffix,
-                                 'polarization': polString}})
-
-            if dataset[1] == 'Beta Nought calibrated':
-                b0dataset = gdal.Open(dataset[0])
-                b0datasetName = dataset[0][:]
-                for j in range(1, b0dataset.RasterCount+1):
-                    jBand = b0dataset.GetRasterBand(j)
-                    polString = jBand.GetMetadata()['POLARIMETRIC_INTERP']
-                    if polString == s0datasetPol:
-                        b0datasetBand = j
+        bandNumbers = {}
+
+        # sigma0 and beta0 are calibrated from DN and LUT in one pixel function
+        for i in range(1, gdalDataset.RasterCount+1):
+            iBand = gdalDataset.GetRasterBand(i)
+            polString = iBand.GetMetadata()['POLARIMETRIC_INTERP']
+            dtype = iBand.DataType
+            pol.append(polString)
+            for lut_name, wkv in [
+                    ('Sigma', 'surface_backwards_scattering_coefficient_of_radar_wave'),
+                    ('Beta', 'surface_backwards_brightness_coefficient_of_radar_wave')]:
+                src, dst = self.lut_calibration(filename, iBand,
+                                                luts[lut_name]['vrt'],
+                                                luts[lut_name]['offset'])
+                dst.update({'wkv': wkv,
+                            'suffix': polString,
+                            'polarization': polString})
+                metaDict.append({'src': src, 'dst': dst})
+                bandNumbers[lut_name + polString] = len(metaDict)
+
+            # The nansat data will also be complex
+            # if the SAR data is complex
+            if gdal.DataTypeIsComplex(dtype):
+                metaDict.append(
+                    {'src': {'SourceFilename': ('RADARSAT_2_CALIB:SIGMA0:'
+                                                + filename
+                                                + '/product.xml'),
+                             'SourceBand': i,
+                             'DataType': dtype},
+                     'dst': {'wkv': 'surface_backwards_scattering_coefficient_of_radar_wave',
+                             'suffix': polString+'_complex',
+                             'polarization': polString}})
 
         ###############################
         # Add SAR look direction
@@ -211,40 +203,32 @@ class Mapper(VRT):
         self.create_bands(metaDict)
 
         ###################################################
-        # Add derived band (incidence angle) calculated
-        # using pixel function "BetaSigmaToIncidence":
+        # Add incidence angle: sigma0/beta0 = sin(incidence) does not
+        # depend on DN and is computed per column from the LUTs
         ###################################################
-        src = [{'SourceFilename': b0datasetName,
-                'SourceBand':  b0datasetBand,
-                'DataType': dtype},
-               {'SourceFilename': s0datasetName,
-                'SourceBand': 1,
-                'DataType': dtype}]
+        incidence = self.lut_incidence_angle(
+            luts['Beta']['gains'], luts['Sigma']['gains'],
+            gdal.DataTypeIsComplex(gdalDataset.GetRasterBand(1).DataType))
+        self.band_vrts['incidenceVRT'] = VRT.from_array(
+            incidence.reshape(1, incidence.size))
+        src = self.lut_source(self.band_vrts['incidenceVRT'],
+                              gdalDataset.RasterYSize)
         dst = {'wkv': 'angle_of_incidence',
-               'PixelFunctionType': 'BetaSigmaToIncidence',
-               'SourceTransferType': gdal.GetDataTypeName(dtype),
-               '_FillValue': -10000,   # NB: this is also hard-coded in
-                                       #     pixelfunctions.c
-               'dataType': 6,
                'name': 'incidence_angle'}
-
         self.create_band(src, dst)
         self.dataset.FlushCache()
 
         ###################################################################
         # Add sigma0_VV - pixel function of sigma0_HH and beta0_HH
         # incidence angle is calculated within pixel function
-        # It is assummed that HH is the first band in sigma0 and
-        # beta0 sub datasets
         ###################################################################
         if 'VV' not in pol and 'HH' in pol:
-            s0datasetNameHH = pol.index('HH')+1
-            src = [{'SourceFilename': s0datasetName,
-                    'SourceBand': s0datasetNameHH,
-                    'DataType': 6},
-                   {'SourceFilename': b0datasetName,
-                    'SourceBand': b0datasetBand,
-                    'DataType': 6}]
+            src = [{'SourceFilename': self.filename,
+                    'SourceBand': bandNumbers['SigmaHH'],
+                    'DataType': gdal.GDT_Float32},
+                   {'SourceFilename': self.filename,
+                    'SourceBand': bandNumbers['BetaHH'],
+                    'DataType': gdal.GDT_Float32}]
             dst = {'wkv': 'surface_backwards_scattering_coefficient_of_radar_wave',
                    'PixelFunctionType': 'Sigma0HHBetaToSigma0VV',
                    'polarization': 'VV',
@@ -286,6 +270,107 @@ class Mapper(VRT):
                                      ['surface_backwards_scattering_coefficient_of_radar_wave']))
         self.dataset.SetMetadataItem('entry_id', os.path.basename(filename))
 
+    @staticmethod
+    def read_lut(inputFileName, lutName):
+        """ Read calibration LUT (e.g. lutSigma.xml) of Radarsat-2 product
+
+        Parameters
+        ----------
+        inputFileName : str
+            name of product directory or zip file
+        lutName : str
+            name of the LUT file
+
+        Returns
+        -------
+        offset : float
+            constant offset of the LUT
+        gains : numpy.ndarray
+            gains of the LUT, one value per column
+
+        """
+        if zipfile.is_zipfile(inputFileName):
+            zz = zipfile.ZipFile(inputFileName)
+            lutXml = zz.open(os.path.join(os.path.basename(
+                inputFileName).split('.')[0], lutName)).read()
+            zz.close()
+        else:
+            lutXml = open(os.path.join(inputFileName, lutName)).read()
+        lut = Node.create(lutXml)
+        offset = float(lut['offset'])
+        gains = np.fromiter(lut['gains'].split(), np.float32)
+        return offset, gains
+
+    @staticmethod
+    def lut_source(lut_vrt, ysize):
+        """ Make source of band with range-only LUT (VRT with one row)
+
+        The single row is replicated to all <ysize> lines by the VRT source,
+        no full size LUT band is created.
+
+        """
+        return {'SourceFilename': lut_vrt.filename,
+                'SourceBand': 1,
+                'SourceType': 'SimpleSource',
+                'DataType': gdal.GDT_Float32,
+                'xSize': lut_vrt.dataset.RasterXSize,
+                'ySize': 1,
+                'dstYSize': ysize}
+
+    @staticmethod
+    def lut_calibration(filename, band, lut_vrt, offset):
+        """ Make parameters of band calibrated from DN with range-only LUT
+
+        Detected data is calibrated as (DN^2 + offset) / A and complex (SLC)
+        data as (I^2 + Q^2) / A^2, the same as RADARSAT_2_CALIB bands of GDAL.
+
+        Parameters
+        ----------
+        filename : str
+            name of dataset with DN
+        band : gdal.Band
+            band with DN
+        lut_vrt : VRT
+            VRT with gains A of the LUT in one row
+        offset : float
+            constant offset of the LUT
+
+        Returns
+        -------
+        src : list
+            sources of DN and LUT
+        dst : dict
+            parameters of the band with RSAT2Calibration pixel function
+
+        """
+        if gdal.DataTypeIsComplex(band.DataType):
+            transferType = 'CFloat32'
+        else:
+            transferType = 'Float32'
+        src = [{'SourceFilename': filename,
+                'SourceBand': band.GetBand(),
+                'DataType': band.DataType},
+               Mapper.lut_source(lut_vrt, band.YSize)]
+        dst = {'PixelFunctionType': 'RSAT2Calibration',
+               'SourceTransferType': transferType,
+               'dataType': gdal.GDT_Float32}
+        if int(gdal.VersionInfo()) >= 3040000:
+            dst['PixelFunctionArguments'] = {'offset': repr(offset)}
+        return src, dst
+
+    @staticmethod
+    def lut_incidence_angle(beta_gains, sigma_gains, is_complex):
+        """ Compute incidence angle [deg] per column from beta0 and sigma0 LUTs
+
+        sin(incidence) = sigma0 / beta0 is A_beta / A_sigma for detected data
+        and (A_beta / A_sigma)^2 for complex data (see lut_calibration)
+
+        """
+        ratio = beta_gains / sigma_gains
+        if is_complex:
+            ratio = ratio ** 2
+        return np.degrees(np.arcsin(ratio))
+
     def init_from_xml(self, productXml, filename):
         ''' Fast init from metada in XML only '''
         numberOfLines = int(productXml
@@ -48,12 +48,19 @@ class Mapper(VRT):
         If True, no bands are added to the dataset and georeference is not corrected.
         If False, all bands are added and GCPs are corrected if necessary
         (see Mapper.correct_geolocation_data for details).
+    sigma0_floor : float
+        Lower limit of thermal noise corrected sigma0 (sigma0_<pol>_denoised).
+        Negative values after noise subtraction are replaced by sigma0_floor.
+        Requires GDAL >= 3.4, otherwise 0 is used.
+    nesz : bool
+        Add bands with noise equivalent sigma zero (NESZ_<pol>)?
 
     Note
     ----
     Creates self.dataset and populates it with S1 bands (when fast=False).
     """
-    def __init__(self, filename, gdalDataset, gdalMetadata, fast=False, fixgcp=True, **kwargs):
+    def __init__(self, filename, gdalDataset, gdalMetadata, fast=False, fixgcp=True,
+                 sigma0_floor=0., nesz=False, **kwargs):
         if not os.path.split(filename.rstrip('/'))[1][:3] in ['S1A', 'S1B']:
             raise WrongMapperError('%s: Not Sentinel 1A or 1B' %filename)
 
@@ -140,19 +147,14 @@ class Mapper(VRT):
             calibration_vrts = self.vrts_from_arrays(calibration_data, calibration_names, pol, True, 1)
             self.band_vrts.update(calibration_vrts)
 
-        # create full size VRTS with noise LUT
+        # sources with noise LUT (interpolated by GDAL from the coarse grid)
+        noise_sources = {}
         for noise_file in noise_files:
-            pol = '_' + os.path.basename(noise_file).split('-')[4].upper()
-            xml = self.read_vsi(noise_file)
-            if '<noiseVectorList' in xml:
-                noise_list_tag = 'noiseVectorList'
-                noise_name = 'noiseLut'
-            elif '<noiseRangeVectorList' in xml:
-                noise_list_tag = 'noiseRangeVectorList'
-                noise_name = 'noiseRangeLut'
-            noise_data = self.read_calibration(xml, noise_list_tag, [noise_name], pol)
-            noise_vrts = self.vrts_from_arrays(noise_data, [noise_name], pol, True, 1)
-            self.band_vrts.update(noise_vrts)
+            pol = os.path.basename(noise_file).split('-')[4].upper()
+            noise_data = self.read_noise(self.read_vsi(noise_file), '_' + pol)
+            noise_sources[pol] = {
+                name: self.lut_source(noise_data, name + '_' + pol)
+                for name in ['noise', 'noiseTotal']}
 
         #### Create metaDict: dict with metadata for all bands
         metaDict = []
@@ -198,7 +200,9 @@ class Mapper(VRT):
         See
         https://sentinel.esa.int/web/sentinel/sentinel-1-sar-wiki/-/wiki/Sentinel%20One/Application+of+Radiometric+Calibration+LUT
 
-        The noise correction/subtraction is implemented in an independent package "sentinel1denoised"
+        Simple subtraction of the noise LUT is available in the bands
+        sigma0_<pol>_denoised. More advanced noise correction is implemented
+        in an independent package "sentinel1denoised"
         See
         https://github.com/nansencenter/sentinel1denoised
         '''
@@ -255,10 +259,7 @@ class Mapper(VRT):
             bandNumberDict[name] = bnmax+1
             bnmax = bandNumberDict[name]
             metaDict.append({
-                'src': {
-                    'SourceFilename': self.band_vrts['%s_%s' % (noise_name, pol)].filename,
-                    'SourceBand': 1
-                },
+                'src': noise_sources[pol]['noise'],
                 'dst': {
                     'name': name
                 }
@@ -297,6 +298,46 @@ class Mapper(VRT):
                          'suffix': pol,
                          },
                  })
+            # calibration and noise subtraction in one pass over DN
+            name = 'sigma0_%s_denoised' % pol
+            bandNumberDict[name] = bnmax+1
+            bnmax = bandNumberDict[name]
+            dst = {'wkv': 'surface_backwards_scattering_coefficient_of_radar_wave',
+                   'PixelFunctionType': 'Sentinel1Denoising',
+                   'SourceTransferType': 'Float32',
+                   'dataType': gdal.GDT_Float32,
+                   'polarization': pol,
+                   'name': name,
+                   }
+            if int(gdal.VersionInfo()) >= 3040000:
+                dst['PixelFunctionArguments'] = {'floor': repr(float(sigma0_floor))}
+            metaDict.append(
+                {'src': [{'SourceFilename': self.filename,
+                          'SourceBand': bandNumberDict['DN_%s' % pol],
+                          },
+                         {'SourceFilename': self.band_vrts['sigmaNought_%s' % pol].filename,
+                          'SourceBand': 1
+                          },
+                         noise_sources[pol]['noiseTotal'],
+                         ],
+                 'dst': dst,
+                 })
+            if nesz:
+                name = 'NESZ_%s' % pol
+                bandNumberDict[name] = bnmax+1
+                bnmax = bandNumberDict[name]
+                metaDict.append(
+                    {'src': [noise_sources[pol]['noiseTotal'],
+                             {'SourceFilename': self.band_vrts['sigmaNought_%s' % pol].filename,
+                              'SourceBand': 1
+                              }
+                             ],
+                     'dst': {'PixelFunctionType': 'Sentinel1NESZ',
+                             'dataType': gdal.GDT_Float32,
+                             'polarization': pol,
+                             'name': name,
+                             },
+                     })
             name = 'beta0_%s' % pol
             bandNumberDict[name] = bnmax+1
             bnmax = bandNumberDict[name]
@@ -410,6 +451,106 @@ class Mapper(VRT):
 
         return data
 
+    def read_noise(self, xml, pol):
+        """ Read range noise LUT and combine it with azimuth noise (IPF >= 2.9)
+
+        Parameters
+        ----------
+        xml : str
+            String with XML from noise file
+        pol : str
+            _HH, _HV, etc
+
+        Returns
+        -------
+        data : dict
+            'pixel', 'line' : 2D arrays with coordinates of the LUT
+            'noise'+pol : range noise LUT (noiseLut or noiseRangeLut)
+            'noiseTotal'+pol : range noise multiplied by azimuth noise
+            (equal to range noise for IPF < 2.9)
+        """
+        if '<noiseVectorList' in xml:
+            noise_list_tag = 'noiseVectorList'
+            noise_name = 'noiseLut'
+        else:
+            noise_list_tag = 'noiseRangeVectorList'
+            noise_name = 'noiseRangeLut'
+        data = self.read_calibration(xml, noise_list_tag, [noise_name], pol)
+        data['noise'+pol] = data.pop(noise_name+pol)
+        data['noiseTotal'+pol] = data['noise'+pol]
+        if '<noiseAzimuthVectorList' in xml:
+            data['noiseTotal'+pol] = data['noise'+pol] * self.read_noise_azimuth(
+                xml, data['pixel'], data['line'])
+        return data
+
+    def lut_source(self, data, name):
+        """ Source of VRT band interpolating coarse LUT to full size
+
+        The LUT is not zoomed to full size with an intermediate VRT: a small
+        VRT with the LUT is a source with DstRect covering the image, and GDAL
+        interpolates (bilinear) only blocks which are read. Spacing of the LUT
+        is assumed to be regular.
+
+        Parameters
+        ----------
+        data : dict
+            LUT and its 'pixel' and 'line' (see read_calibration)
+        name : str
+            key of the LUT in data
+
+        Returns
+        -------
+        src : dict
+            source for create_band
+
+        """
+        lut = data[name].astype(np.float32)
+        self.band_vrts[name] = VRT.from_array(lut)
+        pixel, line = data['pixel'][0], data['line'][:, 0]
+        # distance between samples, samples are in the centers of their cells
+        dx = float(pixel[-1] - pixel[0]) / max(len(pixel) - 1, 1) or self.dataset.RasterXSize
+        dy = float(line[-1] - line[0]) / max(len(line) - 1, 1) or self.dataset.RasterYSize
+        return {'SourceFilename': self.band_vrts[name].filename,
+                'SourceBand': 1,
+                'DataType': gdal.GDT_Float32,
+                'xSize': lut.shape[1],
+                'ySize': lut.shape[0],
+                'dstXOff': pixel[0] + 0.5 - dx / 2.,
+                'dstYOff': line[0] + 0.5 - dy / 2.,
+                'dstXSize': dx * lut.shape[1],
+                'dstYSize': dy * lut.shape[0],
+                'resampling': 'bilinear'}
+
+    def read_noise_azimuth(self, xml, pixel, line):
+        """ Read azimuth noise vectors from noise XML file (IPF >= 2.9)
+
+        Parameters
+        ----------
+        xml : str
+            String with XML from noise file
+        pixel : numpy.ndarray
+            pixel coordinates of range noise LUT
+        line : numpy.ndarray
+            line coordinates of range noise LUT
+
+        Returns
+        -------
+        noise_azimuth : numpy.ndarray
+            Azimuth noise scaling interpolated to pixel, line (1 outside
+            of blocks given in the noise file)
+        """
+        noise_azimuth = np.ones(pixel.shape)
+        vecList = Node.create(xml).node('noiseAzimuthVectorList')
+        for vec in vecList.children:
+            az_line = np.fromiter(vec['line'].split(), float)
+            az_lut = np.fromiter(vec['noiseAzimuthLut'].split(), float)
+            in_block = ((pixel >= int(vec['firstRangeSample'])) *
+                        (pixel <= int(vec['lastRangeSample'])) *
+                        (line >= int(vec['firstAzimuthLine'])) *
+                        (line <= int(vec['lastAzimuthLine'])))
+            noise_azimuth[in_block] = np.interp(line[in_block], az_line, az_lut)
+        return noise_azimuth
+
     def read_annotation(self, annotation_files):
         """ Read lon, lat, etc from annotation XML
 
@@ -0,0 +1,118 @@
+# Name:        tar_index
+# Purpose:     Index of members of (compressed) tar archives for direct access
+# Authors:      Anton Korosov
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+import os
+import gzip
+import json
+import shutil
+import tarfile
+
+from nansat.exceptions import WrongMapperError
+
+
+class TarIndex(object):
+    """Index of members of a tar archive for random access with GDAL
+
+    Offsets and sizes of all members are found once. Members of an
+    uncompressed tar file are then opened with /vsisubfile/ which reads
+    windows directly from the archive without parsing tar headers or
+    decompressing anything.
+
+    A compressed archive (.tar.gz, .tgz) has no random access: every seek
+    with /vsitar/ decompresses the stream from the start or from the nearest
+    checkpoint kept in memory by GDAL. If <cachedir> is given, the archive is
+    therefore decompressed once into <cachedir> and the index is saved next
+    to it. Later opening of the same archive reuses both. Without <cachedir>
+    members of compressed archives are opened with /vsitar/.
+
+    """
+    INDEX_SUFFIX = '.index.json'
+    GZIP_SUFFIXES = {'.tar.gz': '.tar', '.tgz': '.tar'}
+
+    def __init__(self, filename, cachedir=None):
+        """Create index of members of tar archive
+
+        Parameters
+        ----------
+        filename : str
+            name of .tar, .tar.gz or .tgz file
+        cachedir : str
+            existing directory for the decompressed archive and the index
+
+        """
+        self.filename = filename
+        self.tar_filename = None
+        self.members = None
+        compressed_suffix = [suffix for suffix in self.GZIP_SUFFIXES
+                             if filename.endswith(suffix)]
+        if not compressed_suffix:
+            self.tar_filename = filename
+        elif cachedir is not None and os.path.isdir(cachedir):
+            basename = os.path.basename(filename)[:-len(compressed_suffix[0])]
+            self.tar_filename = os.path.join(
+                cachedir, basename + self.GZIP_SUFFIXES[compressed_suffix[0]])
+            self.members = self._load_index()
+
+        if self.members is None:
+            self.members = self._create_index()
+
+    def _archive_stat(self):
+        """Size and modification time of the archive to validate the cache"""
+        stat = os.stat(self.filename)
+        return [stat.st_size, stat.st_mtime]
+
+    def _load_index(self):
+        """Load index saved for the same archive, None if not available"""
+        index_filename = self.tar_filename + self.INDEX_SUFFIX
+        if not (os.path.exists(index_filename) and
+                os.path.exists(self.tar_filename)):
+            return None
+        with open(index_filename) as index_file:
+            index = json.load(index_file)
+        if index.get('archive') != self._archive_stat():
+            return None
+        return dict((name, tuple(offset_size))
+                    for name, offset_size in index['members'].items())
+
+    def _create_index(self):
+        """Find offsets and sizes of members (decompress archive to cache)"""
+        if self.tar_filename is not None and self.tar_filename != self.filename:
+            tmp_filename = self.tar_filename + '.tmp'
+            try:
+                with gzip.open(self.filename, 'rb') as src_file:
+                    with open(tmp_filename, 'wb') as dst_file:
+                        shutil.copyfileobj(src_file, dst_file, 2**20)
+            except (IOError, OSError, EOFError):
+                if os.path.exists(tmp_filename):
+                    os.remove(tmp_filename)
+                raise WrongMapperError
+            os.rename(tmp_filename, self.tar_filename)
+
+        try:
+            tar_file = tarfile.open(self.tar_filename or self.filename)
+        except (IOError, OSError, tarfile.TarError):
+            raise WrongMapperError
+        with tar_file:
+            members = dict((member.name, (member.offset_data, member.size))
+                           for member in tar_file.getmembers()
+                           if member.isfile())
+
+        if self.tar_filename is not None and self.tar_filename != self.filename:
+            with open(self.tar_filename + self.INDEX_SUFFIX, 'w') as index_file:
+                json.dump({'archive': self._archive_stat(),
+                           'members': members}, index_file)
+        return members
+
+    def names(self):
+        """Sorted names of files in the archive"""
+        return sorted(self.members)
+
+    def vsi_filename(self, name):
+        """Name of archive member for opening with GDAL"""
+        if self.tar_filename is None:
+            return '/vsitar/%s/%s' % (self.filename, name)
+        offset, size = self.members[name]
+        return '/vsisubfile/%d_%d,%s' % (offset, size, self.tar_filename)
@@ -0,0 +1,255 @@
+# Name:    memprofile.py
+# Purpose: Peak memory of Nansat operations
+# Licence:
+# This file is part of NANSAT.
+# NANSAT is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3 of the License.
+# http://www.gnu.org/licenses/gpl-3.0.html
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+"""Memory profiling of Nansat operations
+
+When profiling is started, opening, reading, reprojection, export and
+writing of figures record:
+    rss_start, rss_peak : resident set size before and at peak (bytes)
+    rss_peak_delta : growth of RSS at peak relative to start
+    traced_peak_delta : peak of memory allocated by Python and NumPy
+        (tracked by tracemalloc) relative to start
+    numpy_bytes : NumPy memory still allocated at the end of the operation
+    gdal_cache_peak : peak of memory used by the GDAL block cache
+    gdal_cache_peak_delta : peak of GDAL block cache relative to start
+    vsimem_peak : peak of size of files in /vsimem
+    vsimem_peak_delta : peak of size of files in /vsimem relative to start
+    top_sites : list of (file:line, bytes) of the largest NumPy allocations
+        still alive at the end of the operation
+
+RSS, GDAL cache and /vsimem are sampled by a background thread, i.e. very
+short peaks can be missed. Nested operations (e.g. reading inside export)
+are included in the record of the outermost operation.
+
+Examples
+--------
+>>> from nansat import memprofile
+>>> memprofile.start()
+>>> n = Nansat(filename)
+>>> n.export('out.nc')
+>>> print(memprofile.format_report(memprofile.stop()))
+
+"""
+from __future__ import absolute_import
+import os
+import time
+import functools
+import threading
+
+try:
+    import tracemalloc
+except ImportError:
+    tracemalloc = None
+
+import numpy as np
+
+from nansat.utils import gdal
+from nansat.iostats import vsimem_usage
+
+# tracemalloc domain of NumPy data allocations
+NUMPY_DOMAIN = getattr(np.lib, 'tracemalloc_domain', 389047)
+
+# active Profiler or None
+_profiler = None
+
+
+def current_rss():
+    """Return current resident set size of the process in bytes (None if unknown)"""
+    try:
+        with open('/proc/self/statm') as statm:
+            return int(statm.read().split()[1]) * os.sysconf('SC_PAGE_SIZE')
+    except (IOError, OSError, ValueError, AttributeError):
+        return None
+
+
+class Sampler(threading.Thread):
+    """Thread sampling RSS, GDAL cache and /vsimem and keeping the maximum"""
+
+    def __init__(self, interval=0.01, vsimem_interval=0.1):
+        super(Sampler, self).__init__()
+        self.daemon = True
+        self.interval = interval
+        self.vsimem_interval = vsimem_interval
+        self.stopped = threading.Event()
+        self.rss_peak = current_rss()
+        self.gdal_cache_peak = gdal.GetCacheUsed()
+        self.vsimem_peak = vsimem_usage()[1]
+
+    def sample(self, with_vsimem=True):
+        rss = current_rss()
+        if rss is not None:
+            self.rss_peak = max(self.rss_peak, rss)
+        self.gdal_cache_peak = max(self.gdal_cache_peak, gdal.GetCacheUsed())
+        if with_vsimem:
+            self.vsimem_peak = max(self.vsimem_peak, vsimem_usage()[1])
+
+    def run(self):
+        last_vsimem = time.time()
+        while not self.stopped.wait(self.interval):
+            with_vsimem = time.time() - last_vsimem > self.vsimem_interval
+            if with_vsimem:
+                last_vsimem = time.time()
+            self.sample(with_vsimem)
+
+    def stop(self):
+        self.stopped.set()
+        self.join()
+        self.sample()
+
+
+class MemoryProfile(object):
+    """Context manager recording peak memory of one operation"""
+
+    def __init__(self, operation, interval=0.01, top=10, **attrs):
+        """Prepare profiling of <operation>
+
+        Parameters
+        ----------
+        operation : str
+            name of operation
+        interval : float
+            sampling interval of RSS and GDAL cache (seconds)
+        top : int
+            number of top allocation sites in the record
+        **attrs : dict
+            other attributes added to the record
+
+        """
+        self.record = dict(attrs, operation=operation)
+        self.interval = interval
+        self.top = top
+
+    def __enter__(self):
+        self.stop_tracemalloc = False
+        if tracemalloc is not None:
+            if not tracemalloc.is_tracing():
+                tracemalloc.start()
+                self.stop_tracemalloc = True
+            if hasattr(tracemalloc, 'reset_peak'):
+                tracemalloc.reset_peak()
+            self.traced_start = tracemalloc.get_traced_memory()[0]
+        self.sampler = Sampler(self.interval)
+        self.rss_start = self.sampler.rss_peak
+        self.gdal_cache_start = self.sampler.gdal_cache_peak
+        self.vsimem_start = self.sampler.vsimem_peak
+        self.start = time.time()
+        self.sampler.start()
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.sampler.stop()
+        self.record['seconds'] = time.time() - self.start
+        self.record['rss_start'] = self.rss_start
+        self.record['rss_peak'] = self.sampler.rss_peak
+        self.record['rss_peak_delta'] = None
+        if self.rss_start is not None:
+            self.record['rss_peak_delta'] = self.sampler.rss_peak - self.rss_start
+        self.record['gdal_cache_peak'] = self.sampler.gdal_cache_peak
+        self.record['gdal_cache_peak_delta'] = self.sampler.gdal_cache_peak - self.gdal_cache_start
+        self.record['vsimem_peak'] = self.sampler.vsimem_peak
+        self.record['vsimem_peak_delta'] = self.sampler.vsimem_peak - self.vsimem_start
+        self.record['traced_peak_delta'] = None
+        self.record['numpy_bytes'] = None
+        self.record['top_sites'] = []
+        if tracemalloc is not None:
+            self.record['traced_peak_delta'] = (tracemalloc.get_traced_memory()[1] -
+                                                self.traced_start)
+            snapshot = tracemalloc.take_snapshot().filter_traces(
+                [tracemalloc.DomainFilter(True, NUMPY_DOMAIN)])
+            statistics = snapshot.statistics('lineno')
+            self.record['numpy_bytes'] = sum(stat.size for stat in statistics)
+            self.record['top_sites'] = [
+                ('%s:%d' % (stat.traceback[0].filename, stat.traceback[0].lineno), stat.size)
+                for stat in statistics[:self.top]]
+            if self.stop_tracemalloc:
+                tracemalloc.stop()
+        return False
+
+
+class Profiler(object):
+    """Collect records of profiled operations"""
+
+    def __init__(self, interval=0.01, top=10):
+        self.interval = interval
+        self.top = top
+        self.records = []
+        self.active = False
+        # tracemalloc is stopped by stop() only if it was started by start()
+        self.stop_tracemalloc = False
+
+
+def start(interval=0.01, top=10):
+    """Start profiling of memory of Nansat operations
+
+    Parameters
+    ----------
+    interval : float
+        sampling interval of RSS and GDAL cache (seconds)
+    top : int
+        number of top allocation sites in each record
+
+    """
+    global _profiler
+    stop()
+    _profiler = Profiler(interval, top)
+    if tracemalloc is not None and not tracemalloc.is_tracing():
+        tracemalloc.start()
+        _profiler.stop_tracemalloc = True
+
+
+def stop():
+    """Stop profiling and return list of records"""
+    global _profiler
+    profiler, _profiler = _profiler, None
+    if profiler is None:
+        return []
+    if profiler.stop_tracemalloc and tracemalloc.is_tracing():
+        tracemalloc.stop()
+    return profiler.records
+
+
+def profiled(operation):
+    """Decorator recording peak memory of a function if profiling is started"""
+    def decorator(func):
+        @functools.wraps(func)
+        def wrapper(*args, **kwargs):
+            profiler = _profiler
+            if profiler is None or profiler.active:
+                return func(*args, **kwargs)
+            profiler.active = True
+            try:
+                with MemoryProfile(operation, profiler.interval, profiler.top) as profile:
+                    result = func(*args, **kwargs)
+            finally:
+                profiler.active = False
+            profiler.records.append(profile.record)
+            return result
+        return wrapper
+    return decorator
+
+
+def _mb(value):
+    return 'n/a' if value is None else '%.1f MB' % (value / 1024. ** 2)
+
+
+def format_report(records):
+    """Return text report of memory profile records"""
+    lines = []
+    for record in records:
+        lines.append('%s: %.3f s, RSS peak +%s (%s), traced peak +%s, '
+                     'NumPy %s, GDAL cache peak %s, /vsimem peak %s' % (
+                        record['operation'], record['seconds'],
+                        _mb(record['rss_peak_delta']), _mb(record['rss_peak']),
+                        _mb(record['traced_peak_delta']), _mb(record['numpy_bytes']),
+                        _mb(record['gdal_cache_peak']), _mb(record['vsimem_peak'])))
+        for site, size in record['top_sites']:
+            lines.append('    %10s  %s' % (_mb(size), site))
+    return '\n'.join(lines)
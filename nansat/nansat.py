@@ -20,8 +20,10 @@ import glob
 import sys
 import tempfile
 import datetime
+import inspect
 import pkgutil
 import warnings
+import threading
 from xml.sax import saxutils
 
 import numpy as np
@@ -43,10 +45,20 @@ from nansat.vrt import VRT
 from nansat.utils import add_logger, gdal, parse_time
 from nansat.node import Node
 from nansat.pointbrowser import PointBrowser
+from nansat import tracing
+from nansat import iostats
+from nansat import readplan
+from nansat import memprofile
+from nansat import prefetch
+from nansat import sharedmem
 
 from nansat.exceptions import NansatGDALError, WrongMapperError, NansatReadError
 
 import collections
+try:
+    from concurrent.futures import ThreadPoolExecutor
+except ImportError:
+    ThreadPoolExecutor = None
 if hasattr(collections, 'OrderedDict'):
     from collections import OrderedDict
 else:
@@ -55,6 +67,10 @@ else:
 # container for all mappers
 nansatMappers = None
 
+# libraries which are not thread-safe: mappers using them are probed one at a time
+THREAD_UNSAFE_MODULES = ('netCDF4', 'h5py', 'pyhdf')
+_serial_probe_lock = threading.Lock()
+
 
 class Nansat(Domain, Exporter):
     """Container for geospatial data. Performs all high-level operations.
@@ -129,9 +145,25 @@ class Nansat(Domain, Exporter):
         n._init_from_domain(domain, array, parameters, log_level)
         return n
 
-    def __init__(self, filename='', mapper='', log_level=30, **kwargs):
+    def __init__(self, filename='', mapper='', log_level=30, probe_threads=0,
+                 **kwargs):
         """Create Nansat object
 
+        Parameters
+        ----------
+        filename : str
+            name of input file
+        mapper : str
+            name of the mapper (all mappers are tried if not given)
+        log_level : int
+            level of logging
+        probe_threads : int
+            if > 1 and mapper is not given, candidate mappers are tried
+            concurrently in this number of threads (the first successful
+            mapper in the usual order is used)
+        **kwargs : dict
+            arguments for the mapper
+
         Notes
         -----
         self.mapper : str
@@ -153,8 +185,13 @@ class Nansat(Domain, Exporter):
 
         self._init_empty(filename, log_level)
         # Create VRT object with mapping of variables
-        self.vrt = self._get_mapper(mapper, **kwargs)
+        self.vrt = self._get_mapper(mapper, probe_threads=probe_threads, **kwargs)
 
+    @tracing.traced('Nansat.__getitem__',
+                    lambda self, band_id: {'file': self.filename, 'band': band_id},
+                    lambda a: {'shape': a.shape, 'bytes': a.nbytes})
+    @iostats.recorded('read', lambda self, band_id: band_id)
+    @memprofile.profiled('read')
     def __getitem__(self, band_id):
         """Returns the band as a NumPy array, by overloading []
 
@@ -173,13 +210,33 @@ class Nansat(Domain, Exporter):
         """
         # get band
         band = self.get_GDALRasterBand(band_id)
-        # get expression from metadata
-        expression = band.GetMetadata().get('expression', '')
         # get data
         band_data = band.ReadAsArray()
         if band_data is None:
             raise NansatGDALError('Cannot read array from band %s' % str(band_data))
 
+        return self._finalize_band_data(
+            band, band_data, lambda: self.get_GDALRasterBand('swathmask').ReadAsArray())
+
+    def _finalize_band_data(self, band, band_data, read_swathmask):
+        """Apply expression, replace fill values, infs and out-of-swath pixels with NaN
+
+        Parameters
+        ----------
+        band : gdal.Band
+            band from which the data is read
+        band_data : numpy.ndarray
+            data read from the band
+        read_swathmask : callable
+            returns swathmask array of the same shape as band_data
+
+        Returns
+        -------
+        band_data : numpy.ndarray
+
+        """
+        # get expression from metadata
+        expression = band.GetMetadata().get('expression', '')
         # execute expression if any
         if expression != '':
             band_data = eval(expression)
@@ -195,11 +252,128 @@ class Nansat(Domain, Exporter):
 
         # erase out-of-swath pixels with np.Nan (if not integer)
         if self.has_band('swathmask') and all_float_flag:
-            swathmask = self.get_GDALRasterBand('swathmask').ReadAsArray()
+            swathmask = read_swathmask()
             band_data[swathmask == 0] = np.nan
 
         return band_data
 
+    def iter_blocks(self, bands=None, block_lines=256, prefetch_depth=2, max_memory=None,
+                    out=None):
+        """Iterate over blocks of lines of bands with read-ahead in background threads
+
+        While the caller processes a block, the next <prefetch_depth> blocks are
+        evaluated (sources read, pixel functions applied, warped) in background
+        threads. Values are processed as in Nansat.__getitem__.
+
+        Parameters
+        -----------
+        bands : list of int or str
+            numbers or names of bands. All bands if None
+        block_lines : int
+            number of lines in one block
+        prefetch_depth : int
+            number of blocks read ahead (0 - no read-ahead)
+        max_memory : int
+            maximum memory (bytes) of blocks read ahead. Reduces prefetch_depth if needed
+        out : list of numpy.ndarray or nansat.sharedmem.SharedArray
+            arrays of the full band size (one per band). Blocks are written into
+            these arrays (e.g. in shared memory) and views of them are yielded
+
+        Yields
+        -------
+        y_offset : int
+            first line of the block
+        arrays : list of numpy.ndarray
+            blocks of the bands
+
+        Examples
+        --------
+        >>> for y_offset, (sigma0_hh, sigma0_hv) in n.iter_blocks(['sigma0_HH', 'sigma0_HV']):
+        >>>     result[y_offset:y_offset + sigma0_hh.shape[0]] = sigma0_hh / sigma0_hv
+
+        """
+        if bands is None:
+            bands = range(1, self.vrt.dataset.RasterCount + 1)
+        band_numbers = [self.get_band_number(band_id) for band_id in bands]
+        # swathmask is read together with the bands
+        if self.has_band('swathmask'):
+            band_numbers.append(self.get_band_number('swathmask'))
+        reader = prefetch.BlockReader(self.vrt, band_numbers, block_lines, prefetch_depth,
+                                      max_memory)
+        for y_offset, blocks in reader:
+            if len(blocks) > len(bands):
+                swathmask = blocks.pop()
+            else:
+                swathmask = None
+            blocks = [self._finalize_band_data(self.vrt.dataset.GetRasterBand(b),
+                                               block, lambda: swathmask)
+                      for b, block in zip(band_numbers, blocks)]
+            if out is not None:
+                for i, block in enumerate(blocks):
+                    target = getattr(out[i], 'array', out[i])
+                    target = target[y_offset:y_offset + block.shape[0]]
+                    target[:] = block
+                    blocks[i] = target
+            yield y_offset, blocks
+
+    def read_shared(self, band_id=1, name=None, pool=None):
+        """Read band into shared memory, values are processed as in Nansat.__getitem__
+
+        The returned SharedArray can be returned from a worker process (e.g. of
+        multiprocessing.Pool) without copying of data: only name of the shared
+        memory block is pickled. The caller owns the block (unless pool is
+        given) and should unlink() it when it is not needed.
+
+        Parameters
+        -----------
+        band_id : int or str
+            number or name of the band
+        name : str
+            name of the shared memory block. Unique name is generated if None
+        pool : nansat.sharedmem.SharedBufferPool
+            take the block from the pool (with key <name> or <band_id>)
+
+        Returns
+        --------
+        shared : nansat.sharedmem.SharedArray
+
+        Examples
+        --------
+        >>> def worker(filename):
+        >>>     return Nansat(filename).read_shared('sigma0_HH')
+        >>> shared = multiprocessing.Pool(4).map(worker, filenames)
+
+        """
+        band = self.get_GDALRasterBand(band_id)
+        shape = (band.YSize, band.XSize)
+
+        def allocate(dtype):
+            if pool is not None:
+                return pool.get(name or str(band_id), shape, dtype)
+            return sharedmem.SharedArray(shape, dtype, name)
+
+        if band.GetMetadata().get('expression', '') != '':
+            # expression creates new array anyway
+            band_data = self[band_id]
+            shared = allocate(band_data.dtype)
+            shared.array[:] = band_data
+            return shared
+
+        # data type of the band as returned by GDAL
+        shared = allocate(band.ReadAsArray(0, 0, 1, 1).dtype)
+        try:
+            if band.ReadAsArray(buf_obj=shared.array) is None:
+                raise NansatGDALError('Cannot read array from band %s' % str(band_id))
+            # values are replaced in place
+            self._finalize_band_data(
+                band, shared.array, lambda: self.get_GDALRasterBand('swathmask').ReadAsArray())
+        except Exception:
+            if pool is None:
+                shared.close()
+                shared.unlink()
+            raise
+        return shared
+
     def __repr__(self):
         """Creates string with basic info about the Nansat object"""
         out_str = '{separator}{filename}{separator}Mapper: {mapper}{bands}{separator}{domain}'
@@ -236,6 +410,8 @@ class Nansat(Domain, Exporter):
         # name, for compatibility with some Domain methods
         self.name = os.path.basename(filename)
         self.path = os.path.dirname(filename)
+        # list of I/O statistics (if recording is started)
+        self.io_records = None
 
     def _init_from_domain(self, domain, array=None, parameters=None, log_level=30):
         """Init Nansat object from input Domain and optionally array with band values
@@ -369,6 +545,30 @@ class Nansat(Domain, Exporter):
             elif 'standard_name' in band_meta and band_meta['standard_name'] == band:
                 return True
 
+    def get_vector_pairs(self):
+        """Find pairs of bands with grid-relative vector components
+
+        Bands with standard names x_<quantity> and y_<quantity> (e.g. x_wind
+        and y_wind, x_sea_water_velocity and y_sea_water_velocity) make a pair.
+        Eastward/northward components are relative to North and are not
+        included.
+
+        Returns
+        -------
+            pairs : list of tuples
+                pairs (u, v) of band numbers
+
+        """
+        x_bands, y_bands = {}, {}
+        for band_num, band_meta in self.bands().items():
+            standard_name = band_meta.get('standard_name', '')
+            if standard_name.startswith('x_'):
+                x_bands.setdefault(standard_name[2:], band_num)
+            elif standard_name.startswith('y_'):
+                y_bands.setdefault(standard_name[2:], band_num)
+        return [(x_bands[quantity], y_bands[quantity])
+                for quantity in sorted(x_bands) if quantity in y_bands]
+
     def _get_resize_shape(self, factor, width, height, dst_pixel_size):
         """Estimate new shape either from factor or destination width/height or pixel size"""
         src_shape = np.array(self.shape(), float)
@@ -520,9 +720,47 @@ class Nansat(Domain, Exporter):
         else:
             return outString
 
+    def explain(self, band_id=1, window=None, measure=False, do_print=True):
+        """Show how a band is read: graph of VRTs, pixel functions and source files
+
+        Parameters
+        -----------
+        band_id : int or str
+            number or name of band
+        window : tuple of int
+            (xOff, yOff, xSize, ySize) of the window to read. Full band if None
+        measure : bool
+            read the window from each node of the graph and add measured time
+        do_print : boolean
+            print on screen?
+
+        Returns
+        --------
+        plan : dict
+            read plan (if do_print is False), see nansat.readplan for details
+
+        Examples
+        --------
+        >>> n = Nansat(filename)
+        >>> n.explain('sigma0_VV', window=(0, 0, 512, 512), measure=True)
+
+        """
+        plan = readplan.explain(self.vrt.filename, self.get_band_number(band_id),
+                                window, measure)
+        if do_print:
+            print(readplan.format_plan(plan))
+            print('Estimated bytes: %d' % readplan.total_bytes(plan))
+        else:
+            return plan
+
+    @tracing.traced('Nansat.reproject',
+                    lambda self, dst_domain=None, *args, **kwargs: {
+                        'file': self.filename, 'src_shape': self.shape(),
+                        'dst_shape': None if dst_domain is None else dst_domain.shape()})
+    @memprofile.profiled('reproject')
     def reproject(self, dst_domain=None, resample_alg=0,
                   block_size=None, tps=None, skip_gcps=1, addmask=True,
-                  **kwargs):
+                  vector_pairs=None, rotation_step=16, **kwargs):
         """
         Change projection of the object based on the given Domain
 
@@ -563,6 +801,14 @@ class Nansat(Domain, Exporter):
         addmask : bool
             If True, add band 'swathmask'. 1 - valid data, 0 no-data.
             This band is used to replace no-data values with np.nan
+        vector_pairs : list of tuples or 'auto'
+            Pairs (u, v) of band names or numbers with grid-relative vector
+            components. The vectors are rotated from the grid of self to the
+            grid of dst_domain. If 'auto', pairs are found by standard names
+            (see get_vector_pairs). If None (default), nothing is rotated.
+        rotation_step : int
+            Size of cells (pixels of dst_domain) of the coarse field of
+            rotation angles. The field is interpolated bilinearly.
 
         Notes
         -----
@@ -621,6 +867,14 @@ class Nansat(Domain, Exporter):
         if src_skip_gcps is not None:  # ...or use setting from src
             kwargs['skip_gcps'] = int(src_skip_gcps)
 
+        # find grid-relative vectors and angles of their rotation
+        if vector_pairs == 'auto':
+            vector_pairs = self.get_vector_pairs()
+        vector_pairs = [(self.get_band_number(u), self.get_band_number(v))
+                        for u, v in vector_pairs or []]
+        if vector_pairs:
+            rotation_angle = self.rotation_angle(dst_domain, rotation_step)
+
         # add band that masks valid values with 1 and nodata with 0
         # after reproject
         # TODD: REFACTOR: replace with VRT._add_swath_mask_band
@@ -645,7 +899,11 @@ class Nansat(Domain, Exporter):
                                            dst_gcps=dstGCPs,
                                            block_size=block_size, **kwargs)
 
-        # set global metadata from subVRT
+        # rotate vectors per block while reading (self.vrt.vrt is still the VRT before warping)
+        if vector_pairs:
+            self.vrt = self.vrt.get_rotated_vrt(vector_pairs, rotation_angle, rotation_step)
+
+        # set global metadata from subVRT (before warping)
         subMetaData = self.vrt.vrt.dataset.GetMetadata()
         subMetaData.pop('filename')
         self.set_metadata(subMetaData)
@@ -667,7 +925,7 @@ class Nansat(Domain, Exporter):
         """
         self.vrt = self.vrt.get_sub_vrt(steps)
 
-    def watermask(self, mod44path=None, dst_domain=None, **kwargs):
+    def watermask(self, mod44path=None, dst_domain=None, coastline=None, **kwargs):
         """
         Create numpy array with watermask (water=1, land=0)
 
@@ -694,6 +952,11 @@ class Nansat(Domain, Exporter):
             path with MOD44W Products and a VRT file
         dst_domain : Domain
             destination domain other than self
+        coastline : str
+            vector dataset with land polygons (e.g. GSHHG or OSM shapefile or
+            GeoPackage). If given, polygons are rasterized directly onto the
+            destination domain at its resolution instead of using MOD44W
+            (see nansat.landmask.landmask, kwargs are passed to it)
         tps : Bool
             Use Thin Spline Transformation in reprojection of watermask?
             See also Nansat.reproject()
@@ -712,6 +975,14 @@ class Nansat(Domain, Exporter):
         `<http://nansat.readthedocs.io/en/latest/source/features.html#differentiating-between-land-and-water>`_
 
         """
+        if dst_domain is None:
+            dst_domain = self
+        if coastline is not None:
+            from nansat.landmask import landmask
+            land = landmask(dst_domain, coastline, **kwargs)[1]
+            return Nansat.from_domain(dst_domain, (1 - land).astype(np.uint8),
+                                      {'name': 'watermask'})
+
         mod44DataExist = True
         # check if path is given in input param or in environment
         if mod44path is None:
@@ -732,14 +1003,13 @@ class Nansat(Domain, Exporter):
         watermask = Nansat(mod44path + '/MOD44W.vrt', mapper='MOD44W',
                            log_level=self.logger.level)
         # reproject on self or given Domain
-        if dst_domain is None:
-            dst_domain = self
         lon, lat = dst_domain.get_border()
         watermask.crop_lonlat([lon.min(), lon.max()], [lat.min(), lat.max()])
         watermask.reproject(dst_domain, addmask=False, **kwargs)
 
         return watermask
 
+    @memprofile.profiled('figure')
     def write_figure(self, filename='', bands=1, clim=None, addDate=False,
                      array_modfunc=None, **kwargs):
         """Save a raster band to a figure in graphical format.
@@ -1053,6 +1323,23 @@ class Nansat(Domain, Exporter):
         else:
             metadata_receiver.SetMetadataItem(str(key), str(value))
 
+    def start_io_stats(self):
+        """Start recording GDAL cache, /vsimem and I/O statistics of reading and export
+
+        Each band read (n[band]) and each export adds a record (dict) with keys:
+        operation, band, seconds, cache_used, cache_max, cache_used_delta,
+        vsimem_files_delta, vsimem_bytes_delta, bytes_read (Linux only) and
+        source_files (number of references and size of each source file).
+        See nansat.iostats for details.
+
+        """
+        self.io_records = []
+
+    def stop_io_stats(self):
+        """Stop recording I/O statistics and return list of records"""
+        records, self.io_records = self.io_records or [], None
+        return records
+
     def _get_dataset_metadata(self):
         # open GDAL dataset. It will be parsed to all mappers for testing
         gdal_dataset, metadata = None, dict()
@@ -1069,7 +1356,11 @@ class Nansat(Domain, Exporter):
         return gdal_dataset, metadata
 
 
-    def _get_mapper(self, mappername, **kwargs):
+    @tracing.traced('Nansat._get_mapper',
+                    lambda self, mappername, *args, **kwargs: {
+                        'file': self.filename, 'mapper': mappername})
+    @memprofile.profiled('open')
+    def _get_mapper(self, mappername, probe_threads=0, **kwargs):
         """Create VRT file in memory (VSI-file) with variable mapping
 
         If mappername is given only this mapper will be used,
@@ -1085,6 +1376,8 @@ class Nansat(Domain, Exporter):
         Parameters
         -----------
         mappername : string, optional (e.g. 'ASAR' or 'merisL2')
+        probe_threads : int, optional
+            number of threads for trying mappers concurrently (if > 1)
 
         Returns
         --------
@@ -1132,8 +1425,12 @@ class Nansat(Domain, Exporter):
                 #raise errType, err, traceback
 
             # create VRT using the selected mapper
-            tmp_vrt = nansatMappers[mappername](self.filename, gdal_dataset, metadata, **kwargs)
+            with tracing.span('mapper.__init__', file=self.filename, mapper=mappername):
+                tmp_vrt = nansatMappers[mappername](self.filename, gdal_dataset, metadata,
+                                                    **kwargs)
             self.mapper = mappername.replace('mapper_', '')
+        elif probe_threads > 1 and ThreadPoolExecutor is not None:
+            tmp_vrt = self._probe_mappers(probe_threads, **kwargs)
         else:
             # We test all mappers, import one by one
             import_errors = []
@@ -1154,7 +1451,9 @@ class Nansat(Domain, Exporter):
 
                 # create a Mapper object and get VRT dataset from it
                 try:
-                    tmp_vrt = nansatMappers[iMapper](self.filename, gdal_dataset, metadata, **kwargs)
+                    with tracing.span('mapper.__init__', file=self.filename, mapper=iMapper):
+                        tmp_vrt = nansatMappers[iMapper](self.filename, gdal_dataset, metadata,
+                                                         **kwargs)
                     self.logger.info('Mapper %s - success!' % iMapper)
                     self.mapper = iMapper.replace('mapper_', '')
                     break
@@ -1181,6 +1480,86 @@ class Nansat(Domain, Exporter):
 
         return tmp_vrt
 
+    def _probe_mapper(self, mappername, cancelled, **kwargs):
+        """Try one mapper with own GDAL dataset, return VRT or None
+
+        Mappers which are not thread-safe are tried one at a time. Returns None
+        without trying the mapper if <cancelled> (threading.Event) is set.
+        """
+        if _probe_thread_safe(nansatMappers[mappername]):
+            return self._try_mapper(mappername, cancelled, **kwargs)
+        with _serial_probe_lock:
+            return self._try_mapper(mappername, cancelled, **kwargs)
+
+    def _try_mapper(self, mappername, cancelled, **kwargs):
+        if cancelled.is_set():
+            return None
+        self.logger.debug('Trying %s...' % mappername)
+        # GDAL datasets cannot be shared between threads
+        gdal_dataset, metadata = self._get_dataset_metadata()
+        try:
+            with tracing.span('mapper.__init__', file=self.filename, mapper=mappername):
+                return nansatMappers[mappername](self.filename, gdal_dataset, metadata, **kwargs)
+        except WrongMapperError:
+            return None
+        finally:
+            gdal_dataset = None
+
+    def _probe_mappers(self, probe_threads, **kwargs):
+        """Try all mappers concurrently, return VRT from the first successful in order
+
+        Each mapper runs in a thread pool with its own GDAL dataset. Mappers
+        using libraries which are not thread-safe (netCDF4, HDF) are tried one
+        at a time (see _probe_thread_safe). Results are checked in the usual
+        order of mappers, so the result is the same as when mappers are tried
+        one by one: the first mapper which does not raise WrongMapperError is
+        used and errors of other exceptions are raised only if all previous
+        mappers failed. Probes which are not started yet are cancelled, running
+        probes are waited for (so that they release their files) and their
+        VRTs are closed.
+
+        Parameters
+        ----------
+        probe_threads : int
+            number of threads
+        **kwargs : dict
+            arguments for the mappers
+
+        Returns
+        -------
+        tmp_vrt : VRT or None
+
+        """
+        # skip non-importable mappers
+        mapper_names = [iMapper for iMapper in nansatMappers
+                        if not isinstance(nansatMappers[iMapper], tuple)]
+
+        tmp_vrt = None
+        cancelled = threading.Event()
+        executor = ThreadPoolExecutor(max_workers=probe_threads)
+        futures = [executor.submit(self._probe_mapper, iMapper, cancelled, **kwargs)
+                   for iMapper in mapper_names]
+        try:
+            for iMapper, future in zip(mapper_names, futures):
+                tmp_vrt = future.result()
+                if tmp_vrt is not None:
+                    self.logger.info('Mapper %s - success!' % iMapper)
+                    self.mapper = iMapper.replace('mapper_', '')
+                    break
+        finally:
+            cancelled.set()
+            for future in futures:
+                future.cancel()
+            executor.shutdown(wait=True)
+            # release VRTs from probes of other mappers
+            for future in futures:
+                if future.cancelled() or future.exception() is not None:
+                    continue
+                if future.result() is not None and future.result() is not tmp_vrt:
+                    future.result().close()
+
+        return tmp_vrt
+
     def get_band_number(self, band_id):
         """Return absolute band number
 
@@ -1568,6 +1947,29 @@ class Nansat(Domain, Exporter):
         return pixVector[gpi], linVector[gpi]
 
 
+def _probe_thread_safe(mapper):
+    """Can the mapper be probed concurrently with other mappers?
+
+    Mapper class can set attribute probe_thread_safe. Otherwise mappers
+    are not thread-safe if modules of the mapper or of its base classes use
+    THREAD_UNSAFE_MODULES (netCDF4, h5py, pyhdf).
+    """
+    if hasattr(mapper, 'probe_thread_safe'):
+        return mapper.probe_thread_safe
+    for cls in inspect.getmro(mapper):
+        module = sys.modules.get(cls.__module__)
+        if module is None:
+            continue
+        for value in list(vars(module).values()):
+            if inspect.ismodule(value):
+                name = value.__name__
+            else:
+                name = getattr(value, '__module__', None)
+            if isinstance(name, str) and name.split('.')[0] in THREAD_UNSAFE_MODULES:
+                return False
+    return True
+
+
 def _import_mappers(log_level=None):
     """Import available mappers into a dictionary
 
@@ -29,6 +29,9 @@
 
 #include <math.h>
 #include <gdal.h>
+#include <cpl_conv.h>
+#include <cpl_string.h>
+#include <cpl_vsi.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -37,6 +40,16 @@ void GenericPixelFunction(double f(double*), void **papoSources,
         GDALDataType eSrcType, GDALDataType eBufType,
         int nPixelSpace, int nLineSpace);
 
+/* Kernel of GenericLinePixelFunction: computes nXSize float values of one
+ * line starting at pixel ii of the sources */
+typedef void (*LinePixelKernel)(void **papoSources, int ii, int nXSize,
+        GDALDataType eSrcType, const float *pafArgs, float *pafOut);
+
+static CPLErr GenericLinePixelFunction(LinePixelKernel kernel,
+        const float *pafArgs, void **papoSources, void *pData,
+        int nXSize, int nYSize, GDALDataType eSrcType, GDALDataType eBufType,
+        int nPixelSpace, int nLineSpace);
+
 CPLErr RealPixelFunc(void **papoSources, int nSources, void *pData,
                      int nXSize, int nYSize,
                      GDALDataType eSrcType, GDALDataType eBufType,
@@ -928,6 +941,97 @@ CPLErr Sigma0HHBetaToSigma0VV(void **papoSources, int nSources, void *pData,
 }
 
 
+/* Radarsat-2 calibration with range-only LUT. Sources: DN (real or complex)
+ * and gains A of the LUT (lutSigma.xml, lutBeta.xml, lutGamma.xml):
+ *
+ *   sigma0 = (DN^2 + B) / A          (detected data)
+ *   sigma0 = (I^2 + Q^2) / A^2       (complex data, SLC)
+ *
+ * where B is the constant offset of the LUT, as in the RADARSAT_2_CALIB
+ * bands of GDAL (B is not used for SLC). The gains source is a single
+ * row of the LUT replicated to all lines by the VRT source (DstRect), so no
+ * full size LUT band is created. Float32 and CFloat32 sources are processed
+ * in plain loops over lines, other types are read with SRCVAL.
+ * Arguments of the kernel: offset B. */
+static void RSAT2LUTCalibrationLine(void **papoSources, int ii, int nXSize,
+        GDALDataType eSrcType, const float *pafArgs, float *pafOut){
+
+    int iCol;
+    double dfReal, dfImag, dfA;
+    const float fOffset = pafArgs[0];
+
+    if (eSrcType == GDT_Float32) {
+        const float *pafDN = ((const float *)papoSources[0]) + ii;
+        const float *pafA = ((const float *)papoSources[1]) + ii;
+        for( iCol = 0; iCol < nXSize; ++iCol )
+            pafOut[iCol] = (pafDN[iCol] * pafDN[iCol] + fOffset) /
+                           pafA[iCol];
+    } else if (eSrcType == GDT_CFloat32) {
+        const float *pafDN = ((const float *)papoSources[0]) + 2 * ii;
+        const float *pafA = ((const float *)papoSources[1]) + 2 * ii;
+        for( iCol = 0; iCol < nXSize; ++iCol )
+            pafOut[iCol] = (pafDN[2 * iCol] * pafDN[2 * iCol] +
+                            pafDN[2 * iCol + 1] * pafDN[2 * iCol + 1]) /
+                           (pafA[2 * iCol] * pafA[2 * iCol]);
+    } else if (GDALDataTypeIsComplex( eSrcType )) {
+        void *pImag = ((GByte *)papoSources[0])
+                    + GDALGetDataTypeSize( eSrcType ) / 8 / 2;
+        for( iCol = 0; iCol < nXSize; ++iCol, ++ii ) {
+            /* Source raster pixels may be obtained with SRCVAL macro */
+            dfReal = SRCVAL(papoSources[0], eSrcType, ii);
+            dfImag = SRCVAL(pImag, eSrcType, ii);
+            dfA = SRCVAL(papoSources[1], eSrcType, ii);
+            pafOut[iCol] = (float) ((dfReal * dfReal + dfImag * dfImag) /
+                                    (dfA * dfA));
+        }
+    } else {
+        for( iCol = 0; iCol < nXSize; ++iCol, ++ii ) {
+            /* Source raster pixels may be obtained with SRCVAL macro */
+            dfReal = SRCVAL(papoSources[0], eSrcType, ii);
+            pafOut[iCol] = (float) ((dfReal * dfReal + fOffset) /
+                                    SRCVAL(papoSources[1], eSrcType, ii));
+        }
+    }
+}
+
+static CPLErr RSAT2LUTCalibration(void **papoSources,
+        int nSources, void *pData, int nXSize, int nYSize,
+        GDALDataType eSrcType, GDALDataType eBufType,
+        int nPixelSpace, int nLineSpace, float fOffset){
+
+    /* ---- Init ---- */
+    if (nSources != 2) return CE_Failure;
+
+    return GenericLinePixelFunction(RSAT2LUTCalibrationLine, &fOffset,
+        papoSources, pData, nXSize, nYSize, eSrcType, eBufType,
+        nPixelSpace, nLineSpace);
+}
+
+#if GDAL_VERSION_NUM >= 3040000
+/* Sources: DN, LUT gains. Argument "offset" (default 0) */
+CPLErr RSAT2Calibration(void **papoSources,
+        int nSources, void *pData, int nXSize, int nYSize,
+        GDALDataType eSrcType, GDALDataType eBufType,
+        int nPixelSpace, int nLineSpace, CSLConstList papszArgs){
+
+    const char *pszOffset = CSLFetchNameValue(papszArgs, "offset");
+
+    return RSAT2LUTCalibration(papoSources, nSources, pData,
+        nXSize, nYSize, eSrcType, eBufType, nPixelSpace, nLineSpace,
+        (pszOffset != NULL) ? (float) CPLAtof(pszOffset) : 0.0f);
+}
+#else
+/* Sources: DN, LUT gains */
+CPLErr RSAT2Calibration(void **papoSources,
+        int nSources, void *pData, int nXSize, int nYSize,
+        GDALDataType eSrcType, GDALDataType eBufType,
+        int nPixelSpace, int nLineSpace){
+
+    return RSAT2LUTCalibration(papoSources, nSources, pData,
+        nXSize, nYSize, eSrcType, eBufType, nPixelSpace, nLineSpace, 0.0f);
+}
+#endif
+
 CPLErr RawcountsToSigma0_CosmoSkymed_SBI(void **papoSources, int nSources, void *pData,
         int nXSize, int nYSize,
         GDALDataType eSrcType, GDALDataType eBufType,
@@ -1005,6 +1109,193 @@ CPLErr RawcountsToSigma0_CosmoSkymed_QLK(void **papoSources, int nSources, void
 }
 
 
+#if GDAL_VERSION_NUM >= 3040000
+/* Intensity of a single band multiplied by a constant given as argument
+ * "scale" of the pixel function, e.g. calibration constant of SAR data:
+ *
+ *   <PixelFunctionType>ScaledIntensity</PixelFunctionType>
+ *   <PixelFunctionArguments scale="0.5"/>
+ *   <SourceTransferType>CInt16</SourceTransferType>
+ *
+ * Interleaved complex (CInt16, CFloat32) and real (Int16, Float32) sources
+ * are processed in plain loops over lines in single precision (vectorized
+ * by the compiler), other types are read with SRCVAL. */
+static void ScaledIntensityLine(void **papoSources, int ii, int nXSize,
+        GDALDataType eSrcType, const float *pafArgs, float *pafOut)
+{
+    int iCol;
+    float fReal, fImag;
+    const float fScale = pafArgs[0];
+
+    switch (eSrcType) {
+        case GDT_CInt16: {
+            const GInt16 *panSrc = ((const GInt16 *)papoSources[0]) + 2 * ii;
+            for( iCol = 0; iCol < nXSize; ++iCol ) {
+                fReal = (float) panSrc[2 * iCol];
+                fImag = (float) panSrc[2 * iCol + 1];
+                pafOut[iCol] = fScale * (fReal * fReal + fImag * fImag);
+            }
+            break;
+        }
+        case GDT_CFloat32: {
+            const float *pafSrc = ((const float *)papoSources[0]) + 2 * ii;
+            for( iCol = 0; iCol < nXSize; ++iCol ) {
+                fReal = pafSrc[2 * iCol];
+                fImag = pafSrc[2 * iCol + 1];
+                pafOut[iCol] = fScale * (fReal * fReal + fImag * fImag);
+            }
+            break;
+        }
+        case GDT_Int16: {
+            const GInt16 *panSrc = ((const GInt16 *)papoSources[0]) + ii;
+            for( iCol = 0; iCol < nXSize; ++iCol ) {
+                fReal = (float) panSrc[iCol];
+                pafOut[iCol] = fScale * fReal * fReal;
+            }
+            break;
+        }
+        case GDT_Float32: {
+            const float *pafSrc = ((const float *)papoSources[0]) + ii;
+            for( iCol = 0; iCol < nXSize; ++iCol ) {
+                pafOut[iCol] = fScale * pafSrc[iCol] * pafSrc[iCol];
+            }
+            break;
+        }
+        default: {
+            double dfReal, dfImag = 0;
+            void *pImag = ((GByte *)papoSources[0]) +
+                          GDALGetDataTypeSize( eSrcType ) / 8 / 2;
+            for( iCol = 0; iCol < nXSize; ++iCol, ++ii ) {
+                /* Source raster pixels may be obtained with SRCVAL macro */
+                dfReal = SRCVAL(papoSources[0], eSrcType, ii);
+                if (GDALDataTypeIsComplex( eSrcType ))
+                    dfImag = SRCVAL(pImag, eSrcType, ii);
+                pafOut[iCol] = (float) (fScale * (dfReal * dfReal +
+                                                  dfImag * dfImag));
+            }
+        }
+    }
+}
+
+CPLErr ScaledIntensity(void **papoSources, int nSources, void *pData,
+                       int nXSize, int nYSize,
+                       GDALDataType eSrcType, GDALDataType eBufType,
+                       int nPixelSpace, int nLineSpace,
+                       CSLConstList papszArgs)
+{
+    float fScale;
+    const char *pszScale;
+
+    /* ---- Init ---- */
+    if (nSources != 1) return CE_Failure;
+
+    pszScale = CSLFetchNameValue(papszArgs, "scale");
+    fScale = (pszScale != NULL) ? (float) CPLAtof(pszScale) : 1.0f;
+
+    return GenericLinePixelFunction(ScaledIntensityLine, &fScale,
+        papoSources, pData, nXSize, nYSize, eSrcType, eBufType,
+        nPixelSpace, nLineSpace);
+} /* ScaledIntensity */
+#endif
+
+
+#if GDAL_VERSION_NUM >= 3040000
+/* Values of GLOBCOLOUR L3B bins remapped onto the destination grid on reading.
+ * Sources: latitude and longitude of the destination pixels. Arguments are
+ * names of /vsimem/ files with tables of bins sorted by row and by column
+ * within each row (see nansat/mappers/globcolour.py), used without copying:
+ *
+ *   "row_start" - Int32, bins of 1-based row r are row_start[r]:row_start[r+1]
+ *   "cols"      - Int32, 1-based column of each bin
+ *   "values"    - Float32, value of each bin
+ *   "mask"      - if 1, GLOBCOLOUR mask is computed instead of values
+ *                 (64 - valid bin, 1 - no data)
+ *
+ * Pixels without a bin get value 0. */
+CPLErr GlobcolourBins(void **papoSources, int nSources, void *pData,
+                      int nXSize, int nYSize,
+                      GDALDataType eSrcType, GDALDataType eBufType,
+                      int nPixelSpace, int nLineSpace,
+                      CSLConstList papszArgs)
+{
+    const int nRows = 180 * 24;
+    int ii, iLine, iCol;
+    int nRow, nCol, iLow, iHigh, iMid;
+    int bMask;
+    double dfLat, dfLon, dfVal;
+    const char *pszRowStart, *pszCols, *pszValues, *pszMask;
+    const GInt32 *panRowStart, *panCols;
+    const float *pafValues;
+    vsi_l_offset nRowStartSize, nColsSize, nValuesSize;
+
+    /* ---- Init ---- */
+    if (nSources != 2) return CE_Failure;
+
+    pszRowStart = CSLFetchNameValue(papszArgs, "row_start");
+    pszCols = CSLFetchNameValue(papszArgs, "cols");
+    pszValues = CSLFetchNameValue(papszArgs, "values");
+    pszMask = CSLFetchNameValue(papszArgs, "mask");
+    if (pszRowStart == NULL || pszCols == NULL || pszValues == NULL)
+        return CE_Failure;
+    bMask = (pszMask != NULL) && atoi(pszMask);
+
+    panRowStart = (const GInt32 *) VSIGetMemFileBuffer(pszRowStart,
+                                                       &nRowStartSize, FALSE);
+    panCols = (const GInt32 *) VSIGetMemFileBuffer(pszCols, &nColsSize, FALSE);
+    pafValues = (const float *) VSIGetMemFileBuffer(pszValues, &nValuesSize,
+                                                    FALSE);
+    if (panRowStart == NULL || panCols == NULL || pafValues == NULL ||
+        nRowStartSize < (nRows + 3) * sizeof(GInt32) ||
+        nColsSize / sizeof(GInt32) != nValuesSize / sizeof(float)) {
+        CPLError(CE_Failure, CPLE_AppDefined,
+                 "GlobcolourBins: invalid tables of bins");
+        return CE_Failure;
+    }
+
+    /* ---- Set pixels ---- */
+    for( iLine = 0, ii = 0; iLine < nYSize; ++iLine ) {
+        for( iCol = 0; iCol < nXSize; ++iCol, ++ii ) {
+            /* Source raster pixels may be obtained with SRCVAL macro */
+            dfLat = SRCVAL(papoSources[0], eSrcType, ii);
+            dfLon = SRCVAL(papoSources[1], eSrcType, ii);
+            dfVal = 0;
+
+            /* row and column of the GLOBCOLOUR grid */
+            if (dfLat >= -90 && dfLat <= 90 && dfLon >= -180 && dfLon <= 180) {
+                nRow = (int) rint(1 + (nRows - 1) * (dfLat + 90) / 180.);
+                nCol = (int) rint(1 + (dfLon + 180) * 24. *
+                                  cos(3.14159265358979323846 * dfLat / 180.));
+
+                /* binary search of the column within the row */
+                iLow = panRowStart[nRow];
+                iHigh = panRowStart[nRow + 1] - 1;
+                while (iLow <= iHigh) {
+                    iMid = (iLow + iHigh) / 2;
+                    if (panCols[iMid] < nCol)
+                        iLow = iMid + 1;
+                    else if (panCols[iMid] > nCol)
+                        iHigh = iMid - 1;
+                    else {
+                        dfVal = pafValues[iMid];
+                        break;
+                    }
+                }
+            }
+            if (bMask)
+                dfVal = dfVal > 0 ? 64 : 1;
+
+            GDALCopyWords(&dfVal, GDT_Float64, 0,
+                          ((GByte *)pData) + nLineSpace * iLine + iCol * nPixelSpace,
+                          eBufType, nPixelSpace, 1);
+        }
+    }
+
+    /* ---- Return success ---- */
+    return CE_None;
+} /* GlobcolourBins */
+#endif
+
+
 CPLErr ComplexData(void **papoSources, int nSources, void *pData,
         int nXSize, int nYSize,
         GDALDataType eSrcType, GDALDataType eBufType,
@@ -1138,6 +1429,13 @@ double Sentinel1CalibrationFunction(double *b){
 
 }
 
+double Sentinel1NESZFunction(double *b){
+
+    // Noise equivalent sigma0: b[0] - noise LUT, b[1] - sigmaNought LUT
+    return b[0] / pow(b[1], 2.0);
+
+}
+
 double Sigma0HHToSigma0VVFunction(double *b){
     double pi = 3.14159265;
     double s0hh, factor;
@@ -1231,6 +1529,53 @@ CPLErr UVToDirectionFrom(void **papoSources, int nSources, void *pData,
     return CE_None;
 }
 
+double UVRotatedUFunction(double *b){
+        /* Rotate vector (u=b[0], v=b[1]) counter-clockwise by b[2] degrees,
+           return the first component */
+    double pi = 3.14159265;
+    double angle = b[2] * pi / 180.0;
+    return b[0] * cos(angle) - b[1] * sin(angle);
+}
+
+double UVRotatedVFunction(double *b){
+        /* Rotate vector (u=b[0], v=b[1]) counter-clockwise by b[2] degrees,
+           return the second component */
+    double pi = 3.14159265;
+    double angle = b[2] * pi / 180.0;
+    return b[0] * sin(angle) + b[1] * cos(angle);
+}
+
+/* pixel functions for rotation of grid-relative vectors in Nansat.reproject */
+CPLErr UVRotatedU(void **papoSources, int nSources, void *pData,
+        int nXSize, int nYSize,
+        GDALDataType eSrcType, GDALDataType eBufType,
+        int nPixelSpace, int nLineSpace){
+
+    if (nSources != 3) return CE_Failure;
+
+    GenericPixelFunction(UVRotatedUFunction,
+        papoSources, nSources,  pData,
+        nXSize, nYSize, eSrcType, eBufType,
+        nPixelSpace, nLineSpace);
+
+    return CE_None;
+}
+
+CPLErr UVRotatedV(void **papoSources, int nSources, void *pData,
+        int nXSize, int nYSize,
+        GDALDataType eSrcType, GDALDataType eBufType,
+        int nPixelSpace, int nLineSpace){
+
+    if (nSources != 3) return CE_Failure;
+
+    GenericPixelFunction(UVRotatedVFunction,
+        papoSources, nSources,  pData,
+        nXSize, nYSize, eSrcType, eBufType,
+        nPixelSpace, nLineSpace);
+
+    return CE_None;
+}
+
 
 CPLErr NormReflectanceToRemSensReflectance(void **papoSources, int nSources, void *pData,
         int nXSize, int nYSize,
@@ -1258,6 +1603,95 @@ CPLErr Sentinel1Calibration(void **papoSources,
     return CE_None;
 }
 
+/* Denoised Sentinel-1 calibration in one pass over three sources:
+ * DN, calibration LUT A (sigmaNought or betaNought) and noise LUT:
+ *
+ *   sigma0 = (DN^2 - noise) / A^2
+ *
+ * Values below fFloor (also negative values after noise subtraction) are
+ * set to fFloor. Float32 sources are processed in plain loops over lines
+ * in single precision, other types are read with SRCVAL. */
+static void Sentinel1DenoisedCalibrationLine(void **papoSources, int ii,
+        int nXSize, GDALDataType eSrcType, const float *pafArgs,
+        float *pafOut){
+
+    int iCol;
+    float fDN, fA, fSigma0;
+    const float fFloor = pafArgs[0];
+
+    if (eSrcType == GDT_Float32) {
+        const float *pafDN = ((const float *)papoSources[0]) + ii;
+        const float *pafA = ((const float *)papoSources[1]) + ii;
+        const float *pafNoise = ((const float *)papoSources[2]) + ii;
+        for( iCol = 0; iCol < nXSize; ++iCol ) {
+            fSigma0 = (pafDN[iCol] * pafDN[iCol] - pafNoise[iCol]) /
+                      (pafA[iCol] * pafA[iCol]);
+            pafOut[iCol] = fSigma0 > fFloor ? fSigma0 : fFloor;
+        }
+    } else {
+        for( iCol = 0; iCol < nXSize; ++iCol, ++ii ) {
+            /* Source raster pixels may be obtained with SRCVAL macro */
+            fDN = (float) SRCVAL(papoSources[0], eSrcType, ii);
+            fA = (float) SRCVAL(papoSources[1], eSrcType, ii);
+            fSigma0 = (fDN * fDN -
+                       (float) SRCVAL(papoSources[2], eSrcType, ii)) /
+                      (fA * fA);
+            pafOut[iCol] = fSigma0 > fFloor ? fSigma0 : fFloor;
+        }
+    }
+}
+
+static CPLErr Sentinel1DenoisedCalibration(void **papoSources,
+        int nSources, void *pData, int nXSize, int nYSize,
+        GDALDataType eSrcType, GDALDataType eBufType,
+        int nPixelSpace, int nLineSpace, float fFloor){
+
+    /* ---- Init ---- */
+    if (nSources != 3) return CE_Failure;
+
+    return GenericLinePixelFunction(Sentinel1DenoisedCalibrationLine, &fFloor,
+        papoSources, pData, nXSize, nYSize, eSrcType, eBufType,
+        nPixelSpace, nLineSpace);
+}
+
+#if GDAL_VERSION_NUM >= 3040000
+/* Sources: DN, calibration LUT, noise LUT. Argument "floor" (default 0) */
+CPLErr Sentinel1Denoising(void **papoSources,
+        int nSources, void *pData, int nXSize, int nYSize,
+        GDALDataType eSrcType, GDALDataType eBufType,
+        int nPixelSpace, int nLineSpace, CSLConstList papszArgs){
+
+    const char *pszFloor = CSLFetchNameValue(papszArgs, "floor");
+
+    return Sentinel1DenoisedCalibration(papoSources, nSources, pData,
+        nXSize, nYSize, eSrcType, eBufType, nPixelSpace, nLineSpace,
+        (pszFloor != NULL) ? (float) CPLAtof(pszFloor) : 0.0f);
+}
+#else
+/* Sources: DN, calibration LUT, noise LUT */
+CPLErr Sentinel1Denoising(void **papoSources,
+        int nSources, void *pData, int nXSize, int nYSize,
+        GDALDataType eSrcType, GDALDataType eBufType,
+        int nPixelSpace, int nLineSpace){
+
+    return Sentinel1DenoisedCalibration(papoSources, nSources, pData,
+        nXSize, nYSize, eSrcType, eBufType, nPixelSpace, nLineSpace, 0.0f);
+}
+#endif
+
+CPLErr Sentinel1NESZ(void **papoSources,
+        int nSources, void *pData, int nXSize, int nYSize,
+                GDALDataType eSrcType, GDALDataType eBufType,
+                int nPixelSpace, int nLineSpace){
+
+    GenericPixelFunction(Sentinel1NESZFunction,
+        papoSources, nSources, pData,
+        nXSize, nYSize, eSrcType, eBufType,
+        nPixelSpace, nLineSpace);
+
+    return CE_None;
+}
+
 CPLErr Sentinel1Sigma0HHToSigma0VV(void **papoSources,
         int nSources, void *pData, int nXSize, int nYSize,
                 GDALDataType eSrcType, GDALDataType eBufType,
@@ -1375,6 +1809,40 @@ void GenericPixelFunction(double f(double*), void **papoSources,
     }
 }
 
+// all data (band) size must be same and full size of bands (XSize x YSize).
+// The kernel computes one line in single precision; the line is written
+// directly into the output buffer if it is contiguous float, or copied
+// with GDALCopyWords otherwise.
+static CPLErr GenericLinePixelFunction(LinePixelKernel kernel,
+        const float *pafArgs, void **papoSources, void *pData,
+        int nXSize, int nYSize, GDALDataType eSrcType, GDALDataType eBufType,
+        int nPixelSpace, int nLineSpace)
+{
+    int iLine;
+    int bDirect;
+    float *pafLine = NULL;
+    float *pafOut;
+
+    bDirect = (eBufType == GDT_Float32 && nPixelSpace == sizeof(float));
+    if (!bDirect)
+        pafLine = (float *) CPLMalloc(sizeof(float) * nXSize);
+
+    /* ---- Set pixels ---- */
+    for( iLine = 0; iLine < nYSize; ++iLine ) {
+        pafOut = bDirect ? (float *)(((GByte *)pData) + nLineSpace * iLine)
+                         : pafLine;
+        kernel(papoSources, iLine * nXSize, nXSize, eSrcType, pafArgs, pafOut);
+        if (!bDirect)
+            GDALCopyWords(pafLine, GDT_Float32, sizeof(float),
+                          ((GByte *)pData) + nLineSpace * iLine,
+                          eBufType, nPixelSpace, nXSize);
+    }
+
+    CPLFree(pafLine);
+
+    return CE_None;
+}
+
 // From the 1st to (N-1)th bands are full size (XSize x YSize),
 // and the last band is a one-pixel band (1 x 1).
 void GenericPixelFunctionPixel(double f(double*), void **papoSources,
@@ -1494,6 +1962,10 @@ void GenericPixelFunctionPixelLine(double f(double*), void **papoSources,
  * - "inv": inverse (1./x). Note: no check is performed on zero division
  * - "intensity": computes the intensity Re(x*conj(x)) of a single raster band
  *                (real or complex)
+ * - "ScaledIntensity": intensity of a single raster band multiplied by
+ *                      argument "scale" (requires GDAL >= 3.4)
+ * - "GlobcolourBins": values of GLOBCOLOUR L3B bins for latitude and
+ *                     longitude bands (requires GDAL >= 3.4)
  * - "sqrt": perform the square root of a single raster band (real only)
  * - "log10": compute the logarithm (base 10) of the abs of a single raster
  *            band (real or complex): log10( abs( x ) )
@@ -1530,7 +2002,14 @@ CPLErr CPL_STDCALL GDALRegisterDefaultPixelFunc()
     GDALAddDerivedBandPixelFunc("UVToMagnitude", UVToMagnitude);
     GDALAddDerivedBandPixelFunc("UVToDirectionTo", UVToDirectionTo);
     GDALAddDerivedBandPixelFunc("UVToDirectionFrom", UVToDirectionFrom);
+    GDALAddDerivedBandPixelFunc("UVRotatedU", UVRotatedU);
+    GDALAddDerivedBandPixelFunc("UVRotatedV", UVRotatedV);
     GDALAddDerivedBandPixelFunc("Sigma0HHBetaToSigma0VV", Sigma0HHBetaToSigma0VV); //Radarsat-2
+#if GDAL_VERSION_NUM >= 3040000
+    GDALAddDerivedBandPixelFuncWithArgs("RSAT2Calibration", RSAT2Calibration, NULL);
+#else
+    GDALAddDerivedBandPixelFunc("RSAT2Calibration", RSAT2Calibration);
+#endif
     GDALAddDerivedBandPixelFunc("Sigma0HHToSigma0VV", Sigma0HHToSigma0VV); // ASAR
     GDALAddDerivedBandPixelFunc("RawcountsIncidenceToSigma0", RawcountsIncidenceToSigma0);
     GDALAddDerivedBandPixelFunc("RawcountsToSigma0_CosmoSkymed_QLK", RawcountsToSigma0_CosmoSkymed_QLK);
@@ -1542,8 +2021,18 @@ CPLErr CPL_STDCALL GDALRegisterDefaultPixelFunc()
     GDALAddDerivedBandPixelFunc("Sigma0VVNormalizedWater", Sigma0VVNormalizedWater);
     GDALAddDerivedBandPixelFunc("Sentinel1Calibration", Sentinel1Calibration);
     GDALAddDerivedBandPixelFunc("Sentinel1Sigma0HHToSigma0VV", Sentinel1Sigma0HHToSigma0VV);
+#if GDAL_VERSION_NUM >= 3040000
+    GDALAddDerivedBandPixelFuncWithArgs("Sentinel1Denoising", Sentinel1Denoising, NULL);
+#else
+    GDALAddDerivedBandPixelFunc("Sentinel1Denoising", Sentinel1Denoising);
+#endif
+    GDALAddDerivedBandPixelFunc("Sentinel1NESZ", Sentinel1NESZ);
     GDALAddDerivedBandPixelFunc("IntensityInt", IntensityInt);
     GDALAddDerivedBandPixelFunc("OnesPixelFunc", OnesPixelFunc);
+#if GDAL_VERSION_NUM >= 3040000
+    GDALAddDerivedBandPixelFuncWithArgs("ScaledIntensity", ScaledIntensity, NULL);
+    GDALAddDerivedBandPixelFuncWithArgs("GlobcolourBins", GlobcolourBins, NULL);
+#endif
     return CE_None;
 }
 
@@ -0,0 +1,184 @@
+# Name:    prefetch.py
+# Purpose: Read blocks of VRT bands ahead in background threads
+# Licence:
+# This file is part of NANSAT.
+# NANSAT is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3 of the License.
+# http://www.gnu.org/licenses/gpl-3.0.html
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+"""Read-ahead of blocks of lines of VRT bands
+
+BlockReader iterates over blocks of lines of several bands. While the
+current block is processed by the caller, the next <depth> blocks are
+evaluated in background threads, each with own GDAL dataset opened from the
+VRT. Evaluation of a block includes reading of all underlying sources,
+pixel functions and warping, so slow sources (/vsizip, /vsitar, network file
+systems) are read in parallel with processing of the previous blocks.
+
+"""
+from __future__ import absolute_import
+import threading
+from collections import OrderedDict, deque
+
+try:
+    from concurrent.futures import ThreadPoolExecutor
+except ImportError:
+    ThreadPoolExecutor = None
+
+import numpy as np
+
+from nansat.utils import gdal
+
+# number of GDAL datasets kept open in each thread
+THREAD_DATASETS = 32
+
+# {thread: OrderedDict of datasets opened in the thread}
+_thread_datasets = {}
+_lock = threading.Lock()
+
+
+def thread_dataset(filename, raster_count=None):
+    """Return GDAL dataset of a (VRT) file opened in the current thread
+
+    Parameters
+    ----------
+    filename : str
+        name of the file
+    raster_count : int
+        number of bands in the file. Changes when bands are added to a VRT,
+        and the dataset is then re-opened
+
+    """
+    thread = threading.current_thread()
+    key = (filename, raster_count)
+    with _lock:
+        datasets = _thread_datasets.get(thread)
+        if datasets is None:
+            # forget datasets of finished threads
+            for old_thread in [t for t in _thread_datasets if not t.is_alive()]:
+                del _thread_datasets[old_thread]
+            datasets = _thread_datasets[thread] = OrderedDict()
+        dataset = datasets.pop(key, None)
+    if dataset is None:
+        dataset = gdal.Open(filename)
+    with _lock:
+        datasets[key] = dataset
+        while len(datasets) > THREAD_DATASETS:
+            datasets.popitem(last=False)
+    return dataset
+
+
+def forget_datasets(filename):
+    """Drop datasets opened from the file in all threads (e.g. when the file is deleted)
+
+    Datasets which are being read in other threads are closed when reading is finished.
+    """
+    with _lock:
+        for datasets in _thread_datasets.values():
+            for key in [key for key in datasets if key[0] == filename]:
+                del datasets[key]
+
+
+class BlockReader(object):
+    """Iterate over blocks of lines of VRT bands with read-ahead"""
+
+    def __init__(self, vrt, band_numbers=None, block_lines=256, depth=2, max_memory=None):
+        """Prepare reading
+
+        Parameters
+        ----------
+        vrt : VRT
+            VRT to read
+        band_numbers : list of int
+            bands to read. All bands if None
+        block_lines : int
+            number of lines in one block
+        depth : int
+            number of blocks read ahead in background threads (0 - no read-ahead)
+        max_memory : int
+            maximum memory (bytes) of blocks read ahead. Reduces depth if needed
+
+        """
+        if band_numbers is None:
+            band_numbers = range(1, vrt.dataset.RasterCount + 1)
+        self.band_numbers = list(band_numbers)
+        # write XML into /vsimem before it is opened in other threads
+        vrt.dataset.FlushCache()
+        self.filename = vrt.filename
+        self.raster_count = vrt.dataset.RasterCount
+        self.x_size = vrt.dataset.RasterXSize
+        self.y_size = vrt.dataset.RasterYSize
+        self.block_lines = block_lines
+        block_bytes = sum(self.x_size * block_lines *
+                          gdal.GetDataTypeSize(vrt.dataset.GetRasterBand(b).DataType) // 8
+                          for b in self.band_numbers)
+        if max_memory is not None:
+            depth = min(depth, max_memory // max(block_bytes, 1))
+        if ThreadPoolExecutor is None:
+            depth = 0
+        self.depth = max(0, int(depth))
+
+    def read_block(self, y_off):
+        """Read one block of all bands in the current thread"""
+        dataset = thread_dataset(self.filename, self.raster_count)
+        if dataset is None:
+            raise IOError('Cannot open %s' % self.filename)
+        lines = min(self.block_lines, self.y_size - y_off)
+        blocks = []
+        for b in self.band_numbers:
+            block = dataset.GetRasterBand(b).ReadAsArray(0, y_off, self.x_size, lines)
+            if block is None:
+                raise IOError('Cannot read lines %d - %d of band %d from %s' % (
+                              y_off, y_off + lines, b, self.filename))
+            blocks.append(block)
+        return blocks
+
+    def __iter__(self):
+        """Yield (y_off, list of arrays) for each block"""
+        offsets = iter(range(0, self.y_size, self.block_lines))
+        if self.depth == 0:
+            for y_off in offsets:
+                yield y_off, self.read_block(y_off)
+            return
+
+        pool = ThreadPoolExecutor(self.depth)
+        futures = deque()
+        try:
+            for y_off in offsets:
+                futures.append((y_off, pool.submit(self.read_block, y_off)))
+                if len(futures) == self.depth:
+                    break
+            while futures:
+                y_off, future = futures.popleft()
+                blocks = future.result()
+                for next_y_off in offsets:
+                    futures.append((next_y_off, pool.submit(self.read_block, next_y_off)))
+                    break
+                yield y_off, blocks
+        finally:
+            for y_off, future in futures:
+                future.cancel()
+            pool.shutdown(wait=True)
+
+
+def read_bands(vrt, band_numbers=None, block_lines=256, depth=2, max_memory=None,
+               allocate=None):
+    """Read full bands of VRT with read-ahead of blocks, return list of arrays
+
+    allocate(band_number, shape, dtype) returns array for the band (e.g. in
+    shared memory). numpy.empty is used if allocate is None.
+    """
+    if allocate is None:
+        allocate = lambda band_number, shape, dtype: np.empty(shape, dtype)
+    reader = BlockReader(vrt, band_numbers, block_lines, depth, max_memory)
+    arrays = None
+    for y_off, blocks in reader:
+        if arrays is None:
+            arrays = [allocate(band_number, (reader.y_size, reader.x_size), block.dtype)
+                      for band_number, block in zip(reader.band_numbers, blocks)]
+        for array, block in zip(arrays, blocks):
+            array[y_off:y_off + block.shape[0]] = block
+    return arrays
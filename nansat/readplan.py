@@ -0,0 +1,224 @@
+# Name:    readplan.py
+# Purpose: Walk the chain of VRTs behind a band and describe how it is read
+# Licence:
+# This file is part of NANSAT.
+# NANSAT is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3 of the License.
+# http://www.gnu.org/licenses/gpl-3.0.html
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+"""Read plan of a band: graph of VRTs, pixel functions and source files
+
+Each node of the plan is a dict with keys:
+    type : 'VRTDataset', 'VRTWarpedDataset' or 'file'
+    filename, band : file and band number
+    size : (xSize, ySize) of the dataset
+    data_type : name of GDAL data type of the band
+    pixel_function : name of pixel function (VRT bands only)
+    resampling : resampling algorithm of the source or of warping
+    source_type : how the parent reads the node (SimpleSource, ComplexSource, ..)
+    window : (xOff, yOff, xSize, ySize) read from the node for the requested window
+    bytes : estimated bytes touched in the node (window size * data type size)
+    seconds : measured time of reading the window (if requested)
+    sources : list of child nodes
+
+Windows are propagated through SrcRect/DstRect of the sources. For warped
+VRTs the source window is estimated by scaling with the ratio of sizes.
+Measured times are inclusive (a node includes reading of its sources) and
+are affected by the GDAL block cache.
+
+"""
+from __future__ import absolute_import, print_function
+import time
+
+from nansat.utils import gdal
+from nansat.node import Node
+from nansat.vrt import VRT
+from nansat.iostats import SOURCE_TAGS, source_filename
+
+# protection against cyclic references
+MAX_DEPTH = 32
+
+
+def explain(filename, band=1, window=None, measure=False, depth=0):
+    """Return read plan of a band in a (VRT) file
+
+    Parameters
+    ----------
+    filename : str
+        name of the file
+    band : int
+        band number
+    window : tuple of int
+        (xOff, yOff, xSize, ySize) of the window. Full band if None
+    measure : bool
+        read the window from each node and add measured time
+
+    Returns
+    -------
+    plan : dict
+        root node of the read plan (see module documentation)
+
+    """
+    plan = {'filename': filename, 'band': band, 'sources': [],
+            'pixel_function': None, 'resampling': None}
+    xml = None
+    if filename.lower().endswith('.vrt') and depth < MAX_DEPTH:
+        xml = VRT.read_vsi(filename)
+
+    if xml:
+        root = Node.create(xml)
+        plan['size'] = (int(root.getAttribute('rasterXSize')),
+                        int(root.getAttribute('rasterYSize')))
+        warp_options = root.node('GDALWarpOptions')
+        if warp_options:
+            _explain_warped(plan, root, warp_options, band, window, measure, depth)
+        else:
+            _explain_vrt(plan, root, band, window, measure, depth)
+    else:
+        plan['type'] = 'file'
+        plan['size'], plan['data_type'] = None, None
+        dataset = gdal.Open(filename)
+        if dataset is not None and band <= dataset.RasterCount:
+            plan['size'] = (dataset.RasterXSize, dataset.RasterYSize)
+            plan['data_type'] = gdal.GetDataTypeName(
+                dataset.GetRasterBand(band).DataType)
+
+    if window is None and plan['size'] is not None:
+        window = (0, 0) + tuple(plan['size'])
+    plan['window'] = window
+    plan['bytes'] = _window_bytes(window, plan['data_type'])
+    if measure and window is not None:
+        plan['seconds'] = _measure(filename, band, window)
+    return plan
+
+
+def _explain_vrt(plan, root, band, window, measure, depth):
+    """Add properties and sources of a band of a VRTDataset to the plan"""
+    plan['type'] = 'VRTDataset'
+    plan['data_type'] = None
+    band_nodes = [b for b in root.nodeList('VRTRasterBand')
+                  if int(b.getAttribute('band')) == band]
+    if not band_nodes:
+        return
+    band_node = band_nodes[0]
+    plan['data_type'] = band_node.attributes.get('dataType')
+    pixel_function = band_node.node('PixelFunctionType')
+    if pixel_function:
+        plan['pixel_function'] = pixel_function.value
+    if window is None:
+        window = (0, 0) + tuple(plan['size'])
+    for source_node in band_node.children:
+        if source_node.tag not in SOURCE_TAGS:
+            continue
+        src_band = source_node.node('SourceBand')
+        src_band = int(src_band.value) if src_band else 1
+        src_window = _source_window(window, source_node.node('SrcRect'),
+                                    source_node.node('DstRect'))
+        if src_window is None:
+            # source does not overlap with the window
+            continue
+        filename = source_filename(source_node.node('SourceFilename'), plan['filename'])
+        child = explain(filename, src_band, src_window, measure, depth + 1)
+        child['source_type'] = source_node.tag
+        child['resampling'] = source_node.attributes.get('resampling')
+        plan['sources'].append(child)
+
+
+def _explain_warped(plan, root, warp_options, band, window, measure, depth):
+    """Add properties and source of a band of a VRTWarpedDataset to the plan"""
+    plan['type'] = 'VRTWarpedDataset'
+    plan['data_type'] = None
+    working_type = warp_options.node('WorkingDataType')
+    if working_type:
+        plan['data_type'] = working_type.value
+    for band_node in root.nodeList('VRTRasterBand'):
+        if int(band_node.getAttribute('band')) == band:
+            plan['data_type'] = band_node.attributes.get('dataType', plan['data_type'])
+    resample_alg = warp_options.node('ResampleAlg')
+    if resample_alg:
+        plan['resampling'] = resample_alg.value
+
+    src_band = band
+    band_list = warp_options.node('BandList')
+    for band_mapping in band_list.nodeList('BandMapping') if band_list else []:
+        if int(band_mapping.getAttribute('dst')) == band:
+            src_band = int(band_mapping.getAttribute('src'))
+    filename = source_filename(warp_options.node('SourceDataset'), plan['filename'])
+    # window in the source is unknown without the transformer: scale by sizes
+    src_window = None
+    dataset = gdal.Open(filename)
+    if window is not None and dataset is not None:
+        x_ratio = dataset.RasterXSize / float(plan['size'][0])
+        y_ratio = dataset.RasterYSize / float(plan['size'][1])
+        src_window = (int(window[0] * x_ratio), int(window[1] * y_ratio),
+                      max(1, int(round(window[2] * x_ratio))),
+                      max(1, int(round(window[3] * y_ratio))))
+    child = explain(filename, src_band, src_window, measure, depth + 1)
+    child['source_type'] = 'GDALWarpOptions'
+    plan['sources'].append(child)
+
+
+def _source_window(window, src_rect, dst_rect):
+    """Map window in the VRT band to window in the source through SrcRect/DstRect"""
+    if not src_rect or not dst_rect:
+        return window
+    src = [float(src_rect.getAttribute(k)) for k in ['xOff', 'yOff', 'xSize', 'ySize']]
+    dst = [float(dst_rect.getAttribute(k)) for k in ['xOff', 'yOff', 'xSize', 'ySize']]
+    x0 = max(window[0], dst[0])
+    y0 = max(window[1], dst[1])
+    x1 = min(window[0] + window[2], dst[0] + dst[2])
+    y1 = min(window[1] + window[3], dst[1] + dst[3])
+    if x1 <= x0 or y1 <= y0 or dst[2] == 0 or dst[3] == 0:
+        return None
+    x_ratio = src[2] / dst[2]
+    y_ratio = src[3] / dst[3]
+    return (int(src[0] + (x0 - dst[0]) * x_ratio),
+            int(src[1] + (y0 - dst[1]) * y_ratio),
+            max(1, int(round((x1 - x0) * x_ratio))),
+            max(1, int(round((y1 - y0) * y_ratio))))
+
+
+def _window_bytes(window, data_type):
+    """Estimate number of bytes in the window"""
+    if window is None or data_type is None:
+        return None
+    data_type_size = gdal.GetDataTypeSize(gdal.GetDataTypeByName(str(data_type))) // 8
+    return window[2] * window[3] * data_type_size
+
+
+def _measure(filename, band, window):
+    """Measure time of reading window from band of the file"""
+    dataset = gdal.Open(filename)
+    if dataset is None:
+        return None
+    t0 = time.time()
+    dataset.GetRasterBand(band).ReadRaster(*window)
+    return time.time() - t0
+
+
+def total_bytes(plan):
+    """Return estimated bytes touched in the plan (all nodes)"""
+    return (plan['bytes'] or 0) + sum(total_bytes(child) for child in plan['sources'])
+
+
+def format_plan(plan, indent=0):
+    """Return read plan as indented text (one line per node)"""
+    line = '%s%s %s [%s]' % ('  ' * indent, plan['type'], plan['filename'], plan['band'])
+    if plan['size'] is not None:
+        line += ' %dx%d' % tuple(plan['size'])
+    for key in ['data_type', 'source_type', 'pixel_function', 'resampling']:
+        if plan.get(key):
+            line += ' %s=%s' % (key, plan[key])
+    if plan['window'] is not None:
+        line += ' window=%s' % str(tuple(plan['window']))
+    if plan['bytes'] is not None:
+        line += ' bytes=%d' % plan['bytes']
+    if plan.get('seconds') is not None:
+        line += ' seconds=%.4f' % plan['seconds']
+    lines = [line]
+    for child in plan['sources']:
+        lines.append(format_plan(child, indent + 1))
+    return '\n'.join(lines)
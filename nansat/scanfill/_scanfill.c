@@ -0,0 +1,170 @@
+/******************************************************************************
+ *
+ * Project:  NANSAT
+ * Purpose:  Scanline fill of polygons (even-odd rule) with fractional
+ *           coverage of pixels. Used by nansat/landmask.py
+ *
+ ******************************************************************************
+ * This file is part of NANSAT. You can redistribute it or modify
+ * under the terms of GNU General Public License, v.3
+ * http://www.gnu.org/licenses/gpl-3.0.html
+ *****************************************************************************/
+
+#include <Python.h>
+#include <math.h>
+#include <stdlib.h>
+
+/* Edge of polygon in pixel/line coordinates, y0 < y1 */
+typedef struct {
+    double x0, y0, x1, y1;
+} Edge;
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/* Add coverage weight of span [xa, xb) to pixels of line acc[width] */
+static void add_span(float *acc, Py_ssize_t width, double xa, double xb, double weight)
+{
+    Py_ssize_t i, ia, ib;
+
+    if (xa < 0)
+        xa = 0;
+    if (xb > width)
+        xb = (double)width;
+    if (xa >= xb)
+        return;
+    ia = (Py_ssize_t)floor(xa);
+    ib = (Py_ssize_t)floor(xb);
+    if (ia == ib) {
+        acc[ia] += (float)((xb - xa) * weight);
+        return;
+    }
+    acc[ia] += (float)((ia + 1 - xa) * weight);
+    for (i = ia + 1; i < ib; i++)
+        acc[i] += (float)weight;
+    if (ib < width)
+        acc[ib] += (float)((xb - ib) * weight);
+}
+
+/* Fill lines row0..row1-1 into out[(row1 - row0) x width].
+ * Edges must be sorted by y0. Each line is sampled by <supersample> scanlines.
+ * active and xs are work arrays of n_edges elements. */
+static void fill_rows(const Edge *edges, Py_ssize_t n_edges, Py_ssize_t width,
+                      int supersample, int row0, int row1, float *out,
+                      Py_ssize_t *active, double *xs)
+{
+    Py_ssize_t next = 0, n_active = 0, n_xs, i, j;
+    int row, k;
+    double y, weight = 1. / supersample;
+    const Edge *e;
+
+    for (row = row0; row < row1; row++) {
+        for (k = 0; k < supersample; k++) {
+            y = row + (k + 0.5) * weight;
+            /* active edge table: add edges which start above the scanline,
+             * remove edges which end above it */
+            while (next < n_edges && edges[next].y0 <= y)
+                active[n_active++] = next++;
+            for (i = 0, j = 0; i < n_active; i++)
+                if (edges[active[i]].y1 > y)
+                    active[j++] = active[i];
+            n_active = j;
+
+            for (i = 0, n_xs = 0; i < n_active; i++) {
+                e = &edges[active[i]];
+                xs[n_xs++] = e->x0 + (y - e->y0) * (e->x1 - e->x0) / (e->y1 - e->y0);
+            }
+            qsort(xs, n_xs, sizeof(double), compare_doubles);
+            for (i = 0; i + 1 < n_xs; i += 2)
+                add_span(out + (Py_ssize_t)(row - row0) * width, width, xs[i], xs[i + 1], weight);
+        }
+    }
+}
+
+static char fill_docstring[] =
+    "fill(edges, n_edges, width, supersample, row0, row1, out)\n\n"
+    "Fill polygons with the even-odd rule and compute fractional coverage of pixels.\n"
+    "edges : float64 buffer of n_edges x (x0, y0, x1, y1) in pixel/line coordinates,\n"
+    "        y0 < y1, sorted by y0\n"
+    "supersample : number of scanlines per line (coverage along lines is exact)\n"
+    "row0, row1 : range of lines to fill\n"
+    "out : float32 buffer of (row1 - row0) x width, coverage is added to it\n"
+    "The GIL is released during computation.";
+
+static PyObject *fill(PyObject *self, PyObject *args)
+{
+    Py_buffer edges, out;
+    Py_ssize_t n_edges, width;
+    int supersample, row0, row1;
+    Py_ssize_t *active = NULL;
+    double *xs = NULL;
+    PyObject *result = NULL;
+
+    if (!PyArg_ParseTuple(args, "s*nniiiw*", &edges, &n_edges, &width, &supersample,
+                          &row0, &row1, &out))
+        return NULL;
+
+    if (n_edges < 0 || width < 1 || supersample < 1 || row0 > row1) {
+        PyErr_SetString(PyExc_ValueError, "Wrong number of edges, width, supersample or lines");
+        goto done;
+    }
+    if (edges.len < (Py_ssize_t)(n_edges * sizeof(Edge))) {
+        PyErr_SetString(PyExc_ValueError, "Edges buffer is smaller than n_edges x 4");
+        goto done;
+    }
+    if (out.len < (Py_ssize_t)((row1 - row0) * width * sizeof(float))) {
+        PyErr_SetString(PyExc_ValueError, "Output buffer is too small");
+        goto done;
+    }
+
+    active = (Py_ssize_t *)malloc((n_edges + 1) * sizeof(Py_ssize_t));
+    xs = (double *)malloc((n_edges + 1) * sizeof(double));
+    if (active == NULL || xs == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    fill_rows((const Edge *)edges.buf, n_edges, width, supersample, row0, row1,
+              (float *)out.buf, active, xs);
+    Py_END_ALLOW_THREADS
+
+    Py_INCREF(Py_None);
+    result = Py_None;
+
+done:
+    free(active);
+    free(xs);
+    PyBuffer_Release(&edges);
+    PyBuffer_Release(&out);
+    return result;
+}
+
+static PyMethodDef module_methods[] = {
+    {"fill", (PyCFunction)fill, METH_VARARGS, fill_docstring},
+    {NULL, NULL, 0, NULL}
+};
+
+#if PY_MAJOR_VERSION >= 3
+static struct PyModuleDef _scanfill =
+{
+    PyModuleDef_HEAD_INIT,
+    "_scanfill", /* name of module */
+    "Scanline fill of polygons", /* module documentation */
+    -1,
+    module_methods
+};
+
+PyMODINIT_FUNC PyInit__scanfill(void)
+{
+    return PyModule_Create(&_scanfill);
+}
+#else
+PyMODINIT_FUNC init_scanfill(void)
+{
+    Py_InitModule3("_scanfill", module_methods, "Scanline fill of polygons");
+}
+#endif
@@ -0,0 +1,538 @@
+# Name:    service.py
+# Purpose: Long-running Nansat worker with warm caches behind HTTP
+# Licence:
+# This file is part of NANSAT.
+# NANSAT is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3 of the License.
+# http://www.gnu.org/licenses/gpl-3.0.html
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+"""Nansat worker service
+
+The service keeps mappers imported and caches recently opened Nansat
+objects (with their VRT graphs), Domains (with parsed SRS) and reprojected
+Nansat objects (with warped VRTs), so that repeated requests to the same
+files do not pay for import, probing of mappers, parsing of metadata and
+building of VRTs.
+
+Requests are HTTP POST with JSON body to /read, /reproject, /quicklook and
+/export; GET /status returns statistics. Arrays are returned in NumPy .npy
+format, quicklooks as PNG. Exported files are written only into the output
+directory of the service. The service listens on a Unix socket (path) or on
+a TCP port of localhost.
+
+Examples
+--------
+Start the service:
+    python -m nansat.service --socket /tmp/nansat.sock --output-dir /data/exports
+
+Use it:
+>>> from nansat.service import Client
+>>> client = Client('/tmp/nansat.sock')
+>>> a = client.read('S1A_EW_GRDM.SAFE', 'sigma0_HH', window=(0, 0, 1000, 1000))
+>>> b = client.reproject('S1A_EW_GRDM.SAFE', 'sigma0_HH', srs=4326,
+...                      ext='-te 10 70 20 75 -ts 1000 500')
+>>> png = client.quicklook('S1A_EW_GRDM.SAFE', 'sigma0_HH', clim='hist')
+
+"""
+from __future__ import absolute_import, print_function, division
+import os
+import io
+import sys
+import json
+import socket
+import logging
+import argparse
+import tempfile
+import threading
+import contextlib
+from collections import OrderedDict
+
+try:
+    from http.server import BaseHTTPRequestHandler, HTTPServer
+    from socketserver import ThreadingMixIn, UnixStreamServer
+    import http.client as httplib
+except ImportError:
+    from BaseHTTPServer import BaseHTTPRequestHandler, HTTPServer
+    from SocketServer import ThreadingMixIn, UnixStreamServer
+    import httplib
+
+import numpy as np
+
+import nansat.nansat
+from nansat.nansat import Nansat
+from nansat.domain import Domain
+from nansat.memprofile import current_rss
+from nansat.exceptions import NansatServiceError, NansatServiceBusyError
+
+NPY_TYPE = 'application/x-npy'
+PNG_TYPE = 'image/png'
+JSON_TYPE = 'application/json'
+
+
+class LRUCache(object):
+    """Thread-safe cache keeping <size> recently used items, each with own lock"""
+
+    def __init__(self, size=16, on_evict=None):
+        """Create cache
+
+        Parameters
+        ----------
+        size : int
+            maximum number of items
+        on_evict : callable
+            on_evict(value, lock) is called for items removed from the cache
+
+        """
+        self.size = size
+        self.on_evict = on_evict
+        self.items = OrderedDict()
+        self.lock = threading.Lock()
+        self.hits = 0
+        self.misses = 0
+
+    def get(self, key, factory):
+        """Return (value, lock) for the key, create value with factory() if missing"""
+        with self.lock:
+            if key in self.items:
+                self.hits += 1
+                self.items[key] = self.items.pop(key)
+                return self.items[key]
+            self.misses += 1
+        # create outside of the cache lock (may take long)
+        item = (factory(), threading.Lock())
+        evicted = []
+        with self.lock:
+            if key in self.items:
+                # created by another thread meanwhile
+                evicted.append(self.items.pop(key))
+            self.items[key] = item
+            while len(self.items) > self.size:
+                evicted.append(self.items.popitem(last=False)[1])
+        if self.on_evict is not None:
+            for value, lock in evicted:
+                self.on_evict(value, lock)
+        return item
+
+    def stats(self):
+        return {'items': len(self.items), 'size': self.size,
+                'hits': self.hits, 'misses': self.misses}
+
+
+class Worker(object):
+    """Execute requests using cached Nansat objects with limits on concurrency and memory"""
+
+    def __init__(self, max_workers=4, max_memory=None, cache_size=16, queue_timeout=30.,
+                 output_dir=None):
+        """Create worker
+
+        Parameters
+        ----------
+        max_workers : int
+            maximum number of requests executed simultaneously
+        max_memory : int
+            maximum RSS (bytes). Requests which would exceed it are rejected
+        cache_size : int
+            number of cached Nansat objects (and reprojected Nansat objects)
+        queue_timeout : float
+            time to wait for a free worker before the request is rejected
+        output_dir : str
+            directory for files written by export requests. Export is
+            disabled if None
+
+        """
+        self.max_memory = max_memory
+        self.queue_timeout = queue_timeout
+        self.output_dir = output_dir
+        self.datasets = LRUCache(cache_size, self._close)
+        self.reprojected = LRUCache(cache_size, self._close)
+        self.domains = LRUCache(cache_size * 4)
+        self.slots = threading.BoundedSemaphore(max_workers)
+        self.reserved = 0
+        self.reserve_lock = threading.Lock()
+        self.requests = 0
+        self.rejected = 0
+        self.counter_lock = threading.Lock()
+        # keep mappers imported
+        if nansat.nansat.nansatMappers is None:
+            nansat.nansat.nansatMappers = nansat.nansat._import_mappers()
+
+    def handle(self, operation, request):
+        """Execute request and return (content_type, content)"""
+        handlers = {'read': self.read, 'reproject': self.reproject,
+                    'quicklook': self.quicklook, 'export': self.export}
+        if operation not in handlers:
+            raise NansatServiceError('Unknown operation %s' % operation, 404)
+        self._count('requests')
+        # bounded concurrency: wait for a free worker
+        if not self._acquire_slot():
+            self._count('rejected')
+            raise NansatServiceBusyError('All workers are busy')
+        try:
+            return handlers[operation](request)
+        finally:
+            self.slots.release()
+
+    def _count(self, counter):
+        """Increment request counter"""
+        with self.counter_lock:
+            setattr(self, counter, getattr(self, counter) + 1)
+
+    @staticmethod
+    def _close(n, lock):
+        """Close Nansat evicted from cache when requests using it are finished"""
+        with lock:
+            n.close()
+
+    def _acquire_slot(self):
+        if sys.version_info[0] < 3:
+            # no timeout in Python 2
+            return self.slots.acquire()
+        return self.slots.acquire(timeout=self.queue_timeout)
+
+    def _admit(self, n_bytes):
+        """Reserve memory for a request or raise NansatServiceBusyError"""
+        with self.reserve_lock:
+            rss = current_rss()
+            if (self.max_memory is not None and rss is not None and
+                    rss + self.reserved + n_bytes > self.max_memory):
+                self._count('rejected')
+                raise NansatServiceBusyError('Not enough memory for %d bytes' % n_bytes)
+            self.reserved += n_bytes
+
+    def _release(self, n_bytes):
+        with self.reserve_lock:
+            self.reserved -= n_bytes
+
+    def _open(self, request):
+        """Return cached (Nansat, lock)"""
+        kwargs = request.get('kwargs', {})
+        key = (request['filename'], request.get('mapper', ''),
+               json.dumps(kwargs, sort_keys=True))
+        return self.datasets.get(key, lambda: Nansat(request['filename'],
+                                                     mapper=request.get('mapper', ''),
+                                                     **kwargs))
+
+    def _domain(self, request):
+        """Return cached Domain"""
+        key = (str(request['srs']), request['ext'])
+        return self.domains.get(key, lambda: Domain(request['srs'], request['ext']))[0]
+
+    def _open_reprojected(self, request):
+        """Return cached (reprojected Nansat, lock)"""
+        kwargs = request.get('kwargs', {})
+        resample_alg = request.get('resample_alg', 0)
+        key = (request['filename'], request.get('mapper', ''),
+               json.dumps(kwargs, sort_keys=True), str(request['srs']), request['ext'],
+               resample_alg)
+
+        def factory():
+            n = Nansat(request['filename'], mapper=request.get('mapper', ''), **kwargs)
+            n.reproject(self._domain(request), resample_alg=resample_alg)
+            return n
+        return self.reprojected.get(key, factory)
+
+    @contextlib.contextmanager
+    def _using(self, opener, request):
+        """Yield cached Nansat from opener(request) locked for the request"""
+        while True:
+            n, lock = opener(request)
+            with lock:
+                # evicted and closed after it was taken from cache: open again
+                if n.vrt is None:
+                    continue
+                yield n
+                return
+
+    @contextlib.contextmanager
+    def _reserved(self, n_bytes):
+        """Reserve memory for the duration of the request"""
+        self._admit(n_bytes)
+        try:
+            yield
+        finally:
+            self._release(n_bytes)
+
+    def _read(self, opener, request):
+        """Read band (or window of band) from Nansat, return .npy content"""
+        band_id = request.get('band', 1)
+        window = request.get('window')
+        with self._using(opener, request) as n:
+            shape = n.shape()
+            if window is None:
+                n_bytes = shape[0] * shape[1] * 8
+            else:
+                n_bytes = window[2] * window[3] * 8
+            with self._reserved(n_bytes):
+                if window is None:
+                    array = n[band_id]
+                else:
+                    band = n.get_GDALRasterBand(band_id)
+                    array = band.ReadAsArray(*window)
+                    if array is None:
+                        raise ValueError('Cannot read window %s of band %s' % (
+                                         str(window), str(band_id)))
+                    # same expression, fill values and swathmask as n[band_id]
+                    array = n._finalize_band_data(
+                        band, array,
+                        lambda: n.get_GDALRasterBand('swathmask').ReadAsArray(*window))
+                buf = io.BytesIO()
+                np.save(buf, array)
+        return NPY_TYPE, buf.getvalue()
+
+    def read(self, request):
+        """Read band or window. Keys: filename, band, [mapper, window, kwargs]"""
+        return self._read(self._open, request)
+
+    def reproject(self, request):
+        """Read band reprojected onto Domain(srs, ext).
+        Keys: filename, band, srs, ext, [mapper, window, resample_alg, kwargs]"""
+        return self._read(self._open_reprojected, request)
+
+    def quicklook(self, request):
+        """Render PNG. Keys: filename, band, [mapper, srs, ext, clim, cmapName, kwargs]"""
+        if 'srs' in request:
+            opener = self._open_reprojected
+        else:
+            opener = self._open
+        fd, filename = tempfile.mkstemp(suffix='.png')
+        os.close(fd)
+        try:
+            with self._using(opener, request) as n:
+                shape = n.shape()
+                with self._reserved(shape[0] * shape[1] * 8):
+                    n.write_figure(filename, bands=request.get('band', 1),
+                                   clim=request.get('clim'),
+                                   cmapName=request.get('cmapName', 'jet'))
+            with open(filename, 'rb') as png:
+                return PNG_TYPE, png.read()
+        finally:
+            os.remove(filename)
+
+    def _output_path(self, output):
+        """Return absolute path of output file inside of output_dir"""
+        if self.output_dir is None:
+            raise NansatServiceError('Export is disabled (no output directory)', 403)
+        output_dir = os.path.realpath(self.output_dir)
+        path = os.path.realpath(os.path.join(output_dir, output))
+        if not path.startswith(output_dir + os.sep):
+            raise NansatServiceError('Output %s is outside of output directory' % output, 403)
+        return path
+
+    def export(self, request):
+        """Export into file in output_dir.
+        Keys: filename, output, [mapper, bands, driver, kwargs]"""
+        output = self._output_path(request['output'])
+        with self._using(self._open, request) as n:
+            shape = n.shape()
+            n_bands = len(request.get('bands') or n.bands())
+            with self._reserved(shape[0] * shape[1] * 8 * n_bands):
+                n.export(output, bands=request.get('bands'),
+                         driver=request.get('driver', 'netCDF'))
+        return JSON_TYPE, json.dumps({'output': output}).encode('utf-8')
+
+    def status(self):
+        """Return statistics of caches and requests"""
+        with self.counter_lock:
+            requests, rejected = self.requests, self.rejected
+        return {'requests': requests,
+                'rejected': rejected,
+                'reserved': self.reserved,
+                'rss': current_rss(),
+                'max_memory': self.max_memory,
+                'datasets': self.datasets.stats(),
+                'reprojected': self.reprojected.stats(),
+                'domains': self.domains.stats()}
+
+
+class RequestHandler(BaseHTTPRequestHandler):
+    """HTTP handler passing requests to server.worker"""
+
+    def address_string(self):
+        # client_address is empty for Unix sockets
+        if isinstance(self.client_address, tuple) and self.client_address:
+            return str(self.client_address[0])
+        return 'local'
+
+    def log_message(self, format, *args):
+        logging.getLogger('nansat.service').debug(format % args)
+
+    def _respond(self, status, content_type, content):
+        self.send_response(status)
+        self.send_header('Content-Type', content_type)
+        self.send_header('Content-Length', str(len(content)))
+        self.end_headers()
+        self.wfile.write(content)
+
+    def _respond_json(self, status, data):
+        self._respond(status, JSON_TYPE, json.dumps(data).encode('utf-8'))
+
+    def do_GET(self):
+        if self.path.strip('/') == 'status':
+            self._respond_json(200, self.server.worker.status())
+        else:
+            self._respond_json(404, {'error': 'Unknown path %s' % self.path})
+
+    def do_POST(self):
+        try:
+            length = int(self.headers.get('Content-Length', 0))
+            request = json.loads(self.rfile.read(length).decode('utf-8'))
+            content_type, content = self.server.worker.handle(self.path.strip('/'),
+                                                              request)
+        except NansatServiceError as e:
+            self._respond_json(e.status, {'error': str(e)})
+        except (KeyError, ValueError, TypeError, IOError) as e:
+            self._respond_json(400, {'error': '%s: %s' % (type(e).__name__, e)})
+        except Exception as e:
+            self._respond_json(500, {'error': '%s: %s' % (type(e).__name__, e)})
+        else:
+            self._respond(200, content_type, content)
+
+
+class ThreadingHTTPServer(ThreadingMixIn, HTTPServer):
+    daemon_threads = True
+
+
+class ThreadingUnixHTTPServer(ThreadingMixIn, UnixStreamServer):
+    daemon_threads = True
+
+
+def create_server(address, worker=None, **kwargs):
+    """Create HTTP server with Nansat worker
+
+    Parameters
+    ----------
+    address : str or (str, int)
+        path of Unix socket or (host, port). Port 0 selects a free port
+    worker : Worker
+        worker to use. If None, Worker(**kwargs) is created
+
+    Returns
+    -------
+    server : ThreadingHTTPServer or ThreadingUnixHTTPServer
+        call server.serve_forever() to start, server.shutdown() to stop
+
+    """
+    if isinstance(address, tuple):
+        server = ThreadingHTTPServer(address, RequestHandler)
+    else:
+        if os.path.exists(address):
+            os.remove(address)
+        server = ThreadingUnixHTTPServer(address, RequestHandler)
+    server.worker = worker or Worker(**kwargs)
+    return server
+
+
+class UnixHTTPConnection(httplib.HTTPConnection):
+    """HTTP connection over Unix socket"""
+
+    def __init__(self, socket_path, timeout=None):
+        httplib.HTTPConnection.__init__(self, 'localhost', timeout=timeout)
+        self.socket_path = socket_path
+
+    def connect(self):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        if self.timeout is not None:
+            self.sock.settimeout(self.timeout)
+        self.sock.connect(self.socket_path)
+
+
+class Client(object):
+    """Client of Nansat worker service"""
+
+    def __init__(self, address, timeout=600):
+        """Create client for service at address (Unix socket path or (host, port))"""
+        self.address = address
+        self.timeout = timeout
+
+    def _connection(self):
+        if isinstance(self.address, tuple):
+            return httplib.HTTPConnection(self.address[0], self.address[1],
+                                          timeout=self.timeout)
+        return UnixHTTPConnection(self.address, timeout=self.timeout)
+
+    def request(self, operation, **request):
+        """Send request and return array (read, reproject), bytes (quicklook) or dict"""
+        connection = self._connection()
+        try:
+            if operation == 'status':
+                connection.request('GET', '/status')
+            else:
+                connection.request('POST', '/' + operation,
+                                   json.dumps(request).encode('utf-8'),
+                                   {'Content-Type': JSON_TYPE})
+            response = connection.getresponse()
+            content = response.read()
+            content_type = response.getheader('Content-Type')
+        finally:
+            connection.close()
+        if response.status != 200:
+            message = json.loads(content.decode('utf-8'))['error']
+            if response.status == 503:
+                raise NansatServiceBusyError(message)
+            raise NansatServiceError(message, response.status)
+        if content_type == NPY_TYPE:
+            return np.load(io.BytesIO(content))
+        if content_type == JSON_TYPE:
+            return json.loads(content.decode('utf-8'))
+        return content
+
+    def read(self, filename, band=1, window=None, mapper='', **kwargs):
+        return self.request('read', filename=filename, band=band, window=window,
+                            mapper=mapper, kwargs=kwargs)
+
+    def reproject(self, filename, band=1, srs=None, ext=None, window=None,
+                  resample_alg=0, mapper='', **kwargs):
+        return self.request('reproject', filename=filename, band=band, srs=srs, ext=ext,
+                            window=window, resample_alg=resample_alg, mapper=mapper,
+                            kwargs=kwargs)
+
+    def quicklook(self, filename, band=1, clim=None, cmapName='jet', mapper='', **kwargs):
+        return self.request('quicklook', filename=filename, band=band, clim=clim,
+                            cmapName=cmapName, mapper=mapper, kwargs=kwargs)
+
+    def export(self, filename, output, bands=None, driver='netCDF', mapper='', **kwargs):
+        return self.request('export', filename=filename, output=output, bands=bands,
+                            driver=driver, mapper=mapper, kwargs=kwargs)
+
+    def status(self):
+        return self.request('status')
+
+
+def main(args=None):
+    parser = argparse.ArgumentParser(prog='nansat.service',
+                                     description='Nansat worker service')
+    parser.add_argument('--socket', default=None, help='path of Unix socket')
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=8765)
+    parser.add_argument('--workers', type=int, default=4,
+                        help='maximum number of simultaneous requests')
+    parser.add_argument('--max-memory', type=float, default=None,
+                        help='maximum memory (MB), larger requests are rejected')
+    parser.add_argument('--cache-size', type=int, default=16,
+                        help='number of cached Nansat objects')
+    parser.add_argument('--output-dir', default=None,
+                        help='directory for exported files (export is disabled if not set)')
+    options = parser.parse_args(args)
+
+    address = options.socket or (options.host, options.port)
+    max_memory = None
+    if options.max_memory is not None:
+        max_memory = int(options.max_memory * 1024 ** 2)
+    server = create_server(address, max_workers=options.workers, max_memory=max_memory,
+                           cache_size=options.cache_size, output_dir=options.output_dir)
+    print('Nansat service listening on %s' % str(address))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        server.server_close()
+        if options.socket:
+            os.remove(options.socket)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,218 @@
+# Name:    sharedmem.py
+# Purpose: Arrays in shared memory for handoff between processes
+# Licence:
+# This file is part of NANSAT.
+# NANSAT is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3 of the License.
+# http://www.gnu.org/licenses/gpl-3.0.html
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+"""Arrays in shared memory for handoff between processes (Python 3.8+)
+
+SharedArray is a numpy array in a block of multiprocessing.shared_memory.
+When pickled (e.g. returned from a worker of multiprocessing.Pool) only the
+name, shape and dtype of the block are sent, and the receiving process
+attaches to the same memory. Bands can be read directly into a SharedArray
+(Nansat.read_shared, Nansat.iter_blocks(out=...)), and VRT.from_array wraps
+a SharedArray without copying (on systems with /dev/shm).
+
+The process which creates a SharedArray owns it and should unlink() it when
+no process needs it any more. SharedBufferPool keeps named buffers and
+unlinks them all at close().
+
+Examples
+--------
+>>> from multiprocessing import Pool
+>>> def read(filename):
+...     return Nansat(filename).read_shared('sigma0_HH')
+>>> with Pool(4) as pool:
+...     arrays = pool.map(read, filenames)
+>>> for a in arrays:
+...     print(a.array.mean())
+...     a.unlink()
+
+"""
+from __future__ import absolute_import
+import os
+import sys
+import uuid
+import threading
+
+import numpy as np
+
+try:
+    from multiprocessing import shared_memory, resource_tracker
+except ImportError:
+    shared_memory = None
+
+# directory where POSIX shared memory blocks are visible as files
+SHM_DIR = '/dev/shm'
+
+
+_attach_lock = threading.Lock()
+
+
+def _attach(name):
+    """Attach to existing block without registering it in the resource tracker
+
+    Only the creator registers the block, so that the resource tracker
+    unlinks it if it is leaked, and the block is not unlinked when an
+    attached process exits.
+    """
+    if sys.version_info >= (3, 13):
+        return shared_memory.SharedMemory(name, track=False)
+    with _attach_lock:
+        register = resource_tracker.register
+        resource_tracker.register = lambda *args: None
+        try:
+            return shared_memory.SharedMemory(name)
+        finally:
+            resource_tracker.register = register
+
+
+def _check_available():
+    if shared_memory is None:
+        raise ImportError('multiprocessing.shared_memory is not available (Python 3.8+)')
+
+
+class SharedArray(object):
+    """Numpy array in a named block of shared memory"""
+
+    def __init__(self, shape, dtype=np.float32, name=None, create=True):
+        """Create new or attach to existing block of shared memory
+
+        Parameters
+        ----------
+        shape : tuple of int
+            shape of the array
+        dtype : numpy.dtype
+            data type of the array
+        name : str
+            name of the block. Unique name is generated if None and create is True
+        create : bool
+            create new block (and own it) or attach to existing block
+
+        """
+        _check_available()
+        self.shape = tuple(int(i) for i in shape)
+        self.dtype = np.dtype(dtype)
+        nbytes = int(np.prod(self.shape)) * self.dtype.itemsize
+        if create:
+            if name is None:
+                name = 'nansat_%s' % uuid.uuid4().hex[:16]
+            self.shm = shared_memory.SharedMemory(name, create=True, size=max(nbytes, 1))
+        else:
+            self.shm = _attach(name)
+        self.owner = create
+        self.array = np.ndarray(self.shape, self.dtype, buffer=self.shm.buf)
+
+    @classmethod
+    def attach(cls, name, shape, dtype):
+        """Attach to existing block of shared memory"""
+        return cls(shape, dtype, name, create=False)
+
+    @classmethod
+    def from_array(cls, array, name=None):
+        """Create new block of shared memory and copy array into it"""
+        shared = cls(array.shape, array.dtype, name)
+        shared.array[...] = array
+        return shared
+
+    @property
+    def name(self):
+        return self.shm.name
+
+    @property
+    def path(self):
+        """Name of file with the block, if shared memory is visible in the file system"""
+        path = os.path.join(SHM_DIR, self.name.lstrip('/'))
+        if os.path.exists(path):
+            return path
+        return None
+
+    def __reduce__(self):
+        """Only name, shape and dtype are pickled"""
+        return (SharedArray.attach, (self.name, self.shape, self.dtype.str))
+
+    def __repr__(self):
+        return 'SharedArray(%s, %s, %s)' % (self.name, self.shape, self.dtype)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+        if self.owner:
+            self.unlink()
+
+    def close(self):
+        """Detach from the block
+
+        If views of the array are still used, the block is detached when the
+        last view is deleted.
+        """
+        self.array = None
+        try:
+            self.shm.close()
+        except BufferError:
+            pass
+
+    def unlink(self):
+        """Destroy the block (when all processes have closed it)"""
+        self.shm.unlink()
+
+
+class SharedBufferPool(object):
+    """Named SharedArrays, created at first request and unlinked at close()"""
+
+    def __init__(self, prefix=None):
+        """Create empty pool
+
+        Parameters
+        ----------
+        prefix : str
+            prefix of names of the blocks. Unique prefix is generated if None
+
+        """
+        _check_available()
+        if prefix is None:
+            prefix = 'nansat_%d_%s' % (os.getpid(), uuid.uuid4().hex[:8])
+        self.prefix = prefix
+        self.buffers = {}
+
+    def get(self, key, shape, dtype=np.float32):
+        """Return SharedArray with given key, create it if missing or of other shape/dtype"""
+        shared = self.buffers.get(key)
+        if shared is not None and (shared.shape != tuple(shape) or
+                                   shared.dtype != np.dtype(dtype)):
+            self.release(key)
+            shared = None
+        if shared is None:
+            shared = SharedArray(shape, dtype, '%s_%s' % (self.prefix, key))
+            self.buffers[key] = shared
+        return shared
+
+    def release(self, key):
+        """Close and unlink buffer with given key"""
+        shared = self.buffers.pop(key)
+        shared.close()
+        shared.unlink()
+
+    def close(self):
+        """Close and unlink all buffers"""
+        for key in list(self.buffers):
+            self.release(key)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def __len__(self):
+        return len(self.buffers)
+
+    def __contains__(self, key):
+        return key in self.buffers
@@ -0,0 +1,45 @@
+import unittest
+
+import numpy as np
+
+from nansat.utils import gdal
+from nansat.mappers.gcps import get_swath_gcps, refine_cols
+
+
+class SwathGCPsTests(unittest.TestCase):
+    def setUp(self):
+        rows, cols = np.mgrid[0:100:1, 0:80:1]
+        across = (cols - 40.) / 40.
+        self.lon = 10 + 8 * np.tan(across * 1.2)
+        self.lat = 50 + rows * 0.01 + 3 * across ** 2
+        self.datasets = []
+        for array in [self.lon, self.lat]:
+            ds = gdal.GetDriverByName('MEM').Create('', 80, 100, 1,
+                                                    gdal.GDT_Float32)
+            ds.GetRasterBand(1).WriteArray(array)
+            self.datasets.append(ds)
+
+    def test_get_swath_gcps(self):
+        lon_band, lat_band = [ds.GetRasterBand(1) for ds in self.datasets]
+        gcps = get_swath_gcps(lon_band, lat_band, gcp_count=10,
+                              line_step=2, pixel_step=2)
+
+        self.assertEqual(len(gcps), 100)
+        self.assertEqual(gcps[11].GCPPixel, 16.5)
+        self.assertEqual(gcps[11].GCPLine, 20.5)
+        self.assertAlmostEqual(gcps[11].GCPX, self.lon[10, 8], 4)
+        self.assertAlmostEqual(gcps[11].GCPY, self.lat[10, 8], 4)
+
+    def test_get_swath_gcps_skips_invalid(self):
+        self.datasets[1].GetRasterBand(1).WriteArray(np.array([[-999.]]), 0, 0)
+        lon_band, lat_band = [ds.GetRasterBand(1) for ds in self.datasets]
+        gcps = get_swath_gcps(lon_band, lat_band, gcp_count=10)
+
+        self.assertEqual(len(gcps), 99)
+
+    def test_refine_cols(self):
+        cols = refine_cols(self.lon, self.lat, np.arange(0, 80, 8), 0.05)
+
+        self.assertEqual(cols[-1], 79)
+        # more columns are added near the edges than in the middle
+        self.assertGreater(np.sum(cols < 16), np.sum((cols >= 32) * (cols < 48)))
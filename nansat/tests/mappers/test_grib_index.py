@@ -0,0 +1,139 @@
+import os
+import glob
+import shutil
+import struct
+import tempfile
+import unittest
+
+from mock import patch
+
+from nansat.mappers.grib_index import GribIndex
+from nansat.exceptions import WrongMapperError
+
+
+def grib1_message(parameter, level_type, level, p1=0):
+    """GRIB1 message with PDS only (2014-05-01 06:00, hours)"""
+    pds = struct.pack('>3sBBBBBBBHBBBBBBBBBBBBB', b'\x00\x00\x1c', 2, 7, 81,
+                      3, 128, parameter, level_type, level,
+                      14, 5, 1, 6, 0, 1, p1, 0, 0, 0, 0, 0, 21)
+    pds += b'\x00' * (28 - len(pds))
+    length = 8 + len(pds) + 4
+    return (b'GRIB' + struct.pack('>I', length)[1:] + b'\x01' + pds +
+            b'7777')
+
+
+def grib2_message(fields):
+    """GRIB2 message with sections 1 and 4 (2014-05-01 06:00, hours)"""
+    sections = struct.pack('>IBHHBBBHBBBBBBB', 21, 1, 7, 0, 2, 1, 1,
+                           2014, 5, 1, 6, 0, 0, 0, 1)
+    for category, number, level_type, level, forecast_time in fields:
+        sections += struct.pack('>IBHHBBBBBHBBIBBIBBI', 34, 4, 0, 0,
+                                category, number, 2, 0, 96, 0, 0, 1,
+                                forecast_time, level_type, 0, level,
+                                255, 0, 0)
+    length = 16 + len(sections) + 4
+    return (b'GRIB\x00\x00\x00\x02' + struct.pack('>Q', length) + sections +
+            b'7777')
+
+
+class GribIndexTests(unittest.TestCase):
+    def setUp(self):
+        self.tmp_dir = tempfile.mkdtemp()
+        self.cachedir = os.path.join(self.tmp_dir, 'cache')
+        os.mkdir(self.cachedir)
+        self.grib1_filename = os.path.join(self.tmp_dir, 'hirlam.grb')
+        with open(self.grib1_filename, 'wb') as grib_file:
+            grib_file.write(grib1_message(1, 102, 0))
+            grib_file.write(grib1_message(33, 105, 10, 3))
+            grib_file.write(grib1_message(34, 105, 10, 3))
+        self.grib2_filename = os.path.join(self.tmp_dir, 'gfs.grib2')
+        with open(self.grib2_filename, 'wb') as grib_file:
+            grib_file.write(grib2_message([(0, 0, 103, 2, 3)]))
+            grib_file.write(grib2_message([(2, 2, 103, 10, 3),
+                                           (2, 3, 103, 10, 3)]))
+
+    def tearDown(self):
+        shutil.rmtree(self.tmp_dir)
+
+    def test_grib1(self):
+        grib_index = GribIndex(self.grib1_filename)
+        messages = grib_index.select('UGRD', 'HTGL', 10)
+
+        self.assertEqual(len(grib_index.messages), 3)
+        self.assertEqual(len(messages), 1)
+        self.assertEqual(messages[0]['offset'], 40)
+        self.assertEqual(messages[0]['band'], 1)
+        self.assertEqual(messages[0]['reference_time'], '2014-05-01T06:00:00')
+        self.assertEqual(messages[0]['valid_time'], '2014-05-01T09:00:00')
+        self.assertEqual(grib_index.select('PRES')[0]['level_type'], 'MSL')
+        self.assertEqual(grib_index.valid_times(),
+                         ['2014-05-01T06:00:00', '2014-05-01T09:00:00'])
+
+    def test_grib2(self):
+        grib_index = GribIndex(self.grib2_filename)
+        src = grib_index.band_source('VGRD', 'HTGL', 10, xSize=720)
+
+        self.assertEqual(len(grib_index.messages), 3)
+        self.assertEqual(grib_index.select('TMP', 'HTGL', 2)[0]['valid_time'],
+                         '2014-05-01T09:00:00')
+        self.assertEqual(src['SourceFilename'], '/vsisubfile/75_109,%s' %
+                         self.grib2_filename)
+        self.assertEqual(src['SourceBand'], 2)
+        self.assertEqual(src['xSize'], 720)
+
+    def test_band_source_not_found(self):
+        grib_index = GribIndex(self.grib2_filename)
+
+        with self.assertRaises(WrongMapperError):
+            grib_index.band_source('UGRD', 'HTGL', 100)
+
+    def test_not_grib(self):
+        with open(self.grib1_filename, 'wb') as grib_file:
+            grib_file.write(b'\x89HDF' * 1000)
+
+        with self.assertRaises(WrongMapperError):
+            GribIndex(self.grib1_filename)
+
+    def test_init_with_cachedir(self):
+        GribIndex(self.grib2_filename, self.cachedir)
+
+        self.assertEqual(len(glob.glob(os.path.join(self.cachedir,
+                                                    'gfs.grib2.*.index.json'))), 1)
+        with patch.object(GribIndex, '_create_index') as create_index:
+            grib_index = GribIndex(self.grib2_filename, self.cachedir)
+        self.assertFalse(create_index.called)
+        self.assertEqual(len(grib_index.messages), 3)
+
+    def test_cache_key_full_path(self):
+        # file with the same name in another directory has own inventory
+        other_dir = os.path.join(self.tmp_dir, 'other')
+        os.mkdir(other_dir)
+        other_filename = os.path.join(other_dir, 'gfs.grib2')
+        with open(other_filename, 'wb') as grib_file:
+            grib_file.write(grib2_message([(2, 2, 103, 10, 3)]))
+        GribIndex(self.grib2_filename, self.cachedir)
+
+        grib_index = GribIndex(other_filename, self.cachedir)
+
+        self.assertEqual(len(grib_index.messages), 1)
+        self.assertEqual(len(glob.glob(os.path.join(self.cachedir, '*.index.json'))), 2)
+
+    def test_field_source(self):
+        grib_index = GribIndex(self.grib2_filename)
+        src = grib_index.field_source(3, xSize=720)
+
+        self.assertEqual(src['SourceFilename'], '/vsisubfile/75_109,%s' %
+                         self.grib2_filename)
+        self.assertEqual(src['SourceBand'], 2)
+        self.assertEqual(src['xSize'], 720)
+        with self.assertRaises(WrongMapperError):
+            grib_index.field_source(4)
+
+    def test_first_dataset(self):
+        with patch('nansat.mappers.grib_index.gdal.Open') as gdal_open:
+            GribIndex(self.grib1_filename).first_dataset()
+            GribIndex(self.grib2_filename).first_dataset()
+
+        self.assertEqual([call[0][0] for call in gdal_open.call_args_list],
+                         ['/vsisubfile/0_40,%s' % self.grib1_filename,
+                          '/vsisubfile/0_75,%s' % self.grib2_filename])
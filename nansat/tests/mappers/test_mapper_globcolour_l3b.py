@@ -0,0 +1,80 @@
+import os
+import shutil
+import tempfile
+import tracemalloc
+import unittest
+
+import numpy as np
+from mock import patch
+from netCDF4 import Dataset
+
+from nansat.nansat import Nansat
+from nansat.utils import gdal
+from nansat.mappers.globcolour import BinnedGrid
+
+
+class GlobcolourL3BMapperTests(unittest.TestCase):
+    def setUp(self):
+        self.tmp_dir = tempfile.mkdtemp()
+        self.filename = os.path.join(self.tmp_dir,
+                                     'L3b_20020101__GLOB_4_AV-MER_CHL1_DAY_00.nc')
+        with Dataset(self.filename, 'w') as ds:
+            ds.title = 'GlobColour daily MERIS product'
+            ds.createDimension('bin', 2)
+            ds.createVariable('row', 'i4', ('bin',))[:] = [2160, 100]
+            ds.createVariable('col', 'i4', ('bin',))[:] = [101, 10]
+            var = ds.createVariable('CHL1_mean', 'f4', ('bin',))
+            var.long_name = 'Chlorophyll concentration'
+            var[:] = [5, 7]
+        self.pti = patch('nansat.mappers.mapper_globcolour_l3b.pti')
+        self.pti.start()
+
+    def tearDown(self):
+        self.pti.stop()
+        shutil.rmtree(self.tmp_dir)
+
+    @unittest.skipIf(int(gdal.VersionInfo()) < 3040000,
+                     'Arguments of pixel functions require GDAL >= 3.4')
+    def test_open_does_not_allocate_grid(self):
+        grid_bytes = BinnedGrid.ROWS * BinnedGrid.COLS * 4
+        tracemalloc.start()
+        try:
+            n = Nansat(self.filename, mapper='globcolour_l3b')
+            peak = tracemalloc.get_traced_memory()[1]
+        finally:
+            tracemalloc.stop()
+
+        self.assertEqual(n.shape(), (BinnedGrid.ROWS, BinnedGrid.COLS))
+        self.assertLess(peak, grid_bytes / 10)
+
+    def test_read_window(self):
+        n = Nansat(self.filename, mapper='globcolour_l3b')
+        chl_band = n.vrt.dataset.GetRasterBand(n.get_band_number({'original_name': 'CHL1_mean'}))
+        mask_band = n.vrt.dataset.GetRasterBand(n.get_band_number('mask'))
+
+        chl = chl_band.ReadAsArray(95, 2155, 10, 10)
+        mask = mask_band.ReadAsArray(95, 2155, 10, 10)
+
+        self.assertEqual(chl[5, 5], 5)
+        self.assertEqual(mask[5, 5], 64)
+        self.assertEqual(chl[0, 0], 0)
+        self.assertEqual(mask[0, 0], 1)
+        self.assertEqual(set(np.unique(chl)), set([0, 5]))
+
+    def test_read_latlon_grid(self):
+        lat = np.array([[10.] * 3, [-0.01] * 3, [-10.] * 3])
+        lon = np.array([[-175.8333, -175.8333, -100.]] * 3)
+        n = Nansat(self.filename, mapper='globcolour_l3b',
+                   latlonGrid=np.array([lat, lon]))
+
+        chl = n[n.get_band_number({'original_name': 'CHL1_mean'})]
+
+        self.assertEqual(chl.shape, (3, 3))
+        self.assertEqual(chl[1, 1], 5)
+        self.assertEqual(chl[1, 0], 5)
+        self.assertEqual(chl[0, 1], 0)
+        self.assertEqual(chl[1, 2], 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,118 @@
+import os
+import shutil
+import tempfile
+
+import numpy as np
+from mock import patch
+
+from nansat.utils import gdal
+from nansat.nansat import Nansat
+from nansat.domain import Domain
+from nansat.geolocation import Geolocation
+from nansat.nsr import NSR
+from nansat.vrt import VRT
+from nansat.tests.nansat_test_base import NansatTestBase
+
+
+class MosaicMapperTests(NansatTestBase):
+    def setUp(self):
+        super(MosaicMapperTests, self).setUp()
+        self.tmp_dir = tempfile.mkdtemp()
+
+    def tearDown(self):
+        super(MosaicMapperTests, self).tearDown()
+        shutil.rmtree(self.tmp_dir)
+
+    def split_file(self, filename, split_lines):
+        """Split file into two granules, return names of the granules"""
+        ds = gdal.Open(filename)
+        if split_lines:
+            windows = [[0, 0, ds.RasterXSize, 50],
+                       [0, 50, ds.RasterXSize, ds.RasterYSize - 50]]
+        else:
+            windows = [[0, 0, 60, ds.RasterYSize],
+                       [60, 0, ds.RasterXSize - 60, ds.RasterYSize]]
+        granule_files = []
+        for i, window in enumerate(windows):
+            granule_file = os.path.join(self.tmp_dir, 'granule_%d.tif' % i)
+            gdal.Translate(granule_file, ds, srcWin=window)
+            granule_files.append(granule_file)
+        return granule_files
+
+    def make_geolocation_granule(self, lat0, height, step):
+        """Granule with geolocation arrays subsampled by step"""
+        n = Nansat.from_domain(Domain(4326, '-te 0 0 20 %d -ts 20 %d' % (height, height)),
+                               np.zeros((height, 20), np.float32))
+        lon, lat = np.meshgrid(np.arange(0, 20, step, dtype=np.float32),
+                               lat0 + np.arange(0, height, step, dtype=np.float32))
+        n.vrt._add_geolocation(Geolocation(VRT.from_array(lon), VRT.from_array(lat),
+                                           line_step=step, pixel_step=step))
+        return n
+
+    def test_gridded(self):
+        self.split_file(self.test_file_stere, False)
+        n0 = Nansat(self.test_file_stere, mapper=self.default_mapper)
+        n = Nansat('mosaic:' + os.path.join(self.tmp_dir, 'granule_*.tif'),
+                   mosaic_mapper=self.default_mapper)
+
+        self.assertEqual(n.mapper, 'mosaic')
+        self.assertEqual(n.shape(), n0.shape())
+        self.assertEqual(n.vrt.dataset.GetGeoTransform(),
+                         n0.vrt.dataset.GetGeoTransform())
+        self.assertTrue(np.allclose(n[1], n0[1]))
+
+    def test_swath_gcps(self):
+        granule_files = self.split_file(self.test_file_gcps, True)
+        n0 = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        n = Nansat('mosaic:', mosaic_files=granule_files,
+                   mosaic_mapper=self.default_mapper)
+
+        self.assertEqual(n.shape(), n0.shape())
+        self.assertEqual(n.vrt.dataset.GetGCPCount(),
+                         sum(gdal.Open(f).GetGCPCount() for f in granule_files))
+        self.assertTrue(np.allclose(n[1], n0[1]))
+
+    def test_swath_gcps_different_projections(self):
+        granule_files = self.split_file(self.test_file_gcps, True)
+        n_ref = Nansat('mosaic:', mosaic_files=granule_files,
+                       mosaic_mapper=self.default_mapper)
+        # GCPs of the second granule in a different projection
+        ds = gdal.Open(granule_files[1], gdal.GA_Update)
+        gcps = ds.GetGCPs()
+        src_srs = NSR(ds.GetGCPProjection() or NSR().wkt)
+        x, y, z = VRT.transform_coordinates(src_srs,
+                                            ([g.GCPX for g in gcps], [g.GCPY for g in gcps]),
+                                            NSR(3857))
+        ds.SetGCPs([gdal.GCP(float(x[i]), float(y[i]), 0, g.GCPPixel, g.GCPLine)
+                    for i, g in enumerate(gcps)], NSR(3857).wkt)
+        ds = None
+
+        n = Nansat('mosaic:', mosaic_files=granule_files,
+                   mosaic_mapper=self.default_mapper)
+
+        ref_gcps = n_ref.vrt.dataset.GetGCPs()
+        mosaic_gcps = n.vrt.dataset.GetGCPs()
+        self.assertTrue(NSR(n.vrt.dataset.GetGCPProjection()).IsSame(src_srs))
+        self.assertEqual(len(mosaic_gcps), len(ref_gcps))
+        self.assertTrue(np.allclose([g.GCPX for g in mosaic_gcps], [g.GCPX for g in ref_gcps]))
+        self.assertTrue(np.allclose([g.GCPY for g in mosaic_gcps], [g.GCPY for g in ref_gcps]))
+        self.assertEqual([g.GCPLine for g in mosaic_gcps], [g.GCPLine for g in ref_gcps])
+
+    def test_swath_geolocation_step(self):
+        granules = [self.make_geolocation_granule(0, 10, 2),
+                    self.make_geolocation_granule(10, 6, 2)]
+        with patch('nansat.mappers.mapper_mosaic.Nansat', side_effect=granules):
+            n = Nansat('mosaic:', mosaic_files=['granule_0', 'granule_1'], mapper='mosaic')
+        geolocation = n.vrt.geolocation
+
+        self.assertEqual(n.shape(), (16, 20))
+        self.assertEqual(geolocation.data['LINE_STEP'], '2')
+        self.assertTrue(np.allclose(geolocation.y_vrt.dataset.ReadAsArray()[:, 0],
+                                    np.arange(0, 16, 2)))
+
+    def test_swath_geolocation_step_not_multiple(self):
+        granules = [self.make_geolocation_granule(0, 9, 2),
+                    self.make_geolocation_granule(9, 6, 2)]
+        with patch('nansat.mappers.mapper_mosaic.Nansat', side_effect=granules):
+            with self.assertRaises(ValueError):
+                Nansat('mosaic:', mosaic_files=['granule_0', 'granule_1'], mapper='mosaic')
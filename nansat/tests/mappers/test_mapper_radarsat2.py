@@ -0,0 +1,137 @@
+import os
+import shutil
+import tempfile
+import unittest
+
+import numpy as np
+
+from nansat.utils import gdal
+from nansat.vrt import VRT
+from nansat.mappers.mapper_radarsat2 import Mapper
+
+PRODUCT_XML = '''<?xml version="1.0" encoding="UTF-8"?>
+<product xmlns="http://www.rsi.ca/rs2/prod/xml/schemas">
+  <sourceAttributes>
+    <satellite>RADARSAT-2</satellite>
+  </sourceAttributes>
+  <imageGenerationParameters>
+    <generalProcessingInformation>
+      <productType>%(product_type)s</productType>
+    </generalProcessingInformation>
+  </imageGenerationParameters>
+  <imageAttributes>
+    <rasterAttributes>
+      <dataType>%(data_type)s</dataType>
+      <bitsPerSample>16</bitsPerSample>
+      <numberOfSamplesPerLine>%(xsize)d</numberOfSamplesPerLine>
+      <numberOfLines>%(ysize)d</numberOfLines>
+    </rasterAttributes>
+    <lookupTable incidenceAngleCorrection="Beta Nought">lutBeta.xml</lookupTable>
+    <lookupTable incidenceAngleCorrection="Sigma Nought">lutSigma.xml</lookupTable>
+    <fullResolutionImageData pole="HH">imagery_HH.tif</fullResolutionImageData>
+  </imageAttributes>
+</product>
+'''
+
+LUT_XML = '''<?xml version="1.0" encoding="UTF-8"?>
+<lut>
+  <offset>%s</offset>
+  <gains>%s</gains>
+</lut>
+'''
+
+
+class RadarSat2MapperTests(unittest.TestCase):
+    def setUp(self):
+        self.tmp_dir = tempfile.mkdtemp()
+        self.xsize, self.ysize = 7, 5
+        self.sigma_gains = np.linspace(400, 700, self.xsize).astype('float32')
+        self.beta_gains = np.linspace(300, 350, self.xsize).astype('float32')
+
+    def tearDown(self):
+        shutil.rmtree(self.tmp_dir)
+
+    def make_product(self, product_type, data_type, dn, offset):
+        """ Write minimal Radarsat-2 product readable by GDAL """
+        with open(os.path.join(self.tmp_dir, 'product.xml'), 'w') as f:
+            f.write(PRODUCT_XML % {'product_type': product_type,
+                                   'data_type': data_type,
+                                   'xsize': self.xsize,
+                                   'ysize': self.ysize})
+        for lut_name, gains in [('Sigma', self.sigma_gains),
+                                ('Beta', self.beta_gains)]:
+            with open(os.path.join(self.tmp_dir, 'lut%s.xml' % lut_name), 'w') as f:
+                f.write(LUT_XML % (offset, ' '.join(repr(float(g)) for g in gains)))
+        gdal_type = gdal.GDT_CInt16 if np.iscomplexobj(dn) else gdal.GDT_UInt16
+        ds = gdal.GetDriverByName('GTiff').Create(
+            os.path.join(self.tmp_dir, 'imagery_HH.tif'),
+            self.xsize, self.ysize, 1, gdal_type)
+        ds.GetRasterBand(1).WriteArray(dn)
+        ds = None
+
+    def calibrate(self, lut_name):
+        """ Read band calibrated with RSAT2Calibration pixel function """
+        raw_ds = gdal.Open(self.tmp_dir)
+        offset, gains = Mapper.read_lut(self.tmp_dir, 'lut%s.xml' % lut_name)
+        lut_vrt = VRT.from_array(gains.reshape(1, gains.size))
+        vrt = VRT.from_gdal_dataset(raw_ds)
+        src, dst = Mapper.lut_calibration(raw_ds.GetDescription(),
+                                          raw_ds.GetRasterBand(1),
+                                          lut_vrt, offset)
+        vrt.create_band(src, dst)
+        return vrt.dataset.GetRasterBand(1).ReadAsArray()
+
+    def gdal_calibrate(self, calib):
+        """ Read band calibrated by the Radarsat-2 driver of GDAL """
+        ds = gdal.Open('RADARSAT_2_CALIB:%s:%s' % (
+            calib, os.path.join(self.tmp_dir, 'product.xml')))
+        return np.abs(ds.GetRasterBand(1).ReadAsArray().astype('complex64'))
+
+    @unittest.skipIf(int(gdal.VersionInfo()) < 3040000,
+                     'Arguments of pixel functions require GDAL >= 3.4')
+    def test_calibration_detected(self):
+        dn = np.arange(self.xsize * self.ysize, dtype='uint16').reshape(
+            self.ysize, self.xsize) * 100
+        self.make_product('SGF', 'Magnitude Detected', dn, 50.0)
+
+        sigma0 = self.calibrate('Sigma')
+        beta0 = self.calibrate('Beta')
+
+        self.assertTrue(np.allclose(sigma0, self.gdal_calibrate('SIGMA0'), rtol=1e-5))
+        self.assertTrue(np.allclose(beta0, self.gdal_calibrate('BETA0'), rtol=1e-5))
+
+    def test_calibration_slc(self):
+        dn = ((np.arange(self.xsize * self.ysize) - 10) * 37 +
+              1j * (np.arange(self.xsize * self.ysize) + 5) * 21).reshape(
+                  self.ysize, self.xsize)
+        self.make_product('SLC', 'Complex', dn, 0.0)
+
+        sigma0 = self.calibrate('Sigma')
+
+        # GDAL calibrates SLC data to complex amplitude: |DN| / A
+        self.assertTrue(np.allclose(sigma0, self.gdal_calibrate('SIGMA0') ** 2,
+                                    rtol=1e-5))
+
+    def test_incidence_angle_slc(self):
+        dn = np.full((self.ysize, self.xsize), 100 + 50j)
+        self.make_product('SLC', 'Complex', dn, 0.0)
+
+        incidence = Mapper.lut_incidence_angle(self.beta_gains,
+                                               self.sigma_gains, True)
+        sigma0 = self.gdal_calibrate('SIGMA0') ** 2
+        beta0 = self.gdal_calibrate('BETA0') ** 2
+
+        self.assertTrue(np.allclose(incidence,
+                                    np.degrees(np.arcsin(sigma0 / beta0))[0],
+                                    atol=1e-3))
+
+    def test_incidence_angle_detected(self):
+        incidence = Mapper.lut_incidence_angle(self.beta_gains,
+                                               self.sigma_gains, False)
+
+        self.assertTrue(np.allclose(np.sin(np.radians(incidence)),
+                                    self.beta_gains / self.sigma_gains))
+
+
+if __name__ == "__main__":
+    unittest.main()
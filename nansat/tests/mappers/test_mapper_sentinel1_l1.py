@@ -0,0 +1,84 @@
+import unittest
+
+import numpy as np
+
+from nansat.utils import gdal
+from nansat.vrt import VRT
+from nansat.mappers.mapper_sentinel1_l1 import Mapper
+
+NOISE_XML = '''<noise>
+  <noiseRangeVectorList count="2">
+    <noiseRangeVector>
+      <line>0</line>
+      <pixel count="3">0 50 100</pixel>
+      <noiseRangeLut count="3">10 20 30</noiseRangeLut>
+    </noiseRangeVector>
+    <noiseRangeVector>
+      <line>100</line>
+      <pixel count="3">0 50 100</pixel>
+      <noiseRangeLut count="3">10 20 30</noiseRangeLut>
+    </noiseRangeVector>
+  </noiseRangeVectorList>
+  <noiseAzimuthVectorList count="1">
+    <noiseAzimuthVector>
+      <firstAzimuthLine>0</firstAzimuthLine>
+      <firstRangeSample>0</firstRangeSample>
+      <lastAzimuthLine>100</lastAzimuthLine>
+      <lastRangeSample>60</lastRangeSample>
+      <line count="2">0 100</line>
+      <noiseAzimuthLut count="2">1 3</noiseAzimuthLut>
+    </noiseAzimuthVector>
+  </noiseAzimuthVectorList>
+</noise>'''
+
+
+class Sentinel1L1MapperTests(unittest.TestCase):
+    def test_read_noise_range_azimuth(self):
+        data = Mapper.read_noise(Mapper.__new__(Mapper), NOISE_XML, '_HH')
+
+        # range noise is not changed, azimuth noise is applied only in its block
+        self.assertTrue(np.allclose(data['noise_HH'], [[10, 20, 30], [10, 20, 30]]))
+        self.assertTrue(np.allclose(data['noiseTotal_HH'], [[10, 20, 30], [30, 60, 30]]))
+
+    def test_read_noise_range_only(self):
+        xml = NOISE_XML.split('<noiseAzimuthVectorList')[0] + '</noise>'
+
+        data = Mapper.read_noise(Mapper.__new__(Mapper), xml, '_VV')
+
+        self.assertTrue(np.allclose(data['noiseTotal_VV'], data['noise_VV']))
+
+    def test_lut_source_interpolates_lut(self):
+        vrt = VRT.from_array(np.zeros((101, 101), np.float32))
+        pixel, line = np.meshgrid([0, 50, 100], [0, 100])
+        data = {'pixel': pixel, 'line': line,
+                'noise_HH': np.array([[10., 20., 30.], [10., 20., 30.]])}
+
+        src = Mapper.lut_source(vrt, data, 'noise_HH')
+        vrt.create_band(src, {'name': 'noise_HH'})
+        noise = vrt.dataset.GetRasterBand(2).ReadAsArray()
+
+        # the small VRT with LUT is kept, the LUT is not zoomed to full size
+        self.assertEqual(vrt.band_vrts['noise_HH'].dataset.RasterXSize, 3)
+        self.assertEqual(noise.shape, (101, 101))
+        self.assertAlmostEqual(noise[50, 0], 10, 3)
+        self.assertAlmostEqual(noise[50, 25], 15, 3)
+        self.assertAlmostEqual(noise[50, 50], 20, 3)
+        self.assertAlmostEqual(noise[50, 100], 30, 3)
+
+    @unittest.skipIf(int(gdal.VersionInfo()) < 3040000,
+                     'Arguments of pixel functions require GDAL >= 3.4')
+    def test_denoised_sigma0_floor(self):
+        dn = VRT.from_array(np.array([[10., 1.], [2., 3.]], np.float32))
+        cal = VRT.from_array(np.ones((2, 2), np.float32))
+        noise = VRT.from_array(np.array([[1., 2.], [1., 20.]], np.float32))
+        vrt = VRT.from_array(np.zeros((2, 2), np.float32))
+        src = [{'SourceFilename': v.filename, 'SourceBand': 1} for v in [dn, cal, noise]]
+
+        vrt.create_band(src, {'name': 'sigma0_HH_denoised',
+                              'PixelFunctionType': 'Sentinel1Denoising',
+                              'SourceTransferType': 'Float32',
+                              'dataType': gdal.GDT_Float32,
+                              'PixelFunctionArguments': {'floor': '0.001'}})
+        sigma0 = vrt.dataset.GetRasterBand(2).ReadAsArray()
+
+        self.assertTrue(np.allclose(sigma0, [[99, 0.001], [3, 0.001]]))
@@ -0,0 +1,58 @@
+import os
+import shutil
+import tarfile
+import tempfile
+import unittest
+
+from mock import patch
+
+from nansat.mappers.tar_index import TarIndex
+from nansat.exceptions import WrongMapperError
+
+
+class TarIndexTests(unittest.TestCase):
+    def setUp(self):
+        self.tmp_dir = tempfile.mkdtemp()
+        self.cachedir = os.path.join(self.tmp_dir, 'cache')
+        os.mkdir(self.cachedir)
+        band_filename = os.path.join(self.tmp_dir, 'LC08_B1.TIF')
+        with open(band_filename, 'w') as band_file:
+            band_file.write('band data')
+        self.tgz_filename = os.path.join(self.tmp_dir, 'LC08.tar.gz')
+        with tarfile.open(self.tgz_filename, 'w:gz') as tar_file:
+            tar_file.add(band_filename, 'LC08_B1.TIF')
+
+    def tearDown(self):
+        shutil.rmtree(self.tmp_dir)
+
+    def test_init_without_cachedir(self):
+        tar_index = TarIndex(self.tgz_filename)
+
+        self.assertEqual(tar_index.names(), ['LC08_B1.TIF'])
+        self.assertEqual(tar_index.vsi_filename('LC08_B1.TIF'),
+                         '/vsitar/%s/LC08_B1.TIF' % self.tgz_filename)
+
+    def test_init_with_cachedir(self):
+        tar_index = TarIndex(self.tgz_filename, self.cachedir)
+        offset, size = tar_index.members['LC08_B1.TIF']
+
+        self.assertEqual(tar_index.tar_filename,
+                         os.path.join(self.cachedir, 'LC08.tar'))
+        self.assertTrue(os.path.exists(tar_index.tar_filename + '.index.json'))
+        self.assertTrue(tar_index.vsi_filename('LC08_B1.TIF').startswith(
+                                                            '/vsisubfile/'))
+        with open(tar_index.tar_filename, 'rb') as tar_file:
+            tar_file.seek(offset)
+            self.assertEqual(tar_file.read(size), b'band data')
+
+    def test_init_reuses_index(self):
+        tar_index1 = TarIndex(self.tgz_filename, self.cachedir)
+        with patch.object(TarIndex, '_create_index') as create_index:
+            tar_index2 = TarIndex(self.tgz_filename, self.cachedir)
+
+        self.assertFalse(create_index.called)
+        self.assertEqual(tar_index1.members, tar_index2.members)
+
+    def test_init_not_tar(self):
+        with self.assertRaises(WrongMapperError):
+            TarIndex(os.path.join(self.tmp_dir, 'LC08_B1.TIF'))
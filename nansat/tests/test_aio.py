@@ -0,0 +1,71 @@
+#------------------------------------------------------------------------------
+# Name:         test_aio.py
+# Purpose:      Test asyncio facade of Nansat
+#
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+#------------------------------------------------------------------------------
+from __future__ import absolute_import
+import unittest
+import threading
+
+import numpy as np
+
+try:
+    import asyncio
+    from nansat import aio
+except (ImportError, SyntaxError):
+    aio = None
+
+from nansat.nansat import Nansat
+from nansat.domain import Domain
+from nansat.tests.nansat_test_base import NansatTestBase
+
+
+@unittest.skipIf(aio is None, 'Python 3.5+ is required')
+class AsyncNansatTest(NansatTestBase):
+    def setUp(self):
+        super(AsyncNansatTest, self).setUp()
+        self.loop = asyncio.new_event_loop()
+        asyncio.set_event_loop(self.loop)
+        self.executor = aio.Executor(max_workers=4, per_source=2)
+
+    def tearDown(self):
+        self.executor.shutdown()
+        self.loop.close()
+        super(AsyncNansatTest, self).tearDown()
+
+    def open(self):
+        return self.loop.run_until_complete(aio.AsyncNansat.open(
+            self.test_file_gcps, mapper=self.default_mapper, executor=self.executor))
+
+    def test_read(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        an = self.open()
+        a, b = self.loop.run_until_complete(asyncio.gather(
+            an.read(1, block_lines=7),
+            an.read_window('L_645', 10, 5, 20, 10)))
+
+        self.assertTrue(np.allclose(a, n[1]))
+        self.assertTrue(np.allclose(b, n[1][5:15, 10:30]))
+        self.assertEqual(self.executor.semaphores, {})
+
+    def test_reproject(self):
+        ext = '-te 27 70 30 72 -ts 50 40'
+        an = self.open()
+        self.loop.run_until_complete(an.reproject(Domain(4326, ext)))
+        a = self.loop.run_until_complete(an.read(1))
+
+        self.assertEqual(a.shape, (40, 50))
+
+    def test_read_cancelled(self):
+        an = self.open()
+        cancel = threading.Event()
+        cancel.set()
+        with self.assertRaises(asyncio.CancelledError):
+            an._read_window(1, 0, 0, None, None, 1, cancel)
+
+
+if __name__ == "__main__":
+    unittest.main()
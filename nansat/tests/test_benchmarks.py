@@ -0,0 +1,136 @@
+#------------------------------------------------------------------------------
+# Name:         test_benchmarks.py
+# Purpose:      Test comparison of benchmark results and synthetic fixtures
+#
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+#------------------------------------------------------------------------------
+from __future__ import absolute_import
+import os
+import json
+import shutil
+import tempfile
+import unittest
+
+from mock import patch
+from netCDF4 import Dataset
+
+from nansat_benchmarks import benchmark, fixtures
+
+
+def make_record(seconds, memory=None):
+    """Make record of results as returned by benchmark.run()"""
+    results = []
+    for (fixture, operation), value in sorted(seconds.items()):
+        result = {'fixture': fixture, 'size': 'small', 'operation': operation,
+                  'seconds': value}
+        if memory is not None:
+            result.update(memory[(fixture, operation)])
+        results.append(result)
+    return {'timestamp': '2020-01-01T00:00:00', 'results': results}
+
+
+class BenchmarkCompareTest(unittest.TestCase):
+    def setUp(self):
+        self.baseline = make_record({('model', 'open'): 0.5,
+                                     ('model', 'read'): 2.0,
+                                     ('swath', 'export'): 4.0})
+
+    def test_compare_no_regression(self):
+        record = make_record({('model', 'open'): 0.55,
+                              ('model', 'read'): 1.5,
+                              ('swath', 'export'): 4.1})
+
+        self.assertEqual(benchmark.compare(record, self.baseline), [])
+
+    def test_compare_regression(self):
+        record = make_record({('model', 'open'): 0.5,
+                              ('model', 'read'): 3.0,
+                              ('swath', 'export'): 4.0})
+
+        regressions = benchmark.compare(record, self.baseline)
+
+        self.assertEqual(len(regressions), 1)
+        self.assertEqual(regressions[0]['operation'], 'read')
+        self.assertEqual(regressions[0]['metric'], 'seconds')
+        self.assertAlmostEqual(regressions[0]['ratio'], 1.5)
+        self.assertEqual(benchmark.compare(record, self.baseline, threshold=2.0), [])
+
+    def test_compare_new_operation_and_small_values(self):
+        # operations missing in baseline are not compared, times below
+        # 1 ms are not reported even if the ratio is large
+        baseline = make_record({('model', 'open'): 1e-5})
+        record = make_record({('model', 'open'): 5e-4,
+                              ('model', 'figure'): 10.0})
+
+        self.assertEqual(benchmark.compare(record, baseline), [])
+
+    def test_compare_memory(self):
+        key = benchmark.MEMORY_KEYS[0]
+        baseline = make_record({('model', 'read'): 1.0},
+                               {('model', 'read'): {key: 100 * 2 ** 20}})
+        record = make_record({('model', 'read'): 1.0},
+                             {('model', 'read'): {key: 200 * 2 ** 20}})
+
+        regressions = benchmark.compare(record, baseline)
+
+        self.assertEqual([r['metric'] for r in regressions], [key])
+        self.assertAlmostEqual(regressions[0]['ratio'], 2.0)
+
+    def test_history(self):
+        tmp_dir = tempfile.mkdtemp()
+        try:
+            history = os.path.join(tmp_dir, 'history.jsonl')
+            benchmark.append_history(self.baseline, history)
+            benchmark.append_history(self.baseline, history)
+
+            records = benchmark.read_history(history)
+
+            self.assertEqual(len(records), 2)
+            self.assertEqual(records[1], json.loads(json.dumps(self.baseline)))
+        finally:
+            shutil.rmtree(tmp_dir)
+
+
+class BenchmarkFixturesTest(unittest.TestCase):
+    def setUp(self):
+        self.tmp_dir = tempfile.mkdtemp()
+        self.sizes = patch.dict(fixtures.SIZES, {'tiny': (60, 40)})
+        self.sizes.start()
+
+    def tearDown(self):
+        self.sizes.stop()
+        shutil.rmtree(self.tmp_dir)
+
+    def test_make_netcdf_cf_model(self):
+        filename = fixtures.make_netcdf_cf_model(self.tmp_dir, 'tiny', n_times=2)
+
+        with Dataset(filename) as ds:
+            self.assertEqual(ds.variables['x_wind_10m'].shape, (2, 40, 60))
+            self.assertEqual(ds.variables['air_temperature_2m'].standard_name,
+                             'air_temperature')
+
+    def test_make_swath_reproducible(self):
+        filename1 = fixtures.make_swath(self.tmp_dir, 'tiny')
+        with Dataset(filename1) as ds:
+            sst1 = ds.variables['sst'][:]
+        os.remove(filename1)
+        filename2 = fixtures.make_swath(self.tmp_dir, 'tiny')
+        with Dataset(filename2) as ds:
+            sst2 = ds.variables['sst'][:]
+            self.assertEqual(ds.variables['longitude'].shape, (40, 60))
+
+        self.assertTrue((sst1 == sst2).all())
+
+    def test_make_sentinel1_safe(self):
+        filename = fixtures.make_sentinel1_safe(self.tmp_dir, 'tiny', polarizations=['VV'])
+
+        self.assertTrue(os.path.exists(os.path.join(filename, 'manifest.safe')))
+        self.assertEqual(len(os.listdir(os.path.join(filename, 'measurement'))), 1)
+        self.assertEqual(len(os.listdir(os.path.join(filename, 'annotation',
+                                                     'calibration'))), 2)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,77 @@
+#------------------------------------------------------------------------------
+# Name:         test_distance.py
+# Purpose:      Test distance to the nearest land pixel
+#
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+#------------------------------------------------------------------------------
+from __future__ import absolute_import
+import unittest
+
+import numpy as np
+
+from nansat import distance
+from nansat.domain import Domain
+from nansat.nansat import Nansat
+from nansat.utils import haversine
+
+
+class DistanceTest(unittest.TestCase):
+    def setUp(self):
+        self.d = Domain(4326, "-te 10 70 10.8 70.6 -ts 80 60")
+        self.land = np.random.rand(60, 80) > 0.97
+        self.land[5, 5] = True
+
+    def test_envelope(self):
+        f = np.where(np.random.rand(5, 30) > 0.8, 0., np.inf)
+        f[2] = np.inf
+        f[3] = np.random.rand(30)
+        positions = np.cumsum(np.random.rand(5, 30) + 0.1, axis=1)
+        expected = np.array([[np.min(f[l] + (positions[l, q] - positions[l]) ** 2)
+                              for q in range(30)] for l in range(5)])
+        result = distance.envelope(f, positions)
+        edt_module = distance._edt
+        distance._edt = None
+        try:
+            result_python = distance.envelope(f, positions)
+        finally:
+            distance._edt = edt_module
+
+        self.assertTrue(np.allclose(result, expected))
+        self.assertTrue(np.allclose(result_python, expected))
+        self.assertTrue(np.all(np.isinf(result[2])))
+
+    def test_distance_to_land(self):
+        dist = distance.distance_to_land(self.d, self.land, threads=2, step=16, tile_lines=7)
+        result = dist['distance_to_coast']
+        rows, cols = np.nonzero(self.land)
+        lon_land, lat_land = self.d.transform_points(cols + 0.5, rows + 0.5)
+        rows, cols = np.indices(self.land.shape)
+        lon, lat = self.d.transform_points(cols.ravel() + 0.5, rows.ravel() + 0.5)
+        expected = np.array([haversine(lon0, lat0, lon_land, lat_land).min()
+                             for lon0, lat0 in zip(lon, lat)]).reshape(self.land.shape) / 1000.
+
+        self.assertEqual(result.shape, self.land.shape)
+        self.assertTrue(np.all(result[self.land] == 0))
+        self.assertTrue(np.allclose(result, expected, rtol=0.01, atol=0.02))
+
+    def test_distance_to_land_nansat_mask(self):
+        watermask = Nansat.from_domain(self.d, np.where(self.land, 0, 1).astype(np.uint8))
+        dist1 = distance.distance_to_land(self.d, watermask)
+        dist2 = distance.distance_to_land(self.d, self.land)
+
+        self.assertTrue(np.allclose(dist1[1], dist2[1]))
+
+    def test_distance_to_land_no_land(self):
+        dist = distance.distance_to_land(self.d, np.zeros((60, 80), bool))
+
+        self.assertTrue(np.all(np.isnan(dist[1])))
+
+    def test_distance_to_land_wrong_shape(self):
+        with self.assertRaises(ValueError):
+            distance.distance_to_land(self.d, np.zeros((10, 10), bool))
+
+
+if __name__ == "__main__":
+    unittest.main()
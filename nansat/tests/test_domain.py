@@ -493,6 +493,19 @@ class DomainTest(unittest.TestCase):
         d = Domain(4326, "-te -4 -5 +6 +7 -ts 3 2")
         self.assertTrue((d.azimuth_y()==np.array([[ 0.,  0.,  0.], [ 0.,  0.,  0.]])).all())
 
+    def test_rotation_angle(self):
+        d1 = Domain(4326, "-te 0 70 20 80 -ts 100 50")
+        d2 = Domain('+proj=stere +lat_0=90 +lon_0=0 +datum=WGS84',
+                    '-te 0 -2200000 800000 -1000000 -tr 10000 10000')
+        angle = d1.rotation_angle(d2, step=10)
+        rows, cols = (np.indices(angle.shape) + 0.5) * 10
+        lon, _ = d2.transform_points(cols.ravel(), rows.ravel())
+
+        self.assertEqual(angle.shape, (12, 8))
+        # X-axis of the stereographic grid is rotated clockwise by longitude
+        self.assertTrue(np.allclose(angle.ravel(), lon, atol=0.2))
+        self.assertTrue(np.allclose(d1.rotation_angle(d1, step=7), 0, atol=1e-6))
+
     def test_shape(self):
         d = Domain(4326, "-te 25 70 35 72 -ts 500 500")
         self.assertEqual(d.shape(), (500, 500))
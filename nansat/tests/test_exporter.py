@@ -151,6 +151,27 @@ class ExporterTest(NansatTestBase):
         earrWithNaN = exported['testBandWithNaN']
         np.testing.assert_allclose(arrWithNaN, earrWithNaN)
 
+    def test_export_prefetch(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        n.export(self.tmp_filename, prefetch=2, prefetch_memory=10**6)
+        exported = Nansat(self.tmp_filename, mapper=self.default_mapper)
+
+        self.assertTrue(np.allclose(n['L_645'], exported['L_645']))
+
+    def test_export_prefetch_writes_blocks(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        with patch('nansat.vrt.VRT.hardcopy_bands') as hardcopy_bands:
+            with patch('nansat.exporter.Exporter._write_blocks',
+                       wraps=exporter.Exporter._write_blocks) as write_blocks:
+                n.export(self.tmp_filename, prefetch=2)
+        exported = Nansat(self.tmp_filename, mapper=self.default_mapper)
+
+        self.assertFalse(hardcopy_bands.called)
+        self.assertTrue(write_blocks.called)
+        self.assertTrue(np.allclose(n['L_469'], exported['L_469']))
+        self.assertEqual(n.get_metadata(band_id='L_469', key='wavelength'),
+                         exported.get_metadata(band_id='L_469', key='wavelength'))
+
     def test_export_gcps_to_netcdf(self):
         """ Should export file with GCPs and write correct bands"""
         n0 = Nansat(self.test_file_gcps, log_level=40, mapper=self.default_mapper)
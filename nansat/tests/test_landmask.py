@@ -0,0 +1,104 @@
+#------------------------------------------------------------------------------
+# Name:         test_landmask.py
+# Purpose:      Test rasterization of vector coastline polygons
+#
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+#------------------------------------------------------------------------------
+from __future__ import absolute_import
+import os
+import unittest
+
+import numpy as np
+
+from nansat import landmask
+from nansat.domain import Domain
+from nansat.nansat import Nansat
+from nansat.utils import ogr, osr
+from nansat.tests.nansat_test_base import NansatTestBase
+
+
+class LandmaskTest(NansatTestBase):
+    def setUp(self):
+        super(LandmaskTest, self).setUp()
+        self.d = Domain(4326, "-te 10 70 10.8 70.6 -ts 80 60")
+        self.coastline = os.path.join(self.tmp_data_path, 'landmask_polygons.shp')
+        driver = ogr.GetDriverByName('ESRI Shapefile')
+        if os.path.exists(self.coastline):
+            driver.DeleteDataSource(self.coastline)
+        dataset = driver.CreateDataSource(self.coastline)
+        srs = osr.SpatialReference()
+        srs.ImportFromEPSG(4326)
+        layer = dataset.CreateLayer('land', srs, ogr.wkbPolygon)
+        layer.CreateField(ogr.FieldDefn('level', ogr.OFTInteger))
+        # island with a lake, and an island far outside of the domain
+        for wkt, level in [('POLYGON((10.2 70.1,10.6 70.1,10.6 70.4,10.2 70.4,10.2 70.1),'
+                            '(10.3 70.2,10.4 70.2,10.4 70.3,10.3 70.3,10.3 70.2))', 1),
+                           ('POLYGON((40 10,41 10,41 11,40 11,40 10))', 1),
+                           ('POLYGON((10.65 70.45,10.7 70.45,10.7 70.5,10.65 70.5,10.65 70.45))', 2)]:
+            feature = ogr.Feature(layer.GetLayerDefn())
+            feature.SetField('level', level)
+            feature.SetGeometry(ogr.CreateGeometryFromWkt(wkt))
+            layer.CreateFeature(feature)
+        dataset = None
+
+    def test_fill(self):
+        square = np.array([(2.25, 1.5), (7.75, 1.5), (7.75, 6.5), (2.25, 6.5), (2.25, 1.5)])
+        hole = np.array([(4, 3), (5, 3), (5, 4), (4, 4), (4, 3)])
+        edges = np.vstack([np.hstack([ring[:-1], ring[1:]]) for ring in [square, hole]])
+        coverage = landmask.fill(edges, 10, 9, supersample=4, threads=2, tile_lines=2)
+        scanfill_module = landmask._scanfill
+        landmask._scanfill = None
+        try:
+            coverage_numpy = landmask.fill(edges, 10, 9, supersample=4, tile_lines=3)
+        finally:
+            landmask._scanfill = scanfill_module
+
+        self.assertAlmostEqual(coverage.sum(), 5.5 * 5 - 1, 4)
+        self.assertTrue(np.allclose(coverage[3], [0, 0, 0.75, 1, 0, 1, 1, 0.75, 0, 0]))
+        self.assertTrue(np.allclose(coverage, coverage_numpy))
+
+    def test_landmask(self):
+        lm = landmask.landmask(self.d, self.coastline, threads=2)
+        mask = lm['landmask']
+
+        self.assertEqual(mask.shape, (60, 80))
+        self.assertEqual(mask.sum(), 40 * 30 - 10 * 10 + 5 * 5)
+        self.assertEqual(mask[25, 25], 1)
+        self.assertEqual(mask[35, 35], 0)
+
+    def test_landmask_coverage_where(self):
+        lf = landmask.landmask(self.d, self.coastline, where='level = 1', coverage=True)
+        fraction = lf['land_fraction']
+
+        self.assertAlmostEqual(fraction.sum(), 40 * 30 - 10 * 10, 0)
+        self.assertTrue(np.all((fraction >= 0) & (fraction <= 1)))
+
+    def test_landmask_stere(self):
+        d = Domain('+proj=stere +lat_0=90 +lon_0=10 +datum=WGS84',
+                   '-te -30000 -2260000 30000 -2200000 -tr 500 500')
+        mask = landmask.landmask(d, self.coastline, where='level = 1')[1]
+        lon, lat = d.get_geolocation_grids()
+        inside = (lon > 10.21) & (lon < 10.59) & (lat > 70.11) & (lat < 70.39)
+        inside &= ~((lon > 10.29) & (lon < 10.41) & (lat > 70.19) & (lat < 70.31))
+        outside = (lon < 10.19) | (lon > 10.61) | (lat < 70.09) | (lat > 70.41)
+
+        self.assertTrue(inside.any())
+        self.assertTrue(np.all(mask[inside] == 1))
+        self.assertTrue(np.all(mask[outside] == 0))
+
+    def test_watermask_coastline(self):
+        n = Nansat.from_domain(self.d, np.zeros((60, 80)))
+        wm = n.watermask(coastline=self.coastline)[1]
+
+        self.assertEqual(wm[25, 25], 0)
+        self.assertEqual(wm[5, 5], 1)
+
+    def test_landmask_wrong_file(self):
+        with self.assertRaises(IOError):
+            landmask.landmask(self.d, '/path/does/not/exist.shp')
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,72 @@
+#------------------------------------------------------------------------------
+# Name:         test_memprofile.py
+# Purpose:      Test memory profiling of Nansat operations
+#
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+#------------------------------------------------------------------------------
+from __future__ import absolute_import
+import unittest
+
+import numpy as np
+
+from nansat import memprofile
+from nansat.nansat import Nansat
+from nansat.tests.nansat_test_base import NansatTestBase
+
+
+class MemoryProfileTest(NansatTestBase):
+    def tearDown(self):
+        memprofile.stop()
+        super(MemoryProfileTest, self).tearDown()
+
+    def test_profile_array(self):
+        with memprofile.MemoryProfile('test', top=3) as profile:
+            a = np.ones((1000, 1000))
+
+        self.assertEqual(profile.record['operation'], 'test')
+        self.assertLessEqual(len(profile.record['top_sites']), 3)
+        if memprofile.tracemalloc is not None:
+            self.assertGreaterEqual(profile.record['numpy_bytes'], a.nbytes)
+            self.assertGreaterEqual(profile.record['traced_peak_delta'], a.nbytes)
+
+    def test_profile_nansat(self):
+        memprofile.start()
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        n[1]
+        records = memprofile.stop()
+
+        self.assertEqual([r['operation'] for r in records], ['open', 'read'])
+        self.assertIn('gdal_cache_peak', records[1])
+        self.assertIn('read', memprofile.format_report(records))
+        n[1]
+        self.assertEqual(memprofile.stop(), [])
+
+    @unittest.skipIf(memprofile.tracemalloc is None, 'tracemalloc is not available')
+    def test_stop_keeps_external_tracemalloc(self):
+        tracemalloc = memprofile.tracemalloc
+        tracemalloc.start()
+        try:
+            memprofile.start()
+            memprofile.stop()
+            self.assertTrue(tracemalloc.is_tracing())
+        finally:
+            tracemalloc.stop()
+
+        memprofile.start()
+        self.assertTrue(tracemalloc.is_tracing())
+        memprofile.stop()
+        self.assertFalse(tracemalloc.is_tracing())
+
+    def test_profile_deltas(self):
+        with memprofile.MemoryProfile('test') as profile:
+            pass
+
+        for key in ['gdal_cache_peak_delta', 'vsimem_peak_delta']:
+            self.assertIn(key, profile.record)
+            self.assertGreaterEqual(profile.record[key], 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -18,6 +18,9 @@ import logging
 import unittest
 import warnings
 import datetime
+import threading
+import time
+from collections import OrderedDict
 from mock import patch, PropertyMock, Mock, MagicMock, DEFAULT
 import numpy as np
 
@@ -33,6 +36,7 @@ else:
 
 from nansat import Nansat, Domain, NSR
 from nansat.utils import gdal
+from nansat.vrt import VRT
 import nansat.nansat
 
 from nansat.exceptions import NansatGDALError, WrongMapperError, NansatReadError
@@ -390,6 +394,67 @@ class NansatTest(NansatTestBase):
         self.assertTrue(np.isfinite(b[0, 0]))
         self.assertTrue(np.isfinite(b[100, 100]))
 
+    def test_get_vector_pairs(self):
+        d = Domain(4326, "-te 0 70 20 80 -ts 100 50")
+        n = Nansat.from_domain(d, np.ones((50, 100)), {'name': 'v', 'standard_name': 'y_wind'})
+        n.add_band(np.ones((50, 100)), {'name': 'u', 'standard_name': 'x_wind'})
+        n.add_band(np.ones((50, 100)), {'name': 'e', 'standard_name': 'eastward_wind'})
+
+        self.assertEqual(n.get_vector_pairs(), [(2, 1)])
+
+    def test_reproject_vector_pairs(self):
+        d1 = Domain(4326, "-te 0 70 20 80 -ts 100 50")
+        d2 = Domain('+proj=stere +lat_0=90 +lon_0=0 +datum=WGS84',
+                    '-te 0 -2200000 800000 -1000000 -tr 10000 10000')
+        n1 = Nansat.from_domain(d1, np.ones((50, 100), np.float32),
+                                {'name': 'u', 'standard_name': 'x_wind'})
+        n1.add_band(np.zeros((50, 100), np.float32), {'name': 'v', 'standard_name': 'y_wind'})
+        n2 = Nansat.from_domain(d1, n1['u'], {'name': 'u'})
+        n2.add_band(n1['v'], {'name': 'v'})
+        n1.reproject(d2, vector_pairs='auto', rotation_step=10)
+        n2.reproject(d2, vector_pairs=[('u', 'v')], rotation_step=10)
+        u, v = n1['u'], n1['v']
+        lon, _ = n1.get_geolocation_grids()
+        valid = np.isfinite(u) & np.isfinite(v)
+
+        self.assertTrue(valid.any())
+        self.assertTrue(np.allclose(np.hypot(u, v)[valid], 1, atol=1e-4))
+        # eastward vector has angle equal to longitude in the stereographic grid
+        self.assertTrue(np.allclose(np.degrees(np.arctan2(v, u))[valid], lon[valid], atol=1))
+        self.assertTrue(np.allclose(n2['v'][valid], v[valid]))
+
+    def test_reproject_vector_pairs_off(self):
+        d1 = Domain(4326, "-te 0 70 20 80 -ts 100 50")
+        d2 = Domain('+proj=stere +lat_0=90 +lon_0=0 +datum=WGS84',
+                    '-te 0 -2200000 800000 -1000000 -tr 10000 10000')
+        n = Nansat.from_domain(d1, np.ones((50, 100), np.float32),
+                               {'name': 'u', 'standard_name': 'x_wind'})
+        n.add_band(np.zeros((50, 100), np.float32), {'name': 'v', 'standard_name': 'y_wind'})
+        n.reproject(d2)
+        u = n['u']
+
+        self.assertTrue(np.allclose(u[np.isfinite(u)], 1))
+
+    def test_reproject_vector_pairs_metadata_undo(self):
+        d1 = Domain(4326, "-te 0 70 20 80 -ts 100 50")
+        d2 = Domain('+proj=stere +lat_0=90 +lon_0=0 +datum=WGS84',
+                    '-te 0 -2200000 800000 -1000000 -tr 10000 10000')
+        n = Nansat.from_domain(d1, np.ones((50, 100), np.float32),
+                               {'name': 'u', 'standard_name': 'x_wind'})
+        n.add_band(np.zeros((50, 100), np.float32), {'name': 'v', 'standard_name': 'y_wind'})
+        n.set_metadata('source_attribute', 'test value')
+        n.reproject(d2, vector_pairs='auto', rotation_step=10)
+
+        self.assertEqual(n.get_metadata('source_attribute'), 'test value')
+        self.assertEqual(n.shape(), d2.shape())
+
+        n.undo()
+        u, v = n['u'], n['v']
+
+        self.assertEqual(n.shape(), d1.shape())
+        self.assertTrue(np.allclose(u, 1))
+        self.assertTrue(np.allclose(v, 0))
+
     def test_reproject_stere(self):
         n1 = Nansat(self.test_file_gcps, log_level=40, mapper=self.default_mapper)
         n2 = Nansat(self.test_file_stere, log_level=40, mapper=self.default_mapper)
@@ -789,6 +854,105 @@ class NansatTest(NansatTestBase):
         self.assertEqual(type(n), Nansat)
         self.assertEqual(n.mapper, 'netcdf_cf')
 
+    def test_open_no_mapper_probe_threads(self):
+        n = Nansat(self.test_file_arctic, probe_threads=8)
+        self.assertEqual(type(n), Nansat)
+        self.assertEqual(n.mapper, 'netcdf_cf')
+
+    def test_probe_mappers_serial(self):
+        # mappers which are not thread-safe never run concurrently
+        state = {'active': 0, 'max_active': 0}
+        lock = threading.Lock()
+
+        def mapper(*args, **kwargs):
+            with lock:
+                state['active'] += 1
+                state['max_active'] = max(state['max_active'], state['active'])
+            time.sleep(0.05)
+            with lock:
+                state['active'] -= 1
+            raise WrongMapperError
+
+        mappers = OrderedDict(('mapper_%d' % i, type(str('Mapper'), (object,), {
+            'probe_thread_safe': False, '__new__': staticmethod(mapper)}))
+            for i in range(4))
+        with patch('nansat.nansat.nansatMappers', mappers):
+            n = Nansat(self.test_file_gcps, probe_threads=4)
+
+        self.assertEqual(n.mapper, 'gdal_bands')
+        self.assertEqual(state['max_active'], 1)
+
+    def test_probe_thread_safe(self):
+        mapper = type(str('Mapper'), (VRT,), {'__module__': 'nansat.vrt'})
+
+        self.assertFalse(nansat.nansat._probe_thread_safe(
+            nansat.nansat._import_mappers()['mapper_netcdf_cf']))
+        self.assertTrue(nansat.nansat._probe_thread_safe(mapper))
+
+    def test_io_stats(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        n.start_io_stats()
+        a = n['L_645']
+        n.export(self.tmp_filename)
+        records = n.stop_io_stats()
+
+        self.assertEqual(records[0]['operation'], 'read')
+        self.assertEqual(records[-1]['operation'], 'export')
+        self.assertEqual(records[0]['band'], n.get_band_number('L_645'))
+        self.assertEqual(list(records[0]['source_files']), [self.test_file_gcps])
+        self.assertEqual(records[0]['source_files'][self.test_file_gcps]['references'], 1)
+        self.assertIn('cache_used_delta', records[0])
+        self.assertIsNone(n.io_records)
+        n[1]
+        self.assertEqual(n.stop_io_stats(), [])
+
+    def test_iter_blocks(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        blocks = list(n.iter_blocks([1, 'L_469'], block_lines=30, prefetch_depth=2))
+
+        self.assertEqual([b[0] for b in blocks], list(range(0, n.shape()[0], 30)))
+        self.assertTrue(np.allclose(np.vstack([b[1][0] for b in blocks]), n[1]))
+        self.assertTrue(np.allclose(np.vstack([b[1][1] for b in blocks]), n['L_469']))
+
+    def test_iter_blocks_read_error(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        dataset = MagicMock()
+        dataset.GetRasterBand.return_value.ReadAsArray.return_value = None
+        with patch('nansat.prefetch.thread_dataset', return_value=dataset):
+            with self.assertRaises(IOError):
+                list(n.iter_blocks([1], block_lines=30, prefetch_depth=0))
+
+    def test_close(self):
+        with Nansat(self.test_file_gcps, mapper=self.default_mapper) as n:
+            n.reproject(Domain(4326, '-te 27 70 30 72 -ts 50 40'))
+            a = n[1]
+            filenames = [n.vrt.filename, n.vrt.vrt.filename]
+
+        self.assertEqual(a.shape, (40, 50))
+        self.assertIsNone(n.vrt)
+        self.assertTrue(all(gdal.VSIStatL(f) is None for f in filenames))
+
+    def test_explain(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        plan = n.explain('L_645', window=(0, 0, 10, 5), measure=True, do_print=False)
+
+        self.assertEqual(plan['type'], 'VRTDataset')
+        self.assertEqual(plan['window'], (0, 0, 10, 5))
+        self.assertEqual(plan['sources'][0]['type'], 'file')
+        self.assertEqual(plan['sources'][0]['filename'], self.test_file_gcps)
+        self.assertEqual(plan['sources'][0]['bytes'], 50 * gdal.GetDataTypeSize(
+            gdal.Open(self.test_file_gcps).GetRasterBand(1).DataType) // 8)
+        self.assertIn('seconds', plan)
+
+    def test_explain_reprojected(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        n.reproject(Domain(4326, '-te 27 70 30 72 -ts 50 40'))
+        plan = n.explain(1, do_print=False)
+
+        self.assertEqual(plan['type'], 'VRTWarpedDataset')
+        self.assertEqual(plan['size'], (50, 40))
+        self.assertEqual(plan['sources'][0]['source_type'], 'GDALWarpOptions')
+
     @patch.multiple(Nansat, vrt=DEFAULT, __init__ = Mock(return_value=None))
     def test_get_metadata_unescape(self, vrt):
         meta0 = {"key1": "&quot; AAA &quot; &amp; &gt; &lt;", "key2": "'BBB'"}
@@ -0,0 +1,144 @@
+#------------------------------------------------------------------------------
+# Name:         test_service.py
+# Purpose:      Test the Nansat worker service
+#
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+#------------------------------------------------------------------------------
+from __future__ import absolute_import
+import os
+import shutil
+import tempfile
+import unittest
+import threading
+
+from mock import patch
+
+import numpy as np
+
+from nansat.nansat import Nansat
+from nansat.domain import Domain
+from nansat.service import Client, Worker, LRUCache, create_server
+from nansat.exceptions import NansatServiceError, NansatServiceBusyError
+from nansat.tests.nansat_test_base import NansatTestBase
+
+
+class ServiceTest(NansatTestBase):
+    def setUp(self):
+        super(ServiceTest, self).setUp()
+        self.output_dir = tempfile.mkdtemp()
+        self.worker = Worker(max_workers=2, output_dir=self.output_dir)
+        self.server = create_server(('127.0.0.1', 0), self.worker)
+        self.thread = threading.Thread(target=self.server.serve_forever)
+        self.thread.daemon = True
+        self.thread.start()
+        self.client = Client(self.server.server_address)
+
+    def tearDown(self):
+        self.server.shutdown()
+        self.server.server_close()
+        shutil.rmtree(self.output_dir)
+        super(ServiceTest, self).tearDown()
+
+    def test_read(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        a = self.client.read(self.test_file_gcps, 1, mapper=self.default_mapper)
+        b = self.client.read(self.test_file_gcps, 1, window=(10, 5, 20, 10),
+                             mapper=self.default_mapper)
+
+        self.assertTrue(np.allclose(a, n[1]))
+        self.assertTrue(np.allclose(b, n[1][5:15, 10:30]))
+        self.assertEqual(self.client.status()['datasets']['hits'], 1)
+        self.assertEqual(self.client.status()['requests'], 2)
+
+    def test_read_window_finalized(self):
+        # window is processed as full band (expression, fill values, swathmask)
+        with patch.object(Nansat, '_finalize_band_data', autospec=True,
+                          side_effect=Nansat._finalize_band_data) as finalize:
+            self.client.read(self.test_file_gcps, 1, window=(10, 5, 20, 10),
+                             mapper=self.default_mapper)
+
+        self.assertEqual(finalize.call_count, 1)
+        self.assertEqual(finalize.call_args[0][2].shape, (10, 20))
+
+    def test_cache_eviction_closes(self):
+        evicted = []
+        cache = LRUCache(1, lambda value, lock: evicted.append(value))
+        cache.get('a', lambda: 'A')
+        cache.get('b', lambda: 'B')
+
+        self.assertEqual(evicted, ['A'])
+
+        worker = Worker(cache_size=1)
+        worker.read({'filename': self.test_file_gcps, 'mapper': self.default_mapper})
+        n = list(worker.datasets.items.values())[0][0]
+        worker.read({'filename': self.test_file_stere, 'mapper': self.default_mapper})
+
+        self.assertIsNone(n.vrt)
+
+    def test_reproject(self):
+        ext = '-te 27 70 30 72 -ts 50 40'
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        n.reproject(Domain(4326, ext))
+        a = self.client.reproject(self.test_file_gcps, 1, srs=4326, ext=ext,
+                                  mapper=self.default_mapper)
+
+        self.assertEqual(a.shape, (40, 50))
+        self.assertTrue(np.allclose(a, n[1], equal_nan=True))
+
+    def test_quicklook(self):
+        png = self.client.quicklook(self.test_file_gcps, 1, mapper=self.default_mapper)
+
+        self.assertTrue(png.startswith(b'\x89PNG'))
+
+    def test_errors(self):
+        with self.assertRaises(NansatServiceError) as e:
+            self.client.request('unknown')
+        self.assertEqual(e.exception.status, 404)
+
+        with self.assertRaises(NansatServiceError) as e:
+            # filename is missing
+            self.client.request('read', band=1)
+        self.assertEqual(e.exception.status, 400)
+
+        self.worker.max_memory = 1
+        with self.assertRaises(NansatServiceBusyError):
+            self.client.read(self.test_file_gcps, 1, mapper=self.default_mapper)
+
+    def test_export(self):
+        result = self.client.export(self.test_file_gcps, 'exported.nc', bands=[1],
+                                    mapper=self.default_mapper)
+
+        self.assertEqual(result['output'],
+                         os.path.join(os.path.realpath(self.output_dir), 'exported.nc'))
+        self.assertTrue(os.path.exists(result['output']))
+
+        for output in ['../exported.nc', '/tmp/exported.nc']:
+            with self.assertRaises(NansatServiceError) as e:
+                self.client.export(self.test_file_gcps, output, mapper=self.default_mapper)
+            self.assertEqual(e.exception.status, 403)
+
+        self.worker.output_dir = None
+        with self.assertRaises(NansatServiceError) as e:
+            self.client.export(self.test_file_gcps, 'exported.nc', mapper=self.default_mapper)
+        self.assertEqual(e.exception.status, 403)
+
+    def test_unix_socket(self):
+        socket_path = os.path.join(self.tmp_data_path, 'test_service.sock')
+        server = create_server(socket_path, self.worker)
+        thread = threading.Thread(target=server.serve_forever)
+        thread.daemon = True
+        thread.start()
+        try:
+            a = Client(socket_path).read(self.test_file_gcps, 1, mapper=self.default_mapper)
+        finally:
+            server.shutdown()
+            server.server_close()
+            os.remove(socket_path)
+
+        self.assertEqual(a.shape, Nansat(self.test_file_gcps, mapper=self.default_mapper).shape())
+
+
+if __name__ == "__main__":
+    unittest.main()
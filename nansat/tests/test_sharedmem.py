@@ -0,0 +1,104 @@
+#------------------------------------------------------------------------------
+# Name:         test_sharedmem.py
+# Purpose:      Test arrays in shared memory
+#
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+#------------------------------------------------------------------------------
+from __future__ import absolute_import
+import pickle
+import unittest
+import multiprocessing
+
+import numpy as np
+
+from nansat import sharedmem
+from nansat.nansat import Nansat
+from nansat.vrt import VRT
+from nansat.tests.nansat_test_base import NansatTestBase
+
+
+def read_shared(filename, mapper):
+    return Nansat(filename, mapper=mapper).read_shared(1)
+
+
+@unittest.skipIf(sharedmem.shared_memory is None, 'Python 3.8+ is required')
+class SharedMemTest(NansatTestBase):
+    def test_shared_array_pickle(self):
+        with sharedmem.SharedArray((10, 20), np.float32) as shared:
+            shared.array[:] = 3
+            attached = pickle.loads(pickle.dumps(shared))
+            attached.array[0, 0] = 5
+
+            self.assertFalse(attached.owner)
+            self.assertEqual(attached.name, shared.name)
+            self.assertEqual(shared.array[0, 0], 5)
+            self.assertEqual(shared.array[1, 1], 3)
+            attached.close()
+
+    def test_pool(self):
+        with sharedmem.SharedBufferPool() as pool:
+            a = pool.get('a', (10, 20), np.float32)
+            self.assertIs(pool.get('a', (10, 20), np.float32), a)
+            b = pool.get('a', (5, 5), np.uint8)
+            self.assertEqual(b.shape, (5, 5))
+            self.assertEqual(len(pool), 1)
+        self.assertEqual(len(pool), 0)
+
+    def test_read_shared(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        shared = n.read_shared('L_469')
+        try:
+            self.assertTrue(np.allclose(shared.array, n['L_469']))
+        finally:
+            shared.close()
+            shared.unlink()
+
+    def test_read_shared_process(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        pool = multiprocessing.Pool(1)
+        try:
+            shared = pool.apply(read_shared, (self.test_file_gcps, self.default_mapper))
+        finally:
+            pool.close()
+            pool.join()
+        try:
+            self.assertTrue(np.allclose(shared.array, n[1]))
+        finally:
+            shared.close()
+            shared.unlink()
+
+    def test_from_array_shared(self):
+        with sharedmem.SharedArray((10, 20), np.float32) as shared:
+            shared.array[:] = np.random.randn(10, 20)
+            vrt = VRT.from_array(shared)
+            a = vrt.dataset.ReadAsArray()
+
+            self.assertTrue(np.allclose(a, shared.array))
+            if shared.path is not None:
+                self.assertFalse(VRT.read_vsi(vrt.filename).find(shared.path) < 0)
+            vrt = None
+
+    def test_iter_blocks_out(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        with sharedmem.SharedBufferPool() as pool:
+            out = [pool.get(i, n.shape(), np.float32) for i in range(2)]
+            for y_offset, blocks in n.iter_blocks([1, 'L_469'], block_lines=7, out=out):
+                pass
+
+            self.assertTrue(np.allclose(out[0].array, n[1]))
+            self.assertTrue(np.allclose(out[1].array, n['L_469']))
+
+    def test_export_staging_pool(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        with sharedmem.SharedBufferPool() as pool:
+            n.export(self.tmp_filename, bands=[1], add_geolocation=False, staging_pool=pool)
+
+            self.assertIn('band1', pool)
+        n2 = Nansat(self.tmp_filename, mapper=self.default_mapper)
+        self.assertTrue(np.allclose(n2[1], n[1]))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,75 @@
+#------------------------------------------------------------------------------
+# Name:         test_texture.py
+# Purpose:      Test GLCM texture features
+#
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+#------------------------------------------------------------------------------
+from __future__ import absolute_import
+import unittest
+
+import numpy as np
+
+from nansat import texture
+from nansat.nansat import Nansat
+from nansat.tests.nansat_test_base import NansatTestBase
+
+
+class TextureTest(NansatTestBase):
+    def test_quantize(self):
+        image = texture.quantize(np.array([0, 0.5, 1, 2, np.nan]), levels=4, limits=(0, 1))
+
+        self.assertEqual(image.dtype, np.uint8)
+        self.assertEqual(list(image), [0, 2, 3, 3, texture.INVALID])
+
+    def test_matrix_features(self):
+        counts = np.array([[2., 1.], [1., 0.]])
+        features = dict(zip(texture.FEATURES, texture.matrix_features(counts)))
+
+        self.assertAlmostEqual(features['contrast'], 0.5)
+        self.assertAlmostEqual(features['homogeneity'], 0.75)
+        self.assertAlmostEqual(features['ASM'], 0.375)
+        self.assertAlmostEqual(features['mean'], 0.25)
+
+    @unittest.skipIf(texture._glcm is None, 'nansat._glcm is not compiled')
+    def test_compute_features_incremental(self):
+        image = np.random.randint(0, 8, (40, 50)).astype(np.uint8)
+        image[10:12, 5:30] = texture.INVALID
+        offsets = texture.get_offsets(2, (0, 45, 90, 135))
+        result = texture.compute_features(image, 8, 9, 3, offsets, 0, 11)
+        glcm_module = texture._glcm
+        texture._glcm = None
+        try:
+            expected = texture.compute_features(image, 8, 9, 3, offsets, 0, 11)
+        finally:
+            texture._glcm = glcm_module
+
+        self.assertTrue(np.allclose(result, expected, rtol=1e-4, atol=1e-5, equal_nan=True))
+
+    def test_glcm(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        t = texture.glcm(n, 'L_469', window=8, step=4, distances=[1, 2], levels=16,
+                         features=['contrast', 'entropy'], threads=2, tile_rows=3,
+                         block_lines=7)
+        height, width = n.shape()
+
+        self.assertEqual(t.shape(), ((height - 8) // 4 + 1, (width - 8) // 4 + 1))
+        self.assertEqual([b['name'] for b in t.bands().values()],
+                         ['L_469_contrast_1', 'L_469_entropy_1',
+                          'L_469_contrast_2', 'L_469_entropy_2'])
+        self.assertTrue(np.isfinite(t['L_469_contrast_1']).any())
+        # center of window (0, 0) in the input is the center of the first pixel
+        lon0, lat0 = n.transform_points([4], [4])
+        lon1, lat1 = t.transform_points([0.5], [0.5])
+        self.assertAlmostEqual(lon0[0], lon1[0], 3)
+        self.assertAlmostEqual(lat0[0], lat1[0], 3)
+
+    def test_glcm_wrong_feature(self):
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        with self.assertRaises(ValueError):
+            texture.glcm(n, 1, features=['unknown'])
+
+
+if __name__ == "__main__":
+    unittest.main()
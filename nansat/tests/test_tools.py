@@ -71,6 +71,15 @@ class ToolsTest(unittest.TestCase):
         result = distance2coast(self.d)
         self.assertEqual(type(result), NANSAT)
 
+    def test_distance2coast_watermask(self):
+        watermask = np.ones((100, 100), np.uint8)
+        watermask[50:, :20] = 0
+        result = distance2coast(self.d, watermask=watermask)
+
+        self.assertEqual(type(result), NANSAT)
+        self.assertTrue(np.all(result[1][50:, :20] == 0))
+        self.assertTrue(np.all(result[1][:50] > 0))
+
     def test_warning(self):
         register_colormaps()
         with self.assertWarns(UserWarning) as w:
@@ -0,0 +1,71 @@
+#------------------------------------------------------------------------------
+# Name:         test_tracing.py
+# Purpose:      Test tracing of Nansat operations
+#
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+#------------------------------------------------------------------------------
+from __future__ import absolute_import
+import os
+import json
+import unittest
+
+from nansat import tracing
+from nansat.nansat import Nansat
+from nansat.tests.nansat_test_base import NansatTestBase
+
+
+class TracingTest(NansatTestBase):
+    def tearDown(self):
+        tracing.stop()
+        super(TracingTest, self).tearDown()
+
+    def test_disabled(self):
+        @tracing.traced('func', lambda x: {'x': x})
+        def func(x):
+            return x + 1
+
+        self.assertFalse(tracing.is_enabled())
+        self.assertEqual(func(1), 2)
+        with tracing.span('span', a=1) as s:
+            s.set(b=2)
+        self.assertEqual(tracing.stop(), [])
+
+    def test_callback(self):
+        events = []
+        tracing.start(callback=events.append)
+        n = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        a = n[1]
+        tracing.stop()
+
+        names = [e['name'] for e in events]
+        self.assertIn('Nansat._get_mapper', names)
+        self.assertIn('mapper.__init__', names)
+        self.assertIn('VRT.create_band', names)
+        read = events[names.index('Nansat.__getitem__')]
+        self.assertEqual(read['args']['band'], 1)
+        self.assertEqual(read['args']['bytes'], a.nbytes)
+        # mapper span is nested in _get_mapper span
+        outer = events[names.index('Nansat._get_mapper')]
+        inner = events[names.index('mapper.__init__')]
+        self.assertGreaterEqual(inner['ts'], outer['ts'])
+        self.assertLessEqual(inner['ts'] + inner['dur'], outer['ts'] + outer['dur'])
+
+    def test_trace_file(self):
+        trace_file = os.path.join(self.tmp_data_path, 'test_trace.json')
+        tracing.start(trace_file)
+        with self.assertRaises(ValueError):
+            with tracing.span('failing'):
+                raise ValueError
+        tracing.stop()
+
+        with open(trace_file) as f:
+            trace = json.load(f)
+        self.assertEqual(trace['traceEvents'][0]['name'], 'failing')
+        self.assertEqual(trace['traceEvents'][0]['ph'], 'X')
+        self.assertEqual(trace['traceEvents'][0]['args']['error'], 'ValueError')
+
+
+if __name__ == "__main__":
+    unittest.main()
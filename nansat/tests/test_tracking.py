@@ -0,0 +1,66 @@
+#------------------------------------------------------------------------------
+# Name:         test_tracking.py
+# Purpose:      Test feature tracking by cross-correlation
+#
+# Licence:      This file is part of NANSAT. You can redistribute it or modify
+#               under the terms of GNU General Public License, v.3
+#               http://www.gnu.org/licenses/gpl-3.0.html
+#------------------------------------------------------------------------------
+from __future__ import absolute_import
+import unittest
+
+import numpy as np
+
+from nansat import tracking
+from nansat.nansat import Nansat
+from nansat.tests.nansat_test_base import NansatTestBase
+
+
+class TrackingTest(NansatTestBase):
+    def test_match_templates(self):
+        np.random.seed(0)
+        windows = np.random.randn(3, 24, 24)
+        templates = windows[:, 5:15, 7:17].copy()
+        templates[2] = np.nan
+        correlation, rows, cols = tracking.match_templates(templates, windows)
+
+        self.assertTrue(np.allclose(correlation[:2], 1))
+        # parabolic subpixel refinement may move the exact integer peak slightly
+        self.assertTrue(np.allclose(rows[:2], 5, atol=0.05))
+        self.assertTrue(np.allclose(cols[:2], 7, atol=0.05))
+        self.assertTrue(np.isnan(correlation[2]))
+
+    def test_subpixel_symmetric(self):
+        ncc = np.array([[0.1, 0.5, 0.1],
+                        [0.5, 1.0, 0.5],
+                        [0.1, 0.5, 0.1]])
+
+        self.assertEqual(tracking._subpixel(ncc, 1, 1), (1, 1))
+
+    def test_track(self):
+        n1 = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        array = n1[1].astype(np.float32)
+        n2 = Nansat.from_domain(n1, np.roll(np.roll(array, 2, axis=0), -3, axis=1))
+        r = tracking.track(n1, n2, template_size=16, search_size=32, step=20,
+                           threads=2, batch_size=5)
+        good = r['correlation'] > 0.9
+
+        self.assertTrue(good.any())
+        self.assertTrue(np.allclose(r['dx'][good], -3, atol=0.2))
+        self.assertTrue(np.allclose(r['dy'][good], 2, atol=0.2))
+        self.assertTrue(np.all(r['distance'][good] > 0))
+        for key in ['lon1', 'lat1', 'lon2', 'lat2', 'x2', 'y2', 'bearing']:
+            self.assertEqual(r[key].shape, r['x1'].shape)
+
+    def test_track_lonlat(self):
+        n1 = Nansat(self.test_file_gcps, mapper=self.default_mapper)
+        lon, lat = n1.transform_points([50, 60], [50, 60])
+        r = tracking.track(n1, n1, lon=lon, lat=lat, template_size=16, search_size=32)
+
+        self.assertTrue(np.allclose(r['x1'], [50, 60]))
+        self.assertTrue(np.allclose(r['correlation'], 1))
+        self.assertTrue(np.all(np.abs(r['dx']) < 0.5))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -25,7 +25,7 @@ import pythesint as pti
 
 from nansat.node import Node
 from nansat.nsr import NSR
-from nansat.vrt import VRT
+from nansat.vrt import VRT, check_vsimem_leaks
 from nansat.tests.nansat_test_base import NansatTestBase
 
 from nansat.exceptions import NansatProjectionError
@@ -204,6 +204,61 @@ class VRTTest(NansatTestBase):
 
         self.assertEqual([e.tag for e in root], ['Metadata', 'VRTRasterBand'])
 
+    def test_close(self):
+        lon, lat = np.meshgrid(np.linspace(0, 5, 10), np.linspace(10, 20, 30))
+        vrt1 = VRT.from_lonlat(lon, lat)
+        vrt1.band_vrts = {1: VRT.from_array(lon)}
+        vrt2 = vrt1.get_super_vrt()
+        vrt1 = None
+        filenames = [vrt2.filename, vrt2.vrt.filename, vrt2.vrt.band_vrts[1].filename,
+                     vrt2.vrt.band_vrts[1].filename.replace('vrt', 'raw'),
+                     vrt2.geolocation.x_vrt.filename]
+        with vrt2:
+            self.assertTrue(all(gdal.VSIStatL(f) is not None for f in filenames))
+
+        self.assertTrue(all(gdal.VSIStatL(f) is None for f in filenames))
+        self.assertIsNone(vrt2.dataset)
+        self.assertIsNone(vrt2.vrt)
+        vrt2.close()
+
+    def test_close_copy(self):
+        lon, lat = np.meshgrid(np.linspace(0, 5, 10), np.linspace(10, 20, 30))
+        vrt1 = VRT.from_lonlat(lon, lat)
+        vrt1.band_vrts = {1: VRT.from_array(lon)}
+        vrt2 = vrt1.copy()
+        vrt2.close()
+
+        # VRTs shared with vrt1 are not released
+        self.assertIsNotNone(gdal.VSIStatL(vrt1.band_vrts[1].filename))
+        self.assertIsNotNone(gdal.VSIStatL(vrt1.geolocation.x_vrt.filename))
+        self.assertIsNotNone(vrt1.band_vrts[1].dataset.ReadAsArray())
+
+    def test_close_referrers(self):
+        vrt1 = VRT.from_array(np.zeros((10, 10)))
+        band_vrt = VRT.from_array(np.ones((10, 10)))
+        vrt1.band_vrts = {1: band_vrt}
+        vrt2 = VRT.from_array(np.zeros((10, 10)))
+        vrt2.band_vrts[1] = band_vrt
+
+        self.assertEqual(set(band_vrt._get_referrers()), set([vrt1, vrt2]))
+        vrt2.close()
+        self.assertEqual(set(band_vrt._get_referrers()), set([vrt1]))
+        self.assertIsNotNone(band_vrt.dataset)
+        vrt1.band_vrts.pop(1)
+        self.assertEqual(len(band_vrt._get_referrers()), 0)
+        band_vrt.close()
+
+    def test_check_vsimem_leaks(self):
+        vrt = VRT()
+        with warnings.catch_warnings(record=True) as w:
+            warnings.simplefilter('always')
+            files = check_vsimem_leaks()
+        self.assertIn(vrt.filename, files)
+        self.assertIn('VRT not closed', str(w[0].message))
+
+        vrt.close()
+        self.assertNotIn(vrt.filename, check_vsimem_leaks())
+
     def test_create_band(self):
         array = gdal.Open(self.test_file_gcps).ReadAsArray()[1, 10:, :]
         vrt1 = VRT.from_array(array)
@@ -232,6 +287,17 @@ class VRTTest(NansatTestBase):
         with self.assertRaises(KeyError):
             src2 = VRT._make_source_bands_xml({})
 
+    def test_create_band_replicated_row(self):
+        vrt1 = VRT.from_array(np.array([[1, 2, 3]], 'float32'))
+        vrt2 = VRT(x_size=3, y_size=4)
+        vrt2.create_band({'SourceFilename': vrt1.filename,
+                          'SourceBand': 1,
+                          'xSize': 3,
+                          'ySize': 1,
+                          'dstYSize': 4})
+        data = vrt2.dataset.GetRasterBand(1).ReadAsArray()
+        self.assertTrue(np.all(data == np.array([[1, 2, 3]] * 4)))
+
     def test_set_add_band_options(self):
         # case 1
         srcs = [{'SourceFilename': 'filename', 'SourceBand': 1}]
@@ -0,0 +1,339 @@
+# Name:    texture.py
+# Purpose: GLCM texture features of Nansat bands
+# Licence:
+# This file is part of NANSAT.
+# NANSAT is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3 of the License.
+# http://www.gnu.org/licenses/gpl-3.0.html
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+"""Grey level co-occurrence matrix (GLCM) texture features
+
+A band is read in blocks of lines and quantized into <levels> grey levels.
+Texture features are computed in windows of <window> x <window> pixels moved
+by <step> pixels, i.e. on a grid decimated by <step>. Co-occurrence matrices
+are symmetric and combine all given angles for each distance. The matrix is
+updated incrementally when the window moves along a line: only pairs of the
+columns which leave and enter the window are removed and added.
+
+Computation is done by the C extension nansat._glcm (compiled by setup.py)
+in tiles of lines of the output grid, in several threads (the extension
+releases the GIL). Tiles are computed as soon as the required lines are read.
+Without the extension a (slow) NumPy implementation is used.
+
+Examples
+--------
+>>> from nansat.texture import glcm
+>>> n = Nansat(s1_filename)
+>>> t = glcm(n, 'sigma0_HV', window=32, step=16, distances=[1, 4], levels=32,
+...          features=['contrast', 'homogeneity', 'entropy'])
+>>> t['sigma0_HV_contrast_1']
+
+"""
+from __future__ import absolute_import
+import multiprocessing
+
+try:
+    from concurrent.futures import ThreadPoolExecutor
+except ImportError:
+    ThreadPoolExecutor = None
+
+import numpy as np
+
+from nansat.nansat import Nansat
+from nansat.domain import Domain
+from nansat.vrt import VRT
+from nansat.utils import gdal
+
+try:
+    from nansat import _glcm
+except ImportError:
+    _glcm = None
+
+# order of features computed by nansat._glcm
+FEATURES = ['contrast', 'dissimilarity', 'homogeneity', 'ASM', 'energy',
+            'entropy', 'correlation', 'mean', 'variance']
+
+# value of invalid pixels in quantized image
+INVALID = 255
+
+
+def quantize(array, levels=32, limits=None):
+    """Quantize array into grey levels 0..levels-1
+
+    Parameters
+    ----------
+    array : numpy.ndarray
+        data
+    levels : int
+        number of grey levels (max 255)
+    limits : (float, float)
+        values mapped to the lowest and to the highest level. Values outside
+        are clipped. Minimum and maximum of array if None
+
+    Returns
+    -------
+    image : numpy.ndarray
+        uint8 array, INVALID for NaN and inf
+
+    """
+    array = np.asarray(array, dtype=np.float32)
+    if limits is None:
+        limits = np.nanmin(array), np.nanmax(array)
+    vmin, vmax = float(limits[0]), float(limits[1])
+    scale = levels / (vmax - vmin) if vmax > vmin else 0.
+    with np.errstate(invalid='ignore'):
+        image = np.clip(np.floor((array - vmin) * scale), 0, levels - 1)
+    image[~np.isfinite(array)] = INVALID
+    return image.astype(np.uint8)
+
+
+def get_offsets(distance, angles):
+    """Return array of pixel offsets (dx, dy) for distance and angles (degrees, 90 - up)"""
+    offsets = [(int(round(distance * np.cos(np.radians(angle)))),
+                -int(round(distance * np.sin(np.radians(angle)))))
+               for angle in angles]
+    return np.array(offsets, dtype=np.intc)
+
+
+def matrix_features(counts):
+    """Return list of features (in order of FEATURES) of a symmetric co-occurrence matrix"""
+    total = counts.sum()
+    if total == 0:
+        return [np.nan] * len(FEATURES)
+    p = counts / float(total)
+    i, j = np.indices(p.shape)
+    d = i - j
+    mean = (i * p).sum()
+    var = ((i - mean) ** 2 * p).sum()
+    cov = ((i - mean) * (j - mean) * p).sum()
+    asm = (p ** 2).sum()
+    nonzero = p[p > 0]
+    return [(d ** 2 * p).sum(),
+            (np.abs(d) * p).sum(),
+            (p / (1. + d ** 2)).sum(),
+            asm,
+            np.sqrt(asm),
+            -(nonzero * np.log(nonzero)).sum(),
+            cov / var if var > 1e-12 else 1.,
+            mean,
+            var]
+
+
+def _features_numpy(image, width, height, levels, window, step, offsets, row0, row1, out):
+    """Same as nansat._glcm.features, but without incremental update (slow)"""
+    cols = (width - window) // step + 1
+    out = out.reshape(len(FEATURES), row1 - row0, cols)
+    image = np.asarray(image).reshape(height, width)
+    for row in range(row0, row1):
+        for col in range(cols):
+            w = image[row * step:row * step + window, col * step:col * step + window]
+            counts = np.zeros(levels * levels)
+            for dx, dy in offsets.reshape(-1, 2):
+                a = w[max(0, -dy):window - max(0, dy), max(0, -dx):window - max(0, dx)]
+                b = w[max(0, dy):window + min(0, dy), max(0, dx):window + min(0, dx)]
+                valid = (a < levels) & (b < levels)
+                a = a[valid].astype(np.intp)
+                b = b[valid].astype(np.intp)
+                counts += np.bincount(a * levels + b, minlength=levels * levels)
+                counts += np.bincount(b * levels + a, minlength=levels * levels)
+            out[:, row - row0, col] = matrix_features(counts.reshape(levels, levels))
+
+
+def compute_features(image, levels, window, step, offsets, row0, row1):
+    """Compute all FEATURES for lines row0..row1-1 of the output grid
+
+    Parameters
+    ----------
+    image : numpy.ndarray
+        2D uint8 C-contiguous array with quantized values (see quantize)
+    levels : int
+        number of grey levels
+    window : int
+        size of window (pixels)
+    step : int
+        step between windows (pixels)
+    offsets : numpy.ndarray
+        intc array of pixel offsets (dx, dy), see get_offsets
+    row0, row1 : int
+        range of lines of the output grid
+
+    Returns
+    -------
+    features : numpy.ndarray
+        float32 array len(FEATURES) x (row1 - row0) x output columns
+
+    """
+    height, width = image.shape
+    cols = (width - window) // step + 1
+    out = np.empty((len(FEATURES), row1 - row0, cols), np.float32)
+    offsets = np.ascontiguousarray(offsets, dtype=np.intc)
+    if _glcm is None:
+        _features_numpy(image, width, height, levels, window, step, offsets, row0, row1, out)
+    else:
+        _glcm.features(image, width, height, levels, window, step, offsets, row0, row1, out)
+    return out
+
+
+def estimate_limits(n, band_id, percentiles=(2, 98), size=1000):
+    """Estimate limits for quantization from percentiles of decimated band
+
+    Parameters
+    ----------
+    n : Nansat
+        input object
+    band_id : int or str
+        band number or name
+    percentiles : (float, float)
+        percentiles of valid values used as limits
+    size : int
+        maximum size of the decimated band
+
+    """
+    band = n.get_GDALRasterBand(band_id)
+    factor = max(1., max(band.XSize, band.YSize) / float(size))
+    x_size = max(1, int(band.XSize / factor))
+    y_size = max(1, int(band.YSize / factor))
+    data = band.ReadAsArray(buf_xsize=x_size, buf_ysize=y_size).astype(np.float32)
+    data = n._finalize_band_data(band, data, lambda: n.get_GDALRasterBand(
+        'swathmask').ReadAsArray(buf_xsize=x_size, buf_ysize=y_size))
+    data = data[np.isfinite(data)]
+    if data.size == 0:
+        raise ValueError('Band %s has no valid values' % str(band_id))
+    return tuple(np.percentile(data, percentiles))
+
+
+def decimated_domain(n, window, step):
+    """Return Domain of the grid of window centers
+
+    Pixel (col, row) of the grid corresponds to the window with upper left
+    corner at (col * step, row * step) in <n>. GCPs and geotransform are scaled
+    and shifted accordingly.
+    """
+    height, width = n.shape()
+    cols = (width - window) // step + 1
+    rows = (height - window) // step + 1
+    # pixel x in n = shift + step * x in the grid
+    shift = (window - step) / 2.
+    dataset = n.vrt.dataset
+    gt = dataset.GetGeoTransform()
+    geo_transform = (gt[0] + shift * (gt[1] + gt[2]), gt[1] * step, gt[2] * step,
+                     gt[3] + shift * (gt[4] + gt[5]), gt[4] * step, gt[5] * step)
+    gcps = []
+    for gcp in dataset.GetGCPs():
+        gcps.append(gdal.GCP(gcp.GCPX, gcp.GCPY, gcp.GCPZ,
+                             (gcp.GCPPixel - shift) / step, (gcp.GCPLine - shift) / step))
+    d = Domain.__new__(Domain)
+    d.vrt = VRT.from_dataset_params(cols, rows, geo_transform, dataset.GetProjection(),
+                                    gcps, dataset.GetGCPProjection())
+    return d
+
+
+def glcm(n, band_id, window=32, step=16, distances=(1,), angles=(0, 45, 90, 135),
+         levels=32, features=None, limits=None, threads=None, tile_rows=8, block_lines=256):
+    """Compute GLCM texture features of a band
+
+    Parameters
+    ----------
+    n : Nansat
+        input object
+    band_id : int or str
+        band number or name. Values are processed as in Nansat.__getitem__
+        (e.g. convert sigma0 to dB beforehand with a pixel function or add_band)
+    window : int
+        size of window (pixels)
+    step : int
+        step between windows (pixels). Defines decimation of the output grid
+    distances : list of int
+        pixel distances. Features are computed for each distance
+    angles : list of float
+        angles (degrees). Matrices of all angles are combined
+    levels : int
+        number of grey levels (max 255)
+    features : list of str
+        names of features (see FEATURES). All features if None
+    limits : (float, float)
+        values mapped to the lowest and to the highest grey level. 2nd and 98th
+        percentiles of the band if None
+    threads : int
+        number of threads. Number of CPUs if None
+    tile_rows : int
+        number of lines of the output grid computed by one task
+    block_lines : int
+        number of lines of the band read at once
+
+    Returns
+    -------
+    t : Nansat
+        object on the decimated grid with bands <band name>_<feature>_<distance>
+
+    """
+    if features is None:
+        features = FEATURES
+    for feature in features:
+        if feature not in FEATURES:
+            raise ValueError('Unknown GLCM feature %s. Use one of %s' % (feature, FEATURES))
+    if not 1 <= levels <= 255:
+        raise ValueError('Number of grey levels must be 1..255')
+    height, width = n.shape()
+    if window > min(width, height):
+        raise ValueError('Window is larger than the band')
+    for distance in distances:
+        if distance >= window:
+            raise ValueError('Distance must be smaller than window')
+    rows = (height - window) // step + 1
+    cols = (width - window) // step + 1
+    if limits is None:
+        limits = estimate_limits(n, band_id)
+    offsets = [get_offsets(distance, angles) for distance in distances]
+    result = np.empty((len(distances), len(FEATURES), rows, cols), np.float32)
+    image = np.empty((height, width), np.uint8)
+
+    def compute(i, row0, row1):
+        result[i, :, row0:row1] = compute_features(image, levels, window, step,
+                                                   offsets[i], row0, row1)
+
+    pool = None
+    if ThreadPoolExecutor is not None:
+        pool = ThreadPoolExecutor(threads or multiprocessing.cpu_count())
+    futures = []
+    next_row = 0
+    try:
+        for y_offset, blocks in n.iter_blocks([band_id], block_lines, prefetch_depth=1):
+            image[y_offset:y_offset + blocks[0].shape[0]] = quantize(blocks[0], levels, limits)
+            lines_read = y_offset + blocks[0].shape[0]
+            # compute tiles which windows are read
+            while next_row < rows:
+                row1 = min(next_row + tile_rows, rows)
+                if (row1 - 1) * step + window > lines_read:
+                    break
+                for i in range(len(distances)):
+                    if pool is None:
+                        compute(i, next_row, row1)
+                    else:
+                        futures.append(pool.submit(compute, i, next_row, row1))
+                next_row = row1
+        for future in futures:
+            future.result()
+    finally:
+        if pool is not None:
+            pool.shutdown(wait=True)
+
+    band_name = n.get_metadata(band_id=band_id).get('name', 'band%d' % n.get_band_number(band_id))
+    arrays, parameters = [], []
+    for i, distance in enumerate(distances):
+        for feature in features:
+            arrays.append(result[i, FEATURES.index(feature)])
+            parameters.append({'name': '%s_%s_%d' % (band_name, feature, distance),
+                               'glcm_feature': feature,
+                               'glcm_distance': str(distance),
+                               'glcm_angles': ' '.join(str(a) for a in angles),
+                               'glcm_window': str(window),
+                               'glcm_step': str(step),
+                               'glcm_levels': str(levels),
+                               'glcm_limits': '%g %g' % tuple(limits)})
+    t = Nansat.from_domain(decimated_domain(n, window, step))
+    t.add_bands(arrays, parameters)
+    return t
@@ -33,13 +33,16 @@ else:
     CARTOPY_IS_INSTALLED = True
 
 from nansat.nansat import Nansat
+from nansat.distance import distance_to_land
 from nansat import utils
 
-def distance2coast(dst_domain, distance_src=None):
+def distance2coast(dst_domain, distance_src=None, watermask=None):
     """ Estimate distance to the nearest coast (in km) for each pixcel in the
     domain of interest. The method utilizes NASA's OBPG group Distance to the Nearest Coast
     product: https://oceancolor.gsfc.nasa.gov/docs/distfromcoast/. The product is stored in GeoTiff
     format with pixcelsize of 0.01x0.01 degree.
+    If watermask is given, the distance is computed from the watermask directly on the grid
+    of dst_domain (see nansat.distance.distance_to_land)
 
     Parameters
     -----------
@@ -47,6 +50,9 @@ def distance2coast(dst_domain, distance_src=None):
         destination domain
     distance_src : str
         path to the NASA Distance to the Nearest coast GeoTIFF product
+    watermask : Nansat or numpy.ndarray or True
+        watermask on dst_domain (land=0) or boolean array (True for land).
+        If True, the watermask is fetched with Nansat.watermask()
 
     Returns
     --------
@@ -58,6 +64,8 @@ def distance2coast(dst_domain, distance_src=None):
     `<http://nansat.readthedocs.io/en/latest/source/features.html#differentiating-between-land-and-water>`
 
     """
+    if watermask is not None:
+        return distance_to_land(dst_domain, None if watermask is True else watermask)
     # Get path to the auxilary dataset predefined in enviromental variable
     if distance_src is None:
         distance_src = os.getenv('DIST2COAST')
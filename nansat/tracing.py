@@ -0,0 +1,192 @@
+# Name:    tracing.py
+# Purpose: Opt-in timing of nested Nansat operations
+# Licence:
+# This file is part of NANSAT.
+# NANSAT is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3 of the License.
+# http://www.gnu.org/licenses/gpl-3.0.html
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+"""Opt-in tracing of Nansat operations
+
+Spans (name, start, duration and attributes such as file, mapper, band or
+number of bytes) are recorded around opening, mapper probing, VRT building,
+reading, reprojection, export and figure processing. Spans are written as a
+Chrome trace (open in chrome://tracing or https://ui.perfetto.dev) and/or
+given to a callback. When tracing is not started the cost is one global
+lookup per traced call.
+
+Examples
+--------
+>>> from nansat import tracing
+>>> tracing.start('trace.json')
+>>> n = Nansat(filename)
+>>> a = n[1]
+>>> tracing.stop()  # writes trace.json
+
+Tracing of a whole script can be started with the environment variable
+NANSAT_TRACE=/path/to/trace.json
+
+"""
+from __future__ import absolute_import
+import os
+import json
+import time
+import atexit
+import functools
+import threading
+
+# active Tracer or None
+_tracer = None
+
+
+class Tracer(object):
+    """Collect finished spans as Chrome trace events"""
+
+    def __init__(self, filename=None, callback=None):
+        self.filename = filename
+        self.callback = callback
+        self.events = []
+        self.t0 = time.time()
+        self.lock = threading.Lock()
+
+    def add(self, name, start, end, attrs):
+        """Add span as complete ('X') event"""
+        event = {'name': name,
+                 'cat': name.split('.')[0],
+                 'ph': 'X',
+                 'ts': (start - self.t0) * 1e6,
+                 'dur': (end - start) * 1e6,
+                 'pid': os.getpid(),
+                 'tid': threading.current_thread().ident,
+                 'args': attrs}
+        with self.lock:
+            self.events.append(event)
+        if self.callback is not None:
+            self.callback(event)
+
+    def write(self, filename):
+        """Write events into JSON file in Chrome trace format"""
+        with open(filename, 'w') as trace_file:
+            json.dump({'traceEvents': self.events, 'displayTimeUnit': 'ms'},
+                      trace_file, default=str)
+
+
+class Span(object):
+    """Context manager measuring one operation"""
+
+    def __init__(self, tracer, name, attrs):
+        self.tracer = tracer
+        self.name = name
+        self.attrs = attrs
+
+    def set(self, **attrs):
+        """Add attributes known only inside the span (e.g. bytes read)"""
+        self.attrs.update(attrs)
+
+    def __enter__(self):
+        self.start = time.time()
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        if exc_type is not None:
+            self.attrs['error'] = exc_type.__name__
+        self.tracer.add(self.name, self.start, time.time(), self.attrs)
+        return False
+
+
+class NullSpan(object):
+    """Span used when tracing is disabled"""
+
+    def set(self, **attrs):
+        pass
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        return False
+
+_null_span = NullSpan()
+
+
+def start(filename=None, callback=None):
+    """Start recording spans
+
+    Parameters
+    ----------
+    filename : str
+        name of the Chrome trace file written by stop()
+    callback : callable
+        function called with each event (dict) when a span finishes
+
+    """
+    global _tracer
+    _tracer = Tracer(filename, callback)
+
+
+def stop():
+    """Stop recording, write trace file (if given to start) and return events"""
+    global _tracer
+    tracer, _tracer = _tracer, None
+    if tracer is None:
+        return []
+    if tracer.filename:
+        tracer.write(tracer.filename)
+    return tracer.events
+
+
+def is_enabled():
+    return _tracer is not None
+
+
+def span(name, **attrs):
+    """Return context manager recording span <name> with attributes <attrs>
+
+    Examples
+    --------
+    >>> with tracing.span('mapper.__init__', mapper='generic') as s:
+    >>>     ...
+    >>>     s.set(bands=10)
+
+    """
+    if _tracer is None:
+        return _null_span
+    return Span(_tracer, name, attrs)
+
+
+def traced(name, attrs=None, result_attrs=None):
+    """Decorator recording span around a function
+
+    Parameters
+    ----------
+    name : str
+        name of the span
+    attrs : callable
+        called with arguments of the function, returns dict with attributes
+    result_attrs : callable
+        called with returned value of the function, returns dict with attributes
+
+    """
+    def decorator(func):
+        @functools.wraps(func)
+        def wrapper(*args, **kwargs):
+            if _tracer is None:
+                return func(*args, **kwargs)
+            span_attrs = {}
+            if attrs is not None:
+                span_attrs = attrs(*args, **kwargs)
+            with Span(_tracer, name, span_attrs) as s:
+                result = func(*args, **kwargs)
+                if result_attrs is not None:
+                    s.set(**result_attrs(result))
+            return result
+        return wrapper
+    return decorator
+
+
+if os.environ.get('NANSAT_TRACE'):
+    start(os.environ['NANSAT_TRACE'])
+    atexit.register(stop)
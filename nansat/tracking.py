@@ -0,0 +1,268 @@
+# Name:    tracking.py
+# Purpose: Feature tracking between two Nansat objects by cross-correlation
+# Licence:
+# This file is part of NANSAT.
+# NANSAT is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3 of the License.
+# http://www.gnu.org/licenses/gpl-3.0.html
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+"""Feature tracking between two Nansat objects (e.g. sea ice drift)
+
+Templates (template_size x template_size pixels) are taken from the first
+object at a grid of positions. Each position is transformed to lon/lat and
+into pixel coordinates of the second object with the GDAL transformers of
+the objects, and a search window (search_size x search_size pixels) is taken
+around it. The templates are matched inside the search windows by normalized
+cross-correlation (NCC).
+
+Correlation is computed with FFT for batches of templates at once: all
+templates of a batch have the same shape, so NumPy reuses the FFT plan
+(twiddle factors) for the whole batch. Sums of the search windows for
+normalization are computed with integral images. Batches are processed in a
+thread pool (NumPy releases the GIL in FFT and array operations).
+
+Examples
+--------
+>>> from nansat.tracking import track
+>>> n1 = Nansat(s1_filename1)
+>>> n2 = Nansat(s1_filename2)
+>>> r = track(n1, n2, 'sigma0_HV', template_size=32, search_size=96, step=50)
+>>> good = r['correlation'] > 0.5
+>>> u = r['distance'][good] * np.sin(np.radians(r['bearing'][good]))
+
+"""
+from __future__ import absolute_import, division
+import multiprocessing
+
+try:
+    from concurrent.futures import ThreadPoolExecutor
+except ImportError:
+    ThreadPoolExecutor = None
+
+import numpy as np
+
+from nansat.utils import haversine, initial_bearing
+
+
+def extract_window(array, top, left, size):
+    """Return size x size window of array with upper left corner at (top, left), NaN outside"""
+    window = np.full((size, size), np.nan, np.float32)
+    y0, x0 = max(top, 0), max(left, 0)
+    y1 = min(top + size, array.shape[0])
+    x1 = min(left + size, array.shape[1])
+    if y1 > y0 and x1 > x0:
+        window[y0 - top:y1 - top, x0 - left:x1 - left] = array[y0:y1, x0:x1]
+    return window
+
+
+def _transform_points(domain, x, y, inverse=0):
+    """Transform pixel/line into lon/lat (or inverse) with NaN for non-finite input"""
+    x, y = np.asarray(x, float), np.asarray(y, float)
+    x_out = np.full(x.shape, np.nan)
+    y_out = np.full(y.shape, np.nan)
+    finite = np.isfinite(x) & np.isfinite(y)
+    if finite.any():
+        x_out[finite], y_out[finite] = domain.transform_points(x[finite], y[finite],
+                                                               DstToSrc=inverse)
+    return x_out, y_out
+
+
+def _fill_invalid(windows, max_invalid):
+    """Replace NaN with mean of each window, return mask of windows with few NaNs"""
+    invalid = ~np.isfinite(windows)
+    fraction = invalid.mean(axis=(1, 2))
+    good = fraction <= max_invalid
+    with np.errstate(invalid='ignore'):
+        means = np.nanmean(np.where(invalid, np.nan, windows), axis=(1, 2))
+    means[~np.isfinite(means)] = 0
+    windows = np.where(invalid, means[:, None, None], windows)
+    return windows, good
+
+
+def _subpixel(ncc, i, j):
+    """Parabolic interpolation of peak position around integer maximum (i, j)"""
+    def offset(c_minus, c0, c_plus):
+        denominator = c_minus - 2 * c0 + c_plus
+        # flat or symmetric neighbours: keep the integer peak
+        if denominator >= 0 or np.isclose(c_minus, c_plus):
+            return 0.
+        return 0.5 * (c_minus - c_plus) / denominator
+    di = dj = 0.
+    if 0 < i < ncc.shape[0] - 1:
+        di = offset(ncc[i - 1, j], ncc[i, j], ncc[i + 1, j])
+    if 0 < j < ncc.shape[1] - 1:
+        dj = offset(ncc[i, j - 1], ncc[i, j], ncc[i, j + 1])
+    return i + di, j + dj
+
+
+def match_templates(templates, windows, max_invalid=0.1):
+    """Match templates in search windows by normalized cross-correlation
+
+    Parameters
+    ----------
+    templates : numpy.ndarray
+        K x M x M array with templates
+    windows : numpy.ndarray
+        K x N x N array with search windows (N >= M)
+    max_invalid : float
+        maximum fraction of NaN in template or window (replaced by mean)
+
+    Returns
+    -------
+    correlation : numpy.ndarray
+        maximum of NCC for each template (NaN if not matched)
+    rows, cols : numpy.ndarray
+        position of upper left corner of template in search window at the
+        maximum, with subpixel precision
+
+    """
+    k, m = templates.shape[:2]
+    n = windows.shape[1]
+    templates, good_t = _fill_invalid(templates.astype(np.float64), max_invalid)
+    windows, good_w = _fill_invalid(windows.astype(np.float64), max_invalid)
+
+    # zero mean templates
+    templates -= templates.mean(axis=(1, 2))[:, None, None]
+    t_norm = np.sqrt((templates ** 2).sum(axis=(1, 2)))
+
+    # cross-correlation for all shifts without wrapping (0..N-M)
+    fft_windows = np.fft.rfft2(windows, axes=(1, 2))
+    fft_templates = np.fft.rfft2(templates, s=(n, n), axes=(1, 2))
+    numerator = np.fft.irfft2(fft_windows * np.conj(fft_templates), s=(n, n), axes=(1, 2))
+    numerator = numerator[:, :n - m + 1, :n - m + 1]
+
+    # sums of windows and squared windows under the template for each shift
+    def window_sums(array):
+        integral = np.zeros((k, n + 1, n + 1))
+        integral[:, 1:, 1:] = array.cumsum(axis=1).cumsum(axis=2)
+        return (integral[:, m:, m:] - integral[:, :-m, m:] -
+                integral[:, m:, :-m] + integral[:, :-m, :-m])
+    sums = window_sums(windows)
+    sums2 = window_sums(windows ** 2)
+    w_var = np.maximum(sums2 - sums ** 2 / (m * m), 0)
+    with np.errstate(invalid='ignore', divide='ignore'):
+        ncc = numerator / (t_norm[:, None, None] * np.sqrt(w_var))
+    ncc[~np.isfinite(ncc)] = -np.inf
+
+    correlation = np.full(k, np.nan)
+    rows = np.full(k, np.nan)
+    cols = np.full(k, np.nan)
+    for i in np.nonzero(good_t & good_w & (t_norm > 0))[0]:
+        peak = np.argmax(ncc[i])
+        row, col = np.unravel_index(peak, ncc[i].shape)
+        if not np.isfinite(ncc[i][row, col]):
+            continue
+        correlation[i] = ncc[i][row, col]
+        rows[i], cols[i] = _subpixel(ncc[i], row, col)
+    return correlation, rows, cols
+
+
+def track(n1, n2, band1=1, band2=None, x1=None, y1=None, lon=None, lat=None,
+          template_size=32, search_size=64, step=None, max_invalid=0.1,
+          threads=None, batch_size=256):
+    """Track features from n1 to n2 by cross-correlation of templates
+
+    Parameters
+    ----------
+    n1, n2 : Nansat
+        first and second objects (e.g. images of the same area at two times)
+    band1, band2 : int or str
+        bands of n1 and n2. Same as band1 if band2 is None
+    x1, y1 : list or numpy.ndarray
+        pixel/line coordinates of centers of templates in n1
+    lon, lat : list or numpy.ndarray
+        longitudes and latitudes of centers of templates (if x1, y1 are not given)
+    template_size : int
+        size of templates (pixels of n1)
+    search_size : int
+        size of search windows (pixels of n2)
+    step : int
+        step of regular grid of templates in n1 if no positions are given
+        (template_size if None)
+    max_invalid : float
+        maximum fraction of NaN in template or search window
+    threads : int
+        number of threads. Number of CPUs if None
+    batch_size : int
+        number of templates matched at once
+
+    Returns
+    -------
+    result : dict
+        numpy arrays with keys:
+        x1, y1 - pixel/line of template centers in n1
+        x2, y2 - pixel/line of matched centers in n2
+        lon1, lat1, lon2, lat2 - lon/lat of start and end points
+        dx, dy - displacement (pixels of n2) relative to the position
+        predicted from geolocation of n1 and n2
+        distance - distance between start and end points (meters)
+        bearing - direction from start to end point (degrees from North)
+        correlation - peak of NCC (NaN if not matched)
+
+    """
+    if band2 is None:
+        band2 = band1
+    if search_size < template_size:
+        raise ValueError('search_size must be larger than template_size')
+    if x1 is None and lon is not None:
+        x1, y1 = _transform_points(n1, np.ravel(lon), np.ravel(lat), inverse=1)
+    if x1 is None:
+        step = step or template_size
+        height, width = n1.shape()
+        y1, x1 = np.meshgrid(np.arange(template_size / 2., height - template_size / 2. + 1, step),
+                             np.arange(template_size / 2., width - template_size / 2. + 1, step),
+                             indexing='ij')
+    # upper left corners of templates, template centers
+    x1 = np.asarray(x1, float).ravel()
+    y1 = np.asarray(y1, float).ravel()
+    valid1 = np.isfinite(x1) & np.isfinite(y1)
+    left1 = np.round(np.where(valid1, x1, -template_size) - template_size / 2.).astype(int)
+    top1 = np.round(np.where(valid1, y1, -template_size) - template_size / 2.).astype(int)
+    x1 = np.where(valid1, left1 + template_size / 2., np.nan)
+    y1 = np.where(valid1, top1 + template_size / 2., np.nan)
+
+    # predicted positions in n2
+    lon1, lat1 = _transform_points(n1, x1, y1)
+    x2p, y2p = _transform_points(n2, lon1, lat1, inverse=1)
+    # positions outside of n2 are not matched
+    outside = ~(np.isfinite(x2p) & np.isfinite(y2p))
+    left2 = np.round(np.where(outside, -search_size, x2p) - search_size / 2.).astype(int)
+    top2 = np.round(np.where(outside, -search_size, y2p) - search_size / 2.).astype(int)
+
+    array1 = n1[band1]
+    array2 = n2[band2]
+
+    def match_batch(start):
+        stop = min(start + batch_size, len(x1))
+        templates = np.array([extract_window(array1, top1[i], left1[i], template_size)
+                              for i in range(start, stop)])
+        windows = np.array([extract_window(array2, top2[i], left2[i], search_size)
+                            for i in range(start, stop)])
+        return match_templates(templates, windows, max_invalid)
+
+    starts = range(0, len(x1), batch_size)
+    if ThreadPoolExecutor is None:
+        results = [match_batch(start) for start in starts]
+    else:
+        pool = ThreadPoolExecutor(threads or multiprocessing.cpu_count())
+        try:
+            results = list(pool.map(match_batch, starts))
+        finally:
+            pool.shutdown(wait=True)
+    if results:
+        correlation, rows, cols = [np.hstack(r) for r in zip(*results)]
+    else:
+        correlation = rows = cols = np.zeros(0)
+
+    x2 = left2 + cols + template_size / 2.
+    y2 = top2 + rows + template_size / 2.
+    lon2, lat2 = _transform_points(n2, x2, y2)
+    return {'x1': x1, 'y1': y1, 'x2': x2, 'y2': y2,
+            'lon1': lon1, 'lat1': lat1, 'lon2': lon2, 'lat2': lat2,
+            'dx': x2 - x2p, 'dy': y2 - y2p,
+            'distance': haversine(lon1, lat1, lon2, lat2),
+            'bearing': initial_bearing(lon1, lat1, lon2, lat2),
+            'correlation': correlation}
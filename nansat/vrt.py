@@ -16,7 +16,9 @@
 # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
 from __future__ import absolute_import, unicode_literals, division
 import os
+import atexit
 import tempfile
+import weakref
 from string import Template, ascii_uppercase, digits
 from random import choice
 import warnings
@@ -30,6 +32,147 @@ from nansat.geolocation import Geolocation
 from nansat.utils import add_logger, numpy_to_gdal_type, gdal_type_to_offset, remove_keys, osr, gdal
 
 from nansat.exceptions import NansatProjectionError
+from nansat import tracing
+from nansat import prefetch
+from nansat import sharedmem
+
+# VRT objects which are not closed
+_open_vrts = weakref.WeakSet()
+
+
+def _refer(child, parent):
+    """Register parent as a referrer of child VRT"""
+    if isinstance(child, VRT) and parent is not None:
+        referrers = child._get_referrers()
+        referrers[parent] = referrers.get(parent, 0) + 1
+
+
+def _unrefer(child, parent):
+    """Remove one reference of parent to child VRT"""
+    if isinstance(child, VRT) and parent is not None:
+        referrers = child._get_referrers()
+        count = referrers.get(parent, 0) - 1
+        if count > 0:
+            referrers[parent] = count
+        else:
+            referrers.pop(parent, None)
+
+
+def _referring_property(name, children):
+    """Property of VRT which registers the VRT as referrer of VRTs in the value
+
+    children(value) returns the VRTs referred by the value of the property
+    """
+    attr = '_' + name
+
+    def getter(self):
+        return self.__dict__.get(attr)
+
+    def setter(self, value):
+        for child in children(self.__dict__.get(attr)):
+            _unrefer(child, self)
+        self.__dict__[attr] = value
+        for child in children(value):
+            _refer(child, self)
+
+    return property(getter, setter)
+
+
+class _BandVRTs(dict):
+    """Dict with VRTs of bands which registers its owner as referrer of the VRTs"""
+
+    def __init__(self, owner, *args, **kwargs):
+        dict.__init__(self)
+        self.owner = weakref.ref(owner)
+        self.update(*args, **kwargs)
+
+    def detach(self):
+        """Remove references of owner to all values, the dict is not tracked after that"""
+        for value in self.values():
+            _unrefer(value, self.owner())
+        self.owner = lambda: None
+
+    def __setitem__(self, key, value):
+        if key in self:
+            _unrefer(dict.__getitem__(self, key), self.owner())
+        dict.__setitem__(self, key, value)
+        _refer(value, self.owner())
+
+    def __delitem__(self, key):
+        _unrefer(dict.__getitem__(self, key), self.owner())
+        dict.__delitem__(self, key)
+
+    def pop(self, key, *default):
+        if key in self:
+            _unrefer(dict.__getitem__(self, key), self.owner())
+        return dict.pop(self, key, *default)
+
+    def popitem(self):
+        key, value = dict.popitem(self)
+        _unrefer(value, self.owner())
+        return key, value
+
+    def setdefault(self, key, default=None):
+        if key not in self:
+            self[key] = default
+        return dict.__getitem__(self, key)
+
+    def update(self, *args, **kwargs):
+        for key, value in dict(*args, **kwargs).items():
+            self[key] = value
+
+    def clear(self):
+        while self:
+            self.popitem()
+
+
+def _reachable_vrts(vrts):
+    """Return set of VRTs and all VRTs they refer to (sub-VRTs, band VRTs, geolocation)"""
+    found = set()
+    stack = list(vrts)
+    while stack:
+        vrt = stack.pop()
+        if vrt in found:
+            continue
+        found.add(vrt)
+        stack.extend(vrt._referred_vrts())
+    return found
+
+
+def vsimem_files():
+    """Return dict {filename: size} of files remaining in /vsimem"""
+    files = {}
+    for filename in gdal.ReadDirRecursive(str('/vsimem/')) or []:
+        stat = gdal.VSIStatL(str('/vsimem/' + filename))
+        if stat is not None and not stat.IsDirectory():
+            files['/vsimem/' + filename] = stat.size
+    return files
+
+
+def check_vsimem_leaks(max_files=10):
+    """Warn about files remaining in /vsimem and VRT objects which are not closed
+
+    Called at process exit if environment variable NANSAT_CHECK_LEAKS is set.
+
+    Returns
+    -------
+    files : dict
+        {filename: size} of files remaining in /vsimem
+
+    """
+    files = vsimem_files()
+    if files:
+        open_vrts = dict((vrt.filename, vrt) for vrt in list(_open_vrts))
+        lines = ['%s (%d bytes)%s' % (filename, files[filename],
+                                      ', %s not closed' % type(open_vrts[filename]).__name__
+                                      if filename in open_vrts else '')
+                 for filename in sorted(files)[:max_files]]
+        if len(files) > max_files:
+            lines.append('...')
+        warnings.warn('%d files (%d bytes) are not released from /vsimem:\n%s' % (
+            len(files), sum(files.values()), '\n'.join(lines)))
+    return files
+
 
 class VRT(object):
     """Wrapper around GDAL VRT-file
@@ -85,7 +228,7 @@ class VRT(object):
 
     """
     COMPLEX_SOURCE_XML = Template('''
-            <$SourceType>
+            <$SourceType$Resampling>
                 <SourceFilename relativeToVRT="0">$Dataset</SourceFilename>
                 <SourceBand>$SourceBand</SourceBand>
                 <NODATA>$NODATA</NODATA>
@@ -93,7 +236,7 @@ class VRT(object):
                 <ScaleRatio>$ScaleRatio</ScaleRatio>
                 <LUT>$LUT</LUT>
                 <SrcRect xOff="$xOff" yOff="$yOff" xSize="$xSize" ySize="$ySize"/>
-                <DstRect xOff="0" yOff="0" xSize="$xSize" ySize="$ySize"/>
+                <DstRect xOff="$dstXOff" yOff="$dstYOff" xSize="$dstXSize" ySize="$dstYSize"/>
             </$SourceType> ''')
 
     RAW_RASTER_BAND_SOURCE_XML = Template('''
@@ -117,13 +260,33 @@ class VRT(object):
 
     # instance attributes
     filename = ''
-    vrt = None
     dataset = None
     logger = None
     driver = None
-    band_vrts = None
     tps = None
-    geolocation = None
+
+    # references to other VRTs, tracked in the referred VRTs (see close())
+    vrt = _referring_property('vrt', lambda vrt: [vrt])
+    geolocation = _referring_property(
+        'geolocation', lambda geolocation: [] if geolocation is None else [geolocation.x_vrt,
+                                                                          geolocation.y_vrt])
+
+    @property
+    def band_vrts(self):
+        """dict with VRTs (or other objects) used by bands of self"""
+        return self.__dict__.get('_band_vrts')
+
+    @band_vrts.setter
+    def band_vrts(self, value):
+        if self.__dict__.get('_band_vrts') is not None:
+            self.__dict__['_band_vrts'].detach()
+        self.__dict__['_band_vrts'] = None if value is None else _BandVRTs(self, value)
+
+    def _get_referrers(self):
+        """WeakKeyDictionary {VRT: number of references} of VRTs referring to self"""
+        if '_referrers' not in self.__dict__:
+            self.__dict__['_referrers'] = weakref.WeakKeyDictionary()
+        return self.__dict__['_referrers']
 
     @classmethod
     def from_gdal_dataset(cls, gdal_dataset, **kwargs):
@@ -186,8 +349,9 @@ class VRT(object):
 
         Parameters
         ----------
-        array : numpy.ndarray
-            array with data
+        array : numpy.ndarray or nansat.sharedmem.SharedArray
+            array with data. SharedArray is used without copying if the shared
+            memory is visible in the file system (/dev/shm)
         **kwargs : dict
             arguments for VRT()
 
@@ -265,6 +429,7 @@ class VRT(object):
         self.dataset = self.driver.Create(self.filename, x_size, y_size, bands=0)
         self.dataset.SetMetadata(metadata)
         self.dataset.FlushCache()
+        _open_vrts.add(self)
 
     def _init_from_gdal_dataset(self, gdal_dataset, geolocation=None, **kwargs):
         """Init VRT from GDAL Dataset with the same size/georeference but wihout bands/metadata.
@@ -354,20 +519,28 @@ class VRT(object):
 
         Parameters
         ----------
-        array : numpy.ndarray
+        array : numpy.ndarray or nansat.sharedmem.SharedArray
             array with data
         **kwargs : dict
             arguments for VRT()
 
         Notes
         ---------
-        binary file is written (VSI)
+        binary file is written (VSI), except for SharedArray in /dev/shm
         VRT file is written (VSI)
         self - adds all VRT attributes
         self.dataset is updated
 
         """
         VRT.__init__(self, **kwargs)
+        if isinstance(array, sharedmem.SharedArray):
+            if array.path is not None:
+                # RawRasterBand points to the file with shared memory, no copy
+                self.shared_array = array
+                self._write_raw_band_xml(array.path, array.dtype.name, array.shape)
+                return
+            array = array.array
+
         # create flat binary file (in VSI) from numpy array
         array_type = array.dtype.name
         array_shape = array.shape
@@ -382,7 +555,10 @@ class VRT(object):
             gdal.VSIFWriteL(array_bytes[ind_start:ind_end],ind_end-ind_start,1,ofile)
         gdal.VSIFCloseL(ofile)
         array_bytes = None
+        self._write_raw_band_xml(binary_file, array_type, array_shape)
 
+    def _write_raw_band_xml(self, binary_file, array_type, array_shape):
+        """Write VRT with RawRasterBand which points to the binary file"""
         # convert Numpy datatype to gdal datatype and pixel offset
         gdal_data_type = numpy_to_gdal_type[array_type]
         pixel_offset = gdal_type_to_offset[gdal_data_type]
@@ -464,7 +640,58 @@ class VRT(object):
     def __del__(self):
         """Destructor deletes VRT and RAW files"""
         self.dataset = None
+        self._remove_files()
+
+    def __enter__(self):
+        return self
 
+    def __exit__(self, *args):
+        self.close()
+
+    def close(self):
+        """Release the VRT immediately instead of at garbage collection
+
+        GDAL dataset is closed, VRT and RAW files (in /vsimem or temporary
+        files on disk) are deleted. Sub-VRTs (self.vrt), VRTs of bands and of
+        geolocation are released as well, unless they are used by another VRT
+        which is not closed (e.g. shared by VRT.copy()). The VRT can not be
+        used after that.
+
+        """
+        if self not in _open_vrts:
+            return
+        own_vrts = _reachable_vrts([self])
+        # VRTs referred by open VRTs outside of own_vrts are still used (only
+        # referrers of own_vrts are checked, not all open VRTs)
+        used_vrts = _reachable_vrts([
+            vrt for vrt in own_vrts
+            if any(referrer not in own_vrts and referrer in _open_vrts
+                   for referrer in list(vrt._get_referrers().keys()))])
+        for vrt in (own_vrts - used_vrts) | set([self]):
+            vrt._release()
+
+    def _referred_vrts(self):
+        """Return list of VRTs referred by this VRT"""
+        vrts = [self.vrt]
+        if self.band_vrts:
+            vrts += list(self.band_vrts.values())
+        if self.geolocation is not None:
+            vrts += [self.geolocation.x_vrt, self.geolocation.y_vrt]
+        return [vrt for vrt in vrts if isinstance(vrt, VRT)]
+
+    def _release(self):
+        """Close dataset, delete files and references to other VRTs"""
+        _open_vrts.discard(self)
+        self.dataset = None
+        prefetch.forget_datasets(self.filename)
+        self._remove_files()
+        self.vrt = None
+        self.band_vrts = dict()
+        self.geolocation = None
+        self.shared_array = None
+
+    def _remove_files(self):
+        """Delete VRT and RAW files"""
         if gdal.VSIStatL(self.filename) is not None:
             gdal.Unlink(self.filename)
 
@@ -817,11 +1044,40 @@ class VRT(object):
         self.dataset.SetMetadata(metadata_escaped)
         self.dataset.FlushCache()
 
-    def hardcopy_bands(self):
-        """Make 'hardcopy' of bands: evaluate array from band and put into original band"""
+    def hardcopy_bands(self, prefetch_depth=0, block_lines=256, max_memory=None, pool=None):
+        """Make 'hardcopy' of bands: evaluate array from band and put into original band
+
+        Parameters
+        ----------
+        prefetch_depth : int
+            if > 0, bands are evaluated in blocks of lines, and <prefetch_depth>
+            blocks are read ahead in background threads (see nansat.prefetch)
+        block_lines : int
+            number of lines in one block
+        max_memory : int
+            maximum memory (bytes) of blocks read ahead
+        pool : nansat.sharedmem.SharedBufferPool
+            if given, bands are evaluated into shared memory buffers of the pool
+            (named 'band<N>'), which other processes can attach to
+
+        """
         bands = range(1, self.dataset.RasterCount+1)
-        for i in bands:
-            self.band_vrts[i] = VRT.from_array(self.dataset.GetRasterBand(i).ReadAsArray())
+        if pool is not None:
+            # fills the shared buffers of the pool, VRTs are made from the buffers below
+            prefetch.read_bands(
+                self, bands, block_lines, prefetch_depth, max_memory,
+                lambda i, shape, dtype: pool.get('band%d' % i, shape, dtype).array)
+            arrays = [pool.buffers['band%d' % i] for i in bands]
+            for i, array in zip(bands, arrays):
+                self.band_vrts[i] = VRT.from_array(array)
+        elif prefetch_depth > 0:
+            arrays = prefetch.read_bands(self, bands, block_lines, prefetch_depth, max_memory)
+            for i, array in zip(bands, arrays):
+                self.band_vrts[i] = VRT.from_array(array)
+        else:
+            # one band at a time: only one array is alive
+            for i in bands:
+                self.band_vrts[i] = VRT.from_array(self.dataset.GetRasterBand(i).ReadAsArray())
 
         node0 = Node.create(str(self.xml))
         for i, iNode1 in enumerate(node0.nodeList('VRTRasterBand')):
@@ -854,6 +1110,7 @@ class VRT(object):
             add_gcps = False
         return add_gcps
 
+    @tracing.traced('VRT.copy', lambda self: {'filename': self.filename})
     def copy(self):
         """Create and return a full copy of a VRT instance with new filenames
 
@@ -927,6 +1184,12 @@ class VRT(object):
             self.logger.debug('Creating band - OK!')
         self.dataset.FlushCache()
 
+    @tracing.traced('VRT.create_band',
+                    lambda self, src, dst=None: {
+                        'filename': self.filename,
+                        'name': (dst or {}).get('name'),
+                        'sources': len(src) if isinstance(src, list) else 1,
+                        'pixel_function': (dst or {}).get('PixelFunctionType')})
     def create_band(self, src, dst=None):
         """ Add band to self.dataset:
 
@@ -952,7 +1215,14 @@ class VRT(object):
             LineOffset (RawVRT),
             ByteOrder (RawVRT),
             xSize,
-            ySize
+            ySize,
+            dstXSize, dstYSize (size of the destination window if it differs
+            from the source window, e.g. a single row replicated to all
+            lines)
+            dstXOff, dstYOff (position of the source in the destination band,
+            e.g. tile in a mosaic)
+            resampling (resampling of the source window if its size differs
+            from the destination window, e.g. 'bilinear')
         dst : dict with parameters of the created band
             name,
             dataType,
@@ -967,7 +1237,9 @@ class VRT(object):
             2) in case the dst band has a different datatype
             than the source band it is important to add a
             SourceTransferType parameter in dst),
-            SourceTransferType
+            SourceTransferType,
+            PixelFunctionArguments (dict with arguments of the pixel
+            function, requires GDAL >= 3.4)
 
         Returns
         --------
@@ -1027,13 +1299,39 @@ class VRT(object):
 
         # set metadata from provided parameters
         # remove and add params
+        pixel_function_arguments = dst.pop('PixelFunctionArguments', None)
         dst['SourceFilename'] = srcs[0]['SourceFilename']
         dst['SourceBand'] = str(srcs[0]['SourceBand'])
         dst_raster_band = VRT._put_metadata(dst_raster_band, dst)
 
+        if pixel_function_arguments:
+            self._set_pixel_function_arguments(self.dataset.RasterCount,
+                                               pixel_function_arguments)
+
         # return name of the created band
         return dst['name']
 
+    def _set_pixel_function_arguments(self, band_num, arguments):
+        """Add <PixelFunctionArguments> to the band with a pixel function
+
+        Parameters
+        ----------
+        band_num : int
+            number of the band
+        arguments : dict
+            names and values of arguments
+
+        """
+        node0 = Node.create(self.xml)
+        node1 = node0.node('VRTRasterBand', band_num - 1)
+        node1 += Node('PixelFunctionArguments',
+                      **dict((str(key), str(arguments[key]))
+                             for key in arguments))
+        self.write_xml(node0.rawxml())
+
+    @tracing.traced('VRT.write_xml',
+                    lambda self, vsi_file_content=None: {
+                        'filename': self.filename, 'bytes': len(vsi_file_content)})
     def write_xml(self, vsi_file_content=None):
         """Write XML content into a VRT dataset
 
@@ -1363,6 +1661,71 @@ class VRT(object):
 
         return super_vrt
 
+    def get_rotated_vrt(self, vector_pairs, angle, step):
+        """Create a new VRT object with vector components rotated by a coarse field of angles
+
+        Bands of the new VRT refer to bands of the current object (as in get_super_vrt). Each pair
+        of vector bands is replaced by pixel function bands UVRotatedU and UVRotatedV which rotate
+        the vector counter-clockwise by the angle. The angle field is upsampled to the full raster
+        size with bilinear interpolation, so GDAL applies the rotation per block while reading.
+
+        Parameters
+        ----------
+        vector_pairs : list of tuples
+            pairs (u, v) of band numbers with vector components
+        angle : numpy.ndarray
+            2D array with angles (degrees), one value per step x step pixels
+        step : int
+            size of a cell of the angle field in pixels of the current object
+
+        Returns
+        -------
+        rotated_vrt : VRT
+            a new VRT object with copy of self in rotated_vrt.band_vrts. The rotation is a part
+            of self: rotated_vrt.vrt is self.vrt, and undo() restores the VRT before self.
+
+        """
+        rotated_vrt = VRT.from_gdal_dataset(self.dataset, geolocation=self.geolocation,
+                                                          metadata=self.dataset.GetMetadata())
+        source_vrt = self.copy()
+        rotated_vrt.band_vrts[source_vrt.filename] = source_vrt
+        rotated_vrt.vrt = source_vrt.vrt
+        rotated_vrt.tps = self.tps
+
+        angle_vrt = VRT.from_array(angle.astype(np.float32))
+        rotated_vrt.band_vrts[angle_vrt.filename] = angle_vrt
+        angle_src = {'SourceFilename': angle_vrt.filename,
+                     'SourceBand': 1,
+                     'DataType': gdal.GDT_Float32,
+                     'xSize': angle.shape[1],
+                     'ySize': angle.shape[0],
+                     'dstXSize': angle.shape[1] * step,
+                     'dstYSize': angle.shape[0] * step,
+                     'resampling': 'bilinear'}
+
+        rotated_bands = {}
+        for u_band, v_band in vector_pairs:
+            rotated_bands[u_band] = 'UVRotatedU'
+            rotated_bands[v_band] = 'UVRotatedV'
+
+        for i in range(source_vrt.dataset.RasterCount):
+            src = {'SourceFilename': source_vrt.filename, 'SourceBand': i + 1}
+            dst = source_vrt.dataset.GetRasterBand(i + 1).GetMetadata()
+            if 'PixelFunctionType' in dst:
+                dst.pop('PixelFunctionType')
+            if i + 1 in rotated_bands:
+                u_band, v_band = [pair for pair in vector_pairs if i + 1 in pair][0]
+                src = [{'SourceFilename': source_vrt.filename, 'SourceBand': u_band},
+                       {'SourceFilename': source_vrt.filename, 'SourceBand': v_band},
+                       angle_src]
+                dst['PixelFunctionType'] = rotated_bands[i + 1]
+                dst['dataType'] = source_vrt.dataset.GetRasterBand(i + 1).DataType
+                dst['SourceTransferType'] = gdal.GetDataTypeName(gdal.GDT_Float64)
+            rotated_vrt.create_band(src, dst)
+        rotated_vrt.dataset.FlushCache()
+
+        return rotated_vrt
+
     def get_subsampled_vrt(self, new_raster_x_size, new_raster_y_size, resample_alg):
         """Create VRT and replace step in the source"""
 
@@ -1743,12 +2106,18 @@ class VRT(object):
             Dataset=src['SourceFilename'],
             SourceBand=src['SourceBand'],
             SourceType=src['SourceType'],
+            Resampling=(' resampling="%s"' % src['resampling']
+                        if src.get('resampling') else ''),
             NODATA=src['NODATA'],
             ScaleOffset=src['ScaleOffset'],
             ScaleRatio=src['ScaleRatio'],
             LUT=src['LUT'],
             xSize=src['xSize'],
             ySize=src['ySize'],
+            dstXSize=src.get('dstXSize', src['xSize']),
+            dstYSize=src.get('dstYSize', src['ySize']),
+            dstXOff=src.get('dstXOff', 0),
+            dstYOff=src.get('dstYOff', 0),
             xOff=src.get('xOff', 0),
             yOff=src.get('yOff', 0),)
 
@@ -1897,3 +2266,7 @@ class VRT(object):
             new_meta[key] = value
 
         return new_meta
+
+
+if os.environ.get('NANSAT_CHECK_LEAKS'):
+    atexit.register(check_vsimem_leaks)
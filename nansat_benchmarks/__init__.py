@@ -0,0 +1,12 @@
+# ------------------------------------------------------------------------------
+# Name:     nansat_benchmarks
+# Purpose:  Performance benchmarks of Nansat on synthetic products
+#
+# Usage:
+#    python -m nansat_benchmarks --sizes small,medium
+#    python -m nansat_benchmarks --baseline baseline.json
+#
+# Licence:  This file is part of NANSAT. You can redistribute it or modify
+#           under the terms of GNU General Public License, v.3
+#           http://www.gnu.org/licenses/gpl-3.0.html
+# ------------------------------------------------------------------------------
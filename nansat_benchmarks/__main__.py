@@ -0,0 +1,5 @@
+import sys
+
+from nansat_benchmarks.benchmark import main
+
+sys.exit(main())
@@ -0,0 +1,259 @@
+# ------------------------------------------------------------------------------
+# Name:     benchmark.py
+# Purpose:  Time open, read, reproject, export and figure on synthetic products
+#
+# Licence:  This file is part of NANSAT. You can redistribute it or modify
+#           under the terms of GNU General Public License, v.3
+#           http://www.gnu.org/licenses/gpl-3.0.html
+# ------------------------------------------------------------------------------
+from __future__ import absolute_import, print_function
+import os
+import sys
+import json
+import time
+import shutil
+import argparse
+import datetime
+import platform
+import tempfile
+
+from nansat.utils import gdal
+from nansat.nansat import Nansat
+from nansat.domain import Domain
+from nansat.memprofile import MemoryProfile
+
+from nansat_benchmarks import fixtures
+
+# name : (fixture function, mapper, band to read)
+FIXTURES = {
+    'sentinel1': (fixtures.make_sentinel1_safe, 'sentinel1_l1', 'sigma0_VV'),
+    'model': (fixtures.make_netcdf_cf_model, 'netcdf_cf', 1),
+    'swath': (fixtures.make_swath, 'generic', 1),
+}
+
+OPERATIONS = ['open', 'read', 'reproject', 'export', 'figure']
+
+# size of the destination domain of reprojection (columns, rows)
+REPROJECT_SIZE = {'small': (500, 400), 'medium': (2000, 1600), 'large': (5000, 4000)}
+
+# slowdown relative to baseline reported as regression
+THRESHOLD = 1.2
+
+# keys of memory profile added to results (see nansat.memprofile). Only
+# growth during each case is compared: absolute GDAL cache and /vsimem peaks
+# include what is left by previous cases
+MEMORY_KEYS = ['rss_peak_delta', 'traced_peak_delta', 'gdal_cache_peak_delta',
+               'vsimem_peak_delta']
+
+
+def best_time(func, repeat):
+    """Return minimum of wall times of <repeat> calls of func"""
+    times = []
+    for i in range(repeat):
+        t0 = time.time()
+        func()
+        times.append(time.time() - t0)
+    return min(times)
+
+
+def run_fixture(fixture, size, workdir, repeat=3, operations=OPERATIONS, memory=False):
+    """Generate one fixture and time the operations on it
+
+    Parameters
+    ----------
+    fixture : str
+        key of FIXTURES
+    size : str
+        key of fixtures.SIZES
+    workdir : str
+        directory for the generated products and outputs
+    repeat : int
+        number of repetitions of each operation (best time is reported)
+    operations : list of str
+        subset of OPERATIONS
+    memory : bool
+        run each operation once more with memory profiling and add MEMORY_KEYS
+
+    Returns
+    -------
+    results : list of dict
+        fixture, size, operation and seconds (and memory) for each operation
+
+    """
+    make_fixture, mapper, band = FIXTURES[fixture]
+    filename = make_fixture(workdir, size)
+    out_file = os.path.join(workdir, '%s_%s' % (fixture, size))
+
+    def open_file():
+        return Nansat(filename, mapper=mapper)
+
+    def reproject():
+        n = open_file()
+        lon_min, lon_max, lat_min, lat_max = n.get_min_max_lon_lat()
+        d = Domain(4326, '-te %f %f %f %f -ts %d %d' % (
+            lon_min, lat_min, lon_max, lat_max, REPROJECT_SIZE[size][0],
+            REPROJECT_SIZE[size][1]))
+        n.reproject(d)
+        n[band]
+
+    steps = {
+        'open': open_file,
+        'read': lambda: open_file()[band],
+        'reproject': reproject,
+        'export': lambda: open_file().export(out_file + '.nc', bands=[band]),
+        'figure': lambda: open_file().write_figure(out_file + '.png', bands=band,
+                                                   clim='hist'),
+    }
+
+    results = []
+    for operation in operations:
+        result = {'fixture': fixture, 'size': size, 'operation': operation,
+                  'seconds': best_time(steps[operation], repeat)}
+        if memory:
+            with MemoryProfile(operation) as profile:
+                steps[operation]()
+            for key in MEMORY_KEYS:
+                result[key] = profile.record[key]
+        results.append(result)
+    return results
+
+
+def run(fixture_names, sizes, workdir=None, repeat=3, operations=OPERATIONS,
+        memory=False):
+    """Run benchmarks for all combinations of fixtures and sizes
+
+    Returns
+    -------
+    record : dict
+        time stamp, versions of software and results
+
+    """
+    record = {
+        'timestamp': datetime.datetime.utcnow().isoformat(),
+        'python': platform.python_version(),
+        'gdal': gdal.__version__,
+        'platform': platform.platform(),
+        'results': [],
+    }
+    tmp_dir = workdir or tempfile.mkdtemp(prefix='nansat_benchmarks_')
+    try:
+        for size in sizes:
+            for fixture in fixture_names:
+                fixture_dir = os.path.join(tmp_dir, '%s_%s' % (fixture, size))
+                if not os.path.exists(fixture_dir):
+                    os.makedirs(fixture_dir)
+                for result in run_fixture(fixture, size, fixture_dir, repeat,
+                                          operations, memory):
+                    print('%-10s %-7s %-10s %10.3f s' % (
+                        result['fixture'], result['size'], result['operation'],
+                        result['seconds']))
+                    record['results'].append(result)
+    finally:
+        if workdir is None:
+            shutil.rmtree(tmp_dir)
+    return record
+
+
+def append_history(record, filename):
+    """Append record as one JSON line to the history file"""
+    with open(filename, 'a') as history:
+        history.write(json.dumps(record, sort_keys=True) + '\n')
+
+
+def read_history(filename):
+    """Read all records from the history file"""
+    with open(filename) as history:
+        return [json.loads(line) for line in history if line.strip()]
+
+
+def compare(record, baseline, threshold=THRESHOLD):
+    """Compare results with baseline
+
+    Parameters
+    ----------
+    record : dict
+        output from run()
+    baseline : dict
+        output from run() stored earlier
+    threshold : float
+        ratio of values above which the operation is reported as regression
+
+    Returns
+    -------
+    regressions : list of dict
+        results slower or using more memory than baseline by more than
+        threshold, with 'metric' and 'ratio'
+
+    """
+    key = lambda r: (r['fixture'], r['size'], r['operation'])
+    baseline_results = dict((key(r), r) for r in baseline['results'])
+    regressions = []
+    for result in record['results']:
+        if key(result) not in baseline_results:
+            continue
+        for metric in ['seconds'] + MEMORY_KEYS:
+            value = result.get(metric)
+            baseline_value = baseline_results[key(result)].get(metric)
+            if value is None or baseline_value is None:
+                continue
+            # small values (e.g. memory growth of a few kB) are not compared
+            floor = 1e-3 if metric == 'seconds' else 2 ** 20
+            ratio = max(value, floor) / float(max(baseline_value, floor))
+            flag = ''
+            if ratio > threshold:
+                flag = 'REGRESSION'
+                regressions.append(dict(result, metric=metric, ratio=ratio))
+            print('%-10s %-7s %-10s %-18s %14.3f %6.2fx %s' % (
+                result['fixture'], result['size'], result['operation'], metric,
+                value, ratio, flag))
+    return regressions
+
+
+def main(args=None):
+    parser = argparse.ArgumentParser(
+        prog='nansat_benchmarks',
+        description='Time Nansat operations on synthetic products')
+    parser.add_argument('--fixtures', default=','.join(sorted(FIXTURES)),
+                        help='comma separated names of fixtures (%(default)s)')
+    parser.add_argument('--sizes', default='small',
+                        help='comma separated sizes: %s (%%(default)s)' %
+                             ','.join(sorted(fixtures.SIZES)))
+    parser.add_argument('--operations', default=','.join(OPERATIONS),
+                        help='comma separated operations (%(default)s)')
+    parser.add_argument('--repeat', type=int, default=3,
+                        help='repetitions of each operation, best time is used')
+    parser.add_argument('--workdir', default=None,
+                        help='keep generated fixtures and outputs in this directory')
+    parser.add_argument('--memory', action='store_true',
+                        help='profile peak memory of each operation')
+    parser.add_argument('--history', default=None,
+                        help='append results to this JSON-lines file')
+    parser.add_argument('--baseline', default=None,
+                        help='compare results with this JSON file')
+    parser.add_argument('--save-baseline', action='store_true',
+                        help='write results into the --baseline file')
+    parser.add_argument('--threshold', type=float, default=THRESHOLD,
+                        help='slowdown ratio reported as regression (%(default)s)')
+    options = parser.parse_args(args)
+
+    record = run(options.fixtures.split(','), options.sizes.split(','),
+                 options.workdir, options.repeat, options.operations.split(','),
+                 options.memory)
+
+    if options.history:
+        append_history(record, options.history)
+
+    if options.baseline and options.save_baseline:
+        with open(options.baseline, 'w') as baseline:
+            json.dump(record, baseline, indent=2, sort_keys=True)
+    elif options.baseline:
+        with open(options.baseline) as baseline:
+            regressions = compare(record, json.load(baseline), options.threshold)
+        if regressions:
+            print('%d regression(s) relative to baseline' % len(regressions))
+            return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
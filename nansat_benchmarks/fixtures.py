@@ -0,0 +1,318 @@
+# ------------------------------------------------------------------------------
+# Name:     fixtures.py
+# Purpose:  Synthetic products of realistic size for benchmarks
+#
+# Licence:  This file is part of NANSAT. You can redistribute it or modify
+#           under the terms of GNU General Public License, v.3
+#           http://www.gnu.org/licenses/gpl-3.0.html
+# ------------------------------------------------------------------------------
+from __future__ import absolute_import, division
+import os
+import datetime
+
+import numpy as np
+from netCDF4 import Dataset
+
+from nansat.utils import gdal
+
+# sizes of products (columns, rows)
+SIZES = {'small': (1000, 800),
+         'medium': (5000, 4000),
+         'large': (12000, 10000)}
+
+# random but reproducible data
+SEED = 42
+
+START_TIME = datetime.datetime(2020, 1, 1, 6, 0, 0)
+
+
+def _vector(values, fmt='%.6e'):
+    """Space separated values for XML"""
+    return ' '.join(fmt % value for value in values)
+
+
+def _grid(size, step):
+    """Coordinates from 0 to size-1 with given step (last included)"""
+    return np.unique(np.append(np.arange(0, size, step), size - 1))
+
+
+def _lonlat(pixel, line, x_size, y_size):
+    """Geolocation of a slightly rotated swath in the Barents Sea"""
+    x = pixel / float(x_size)
+    y = line / float(y_size)
+    lon = 20. + 6. * x + 1.5 * y
+    lat = 72. + 0.5 * x + 2.5 * y + 0.2 * x * y
+    return lon, lat
+
+
+def make_sentinel1_safe(path, size='small', polarizations=('VV', 'VH')):
+    """Create Sentinel-1 IW GRD-like SAFE directory
+
+    The SAFE has manifest, annotation, calibration and noise XML files
+    (with range and azimuth noise vectors) and GeoTIFFs with DN and GCPs
+    for each polarization.
+
+    Parameters
+    ----------
+    path : str
+        directory for the product
+    size : str
+        key of SIZES
+    polarizations : list of str
+
+    Returns
+    -------
+    filename : str
+        name of the SAFE directory
+
+    """
+    x_size, y_size = SIZES[size]
+    name = 'S1A_IW_GRDH_1SDV_%s_%s_030000_038000_04800A_%s.SAFE' % (
+        START_TIME.strftime('%Y%m%dT%H%M%S'),
+        (START_TIME + datetime.timedelta(seconds=25)).strftime('%Y%m%dT%H%M%S'),
+        size.upper())
+    filename = os.path.join(path, name)
+    for sub_dir in ['measurement', 'annotation/calibration']:
+        if not os.path.exists(os.path.join(filename, sub_dir)):
+            os.makedirs(os.path.join(filename, sub_dir))
+
+    with open(os.path.join(filename, 'manifest.safe'), 'w') as manifest:
+        manifest.write(MANIFEST_XML % {
+            'start': START_TIME.isoformat(),
+            'stop': (START_TIME + datetime.timedelta(seconds=25)).isoformat()})
+
+    # geolocation grid (as in real products: ~20 x 10 points)
+    pixels = _grid(x_size, max(1, x_size // 20))
+    lines = _grid(y_size, max(1, y_size // 10))
+    grid_points = []
+    gcps = []
+    for line in lines:
+        for pixel in pixels:
+            lon, lat = _lonlat(pixel, line, x_size, y_size)
+            incidence = 30. + 16. * pixel / x_size
+            grid_points.append(GRID_POINT_XML % {
+                'line': line, 'pixel': pixel, 'lon': lon, 'lat': lat,
+                'incidence': incidence, 'elevation': incidence - 3.})
+            gcps.append(gdal.GCP(lon, lat, 0, float(pixel), float(line)))
+
+    # calibration and noise vectors
+    cal_pixels = _grid(x_size, 40)
+    cal_lines = _grid(y_size, max(1, y_size // 20))
+    sigma_nought = 600. - 100. * cal_pixels / x_size
+    noise = 50. + 30. * np.cos(cal_pixels / 300.) ** 2
+    noise_lines = _grid(y_size, max(1, y_size // 50))
+
+    random = np.random.RandomState(SEED)
+    for pol in polarizations:
+        file_id = 's1a-iw-grd-%s-%s-%s-030000-038000-001' % (
+            pol.lower(), START_TIME.strftime('%Y%m%dt%H%M%S'),
+            (START_TIME + datetime.timedelta(seconds=25)).strftime('%Y%m%dt%H%M%S'))
+
+        with open(os.path.join(filename, 'annotation', file_id + '.xml'), 'w') as xml:
+            xml.write(ANNOTATION_XML % {'x_size': x_size, 'y_size': y_size,
+                                        'count': len(grid_points),
+                                        'points': ''.join(grid_points)})
+
+        vectors = ''.join(CALIBRATION_VECTOR_XML % {
+            'line': line,
+            'count': cal_pixels.size,
+            'pixel': _vector(cal_pixels, '%d'),
+            'sigma': _vector(sigma_nought),
+            'beta': _vector(np.ones(cal_pixels.size) * 470.)}
+            for line in cal_lines)
+        with open(os.path.join(filename, 'annotation', 'calibration',
+                               'calibration-' + file_id + '.xml'), 'w') as xml:
+            xml.write(CALIBRATION_XML % {'count': cal_lines.size,
+                                         'vectors': vectors})
+
+        vectors = ''.join(NOISE_VECTOR_XML % {
+            'line': line,
+            'count': cal_pixels.size,
+            'pixel': _vector(cal_pixels, '%d'),
+            'noise': _vector(noise)}
+            for line in cal_lines)
+        with open(os.path.join(filename, 'annotation', 'calibration',
+                               'noise-' + file_id + '.xml'), 'w') as xml:
+            xml.write(NOISE_XML % {
+                'count': cal_lines.size,
+                'vectors': vectors,
+                'last_line': y_size - 1,
+                'last_sample': x_size - 1,
+                'az_count': noise_lines.size,
+                'az_line': _vector(noise_lines, '%d'),
+                'az_lut': _vector(1. + 0.1 * np.sin(noise_lines / 500.))})
+
+        # DN with speckle, written in blocks to limit memory
+        tiff = gdal.GetDriverByName('GTiff').Create(
+            os.path.join(filename, 'measurement', file_id + '.tiff'),
+            x_size, y_size, 1, gdal.GDT_UInt16, ['TILED=NO'])
+        for y_off in range(0, y_size, 1000):
+            rows = min(1000, y_size - y_off)
+            dn = 100 * np.sqrt(random.exponential(1., (rows, x_size)))
+            tiff.GetRasterBand(1).WriteArray(dn.astype(np.uint16), 0, y_off)
+        tiff.SetGCPs(gcps, WGS84)
+        tiff = None
+
+    return filename
+
+
+def make_netcdf_cf_model(path, size='small', n_times=8):
+    """Create netCDF-CF file with gridded model fields (wind, temperature)
+
+    Parameters
+    ----------
+    path : str
+        directory for the file
+    size : str
+        key of SIZES
+    n_times : int
+        number of time steps
+
+    Returns
+    -------
+    filename : str
+
+    """
+    x_size, y_size = SIZES[size]
+    filename = os.path.join(path, 'model_%s.nc' % size)
+    random = np.random.RandomState(SEED)
+    with Dataset(filename, 'w') as ds:
+        ds.Conventions = 'CF-1.6'
+        ds.title = 'Synthetic model fields for Nansat benchmarks'
+        ds.createDimension('time', n_times)
+        ds.createDimension('latitude', y_size)
+        ds.createDimension('longitude', x_size)
+
+        var = ds.createVariable('time', 'f8', ('time',))
+        var.standard_name = 'time'
+        var.units = 'hours since %s' % START_TIME.isoformat()
+        var[:] = np.arange(n_times) * 3.
+        var = ds.createVariable('latitude', 'f4', ('latitude',))
+        var.standard_name = 'latitude'
+        var.units = 'degrees_north'
+        var[:] = np.linspace(80., 50., y_size)
+        var = ds.createVariable('longitude', 'f4', ('longitude',))
+        var.standard_name = 'longitude'
+        var.units = 'degrees_east'
+        var[:] = np.linspace(-20., 40., x_size)
+
+        for var_name, standard_name, units, mean, std in [
+                ('x_wind_10m', 'eastward_wind', 'm/s', 2., 6.),
+                ('y_wind_10m', 'northward_wind', 'm/s', -1., 6.),
+                ('air_temperature_2m', 'air_temperature', 'K', 275., 8.)]:
+            var = ds.createVariable(var_name, 'f4',
+                                    ('time', 'latitude', 'longitude'),
+                                    zlib=True, chunksizes=(1, min(256, y_size),
+                                                           min(256, x_size)))
+            var.standard_name = standard_name
+            var.units = units
+            smooth = np.cumsum(random.normal(0, 1, (y_size, x_size)), axis=1)
+            smooth = (smooth - smooth.mean()) / (smooth.std() + 1e-6)
+            for i in range(n_times):
+                var[i] = mean + std * np.roll(smooth, i * 10, axis=1)
+    return filename
+
+
+def make_swath(path, size='small'):
+    """Create MODIS-like L2 swath with full resolution geolocation arrays
+
+    Parameters
+    ----------
+    path : str
+        directory for the file
+    size : str
+        key of SIZES
+
+    Returns
+    -------
+    filename : str
+
+    """
+    x_size, y_size = SIZES[size]
+    filename = os.path.join(path, 'swath_%s.nc' % size)
+    random = np.random.RandomState(SEED)
+    pixel, line = np.meshgrid(np.arange(x_size, dtype=np.float32),
+                              np.arange(y_size, dtype=np.float32))
+    # swath edges are curved as in MODIS
+    pixel = pixel + 0.05 * x_size * ((pixel / x_size - 0.5) ** 3)
+    lon, lat = _lonlat(pixel, line, x_size, y_size)
+    with Dataset(filename, 'w') as ds:
+        ds.title = 'Synthetic swath for Nansat benchmarks'
+        ds.time_coverage_start = START_TIME.isoformat()
+        ds.time_coverage_end = (START_TIME +
+                                datetime.timedelta(minutes=5)).isoformat()
+        ds.createDimension('number_of_lines', y_size)
+        ds.createDimension('pixels_per_line', x_size)
+        dims = ('number_of_lines', 'pixels_per_line')
+        for var_name, standard_name, data in [
+                ('longitude', 'longitude', lon),
+                ('latitude', 'latitude', lat),
+                ('sst', 'sea_surface_temperature',
+                 285. + 3 * np.sin(lon / 2.) + random.normal(0, 0.2, lon.shape)),
+                ('chlor_a', 'mass_concentration_of_chlorophyll_a_in_sea_water',
+                 np.exp(random.normal(0, 1, lon.shape)))]:
+            var = ds.createVariable(var_name, 'f4', dims, zlib=True)
+            var.standard_name = standard_name
+            var[:] = data.astype(np.float32)
+    return filename
+
+
+WGS84 = ('GEOGCS["WGS 84",DATUM["WGS_1984",SPHEROID["WGS 84",6378137,'
+         '298.257223563]],PRIMEM["Greenwich",0],UNIT["degree",'
+         '0.0174532925199433]]')
+
+MANIFEST_XML = '''<?xml version="1.0" encoding="UTF-8"?>
+<xfdu:XFDU xmlns:xfdu="urn:ccsds:schema:xfdu:1" xmlns:safe="http://www.esa.int/safe/sentinel-1.0">
+  <metadataSection>
+    <metadataObject ID="acquisitionPeriod">
+      <metadataWrap><xmlData><safe:acquisitionPeriod>
+        <safe:startTime>%(start)s</safe:startTime>
+        <safe:stopTime>%(stop)s</safe:stopTime>
+      </safe:acquisitionPeriod></xmlData></metadataWrap>
+    </metadataObject>
+    <metadataObject ID="platform">
+      <metadataWrap><xmlData><safe:platform>
+        <safe:familyName>SENTINEL-1</safe:familyName>
+        <safe:number>A</safe:number>
+      </safe:platform></xmlData></metadataWrap>
+    </metadataObject>
+  </metadataSection>
+</xfdu:XFDU>
+'''
+
+ANNOTATION_XML = '''<?xml version="1.0" encoding="UTF-8"?>
+<product>
+  <imageAnnotation><imageInformation>
+    <numberOfSamples>%(x_size)d</numberOfSamples>
+    <numberOfLines>%(y_size)d</numberOfLines>
+  </imageInformation></imageAnnotation>
+  <geolocationGrid><geolocationGridPointList count="%(count)d">%(points)s
+  </geolocationGridPointList></geolocationGrid>
+</product>
+'''
+
+GRID_POINT_XML = '''
+    <geolocationGridPoint><line>%(line)d</line><pixel>%(pixel)d</pixel><latitude>%(lat).8f</latitude><longitude>%(lon).8f</longitude><height>0</height><incidenceAngle>%(incidence).6f</incidenceAngle><elevationAngle>%(elevation).6f</elevationAngle></geolocationGridPoint>'''
+
+CALIBRATION_XML = '''<?xml version="1.0" encoding="UTF-8"?>
+<calibration>
+  <calibrationVectorList count="%(count)d">%(vectors)s
+  </calibrationVectorList>
+</calibration>
+'''
+
+CALIBRATION_VECTOR_XML = '''
+    <calibrationVector><line>%(line)d</line><pixel count="%(count)d">%(pixel)s</pixel><sigmaNought count="%(count)d">%(sigma)s</sigmaNought><betaNought count="%(count)d">%(beta)s</betaNought></calibrationVector>'''
+
+NOISE_XML = '''<?xml version="1.0" encoding="UTF-8"?>
+<noise>
+  <noiseRangeVectorList count="%(count)d">%(vectors)s
+  </noiseRangeVectorList>
+  <noiseAzimuthVectorList count="1">
+    <noiseAzimuthVector><swath>IW1</swath><firstAzimuthLine>0</firstAzimuthLine><firstRangeSample>0</firstRangeSample><lastAzimuthLine>%(last_line)d</lastAzimuthLine><lastRangeSample>%(last_sample)d</lastRangeSample><line count="%(az_count)d">%(az_line)s</line><noiseAzimuthLut count="%(az_count)d">%(az_lut)s</noiseAzimuthLut></noiseAzimuthVector>
+  </noiseAzimuthVectorList>
+</noise>
+'''
+
+NOISE_VECTOR_XML = '''
+    <noiseRangeVector><line>%(line)d</line><pixel count="%(count)d">%(pixel)s</pixel><noiseRangeLut count="%(count)d">%(noise)s</noiseRangeLut></noiseRangeVector>'''
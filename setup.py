@@ -134,6 +134,7 @@ from setuptools import setup, find_packages
 from setuptools.command.install_scripts import install_scripts
 from distutils import log
 from distutils.extension import Extension
+from distutils.command.build_ext import build_ext
 from distutils.errors import CCompilerError, DistutilsExecError,\
     DistutilsPlatformError
 
@@ -189,21 +190,48 @@ else:
     ext_errors = (CCompilerError, DistutilsExecError, DistutilsPlatformError)
 
 
-def run_setup(skip_compile):
-    if skip_compile:
-        kw = dict()
-    else:
-        kw = dict(
-            ext_modules = [
-                Extension('{0}.{1}'.format(NAME, pixfun_module_name),
-                          ['{0}/pixelfunctions/pixelfunctions.c'.format(NAME),
-                           '{0}/pixelfunctions/{1}.c'.format(NAME, pixfun_module_name)],
-                          include_dirs=include_dirs,
-                          libraries=libraries,
-                          library_dirs=library_dirs,
-                          extra_compile_args=extra_compile_args,
-                          extra_link_args=extra_link_args)
-            ])
+class optional_build_ext(build_ext):
+    """Build each C extension separately: failure of one extension does not
+    remove the others"""
+    def build_extension(self, ext):
+        try:
+            build_ext.build_extension(self, ext)
+        except ext_errors as e:
+            print('*' * 75)
+            print('WARNING: The C extension %s could not be compiled, '
+                  'it will not be available.' % ext.name)
+            print(e)
+            print('*' * 75)
+
+
+def get_ext_modules(skip_compile):
+    """C extensions: pixel functions require GDAL, the other extensions are
+    built also when GDAL headers are not found"""
+    ext_modules = [
+        Extension('{0}._glcm'.format(NAME),
+                  ['{0}/glcm/_glcm.c'.format(NAME)],
+                  extra_compile_args=extra_compile_args),
+        Extension('{0}._edt'.format(NAME),
+                  ['{0}/edt/_edt.c'.format(NAME)],
+                  extra_compile_args=extra_compile_args),
+        Extension('{0}._scanfill'.format(NAME),
+                  ['{0}/scanfill/_scanfill.c'.format(NAME)],
+                  extra_compile_args=extra_compile_args)
+    ]
+    if not skip_compile:
+        ext_modules.insert(0, Extension(
+            '{0}.{1}'.format(NAME, pixfun_module_name),
+            ['{0}/pixelfunctions/pixelfunctions.c'.format(NAME),
+             '{0}/pixelfunctions/{1}.c'.format(NAME, pixfun_module_name)],
+            include_dirs=include_dirs,
+            libraries=libraries,
+            library_dirs=library_dirs,
+            extra_compile_args=extra_compile_args,
+            extra_link_args=extra_link_args))
+    return ext_modules
+
+
+def run_setup(ext_modules):
 
 
     # remove mapper_tests from installed packages
@@ -234,14 +262,15 @@ def run_setup(skip_compile):
                      'nansat_show',
                      'nansat_translate',
                      ]],
-        cmdclass = {'install_scripts': my_install_scripts},
+        cmdclass = {'install_scripts': my_install_scripts,
+                    'build_ext': optional_build_ext},
         install_requires=REQS,
         test_suite="nansat.tests",
-        **kw
+        ext_modules=ext_modules
     )
 
 try:
-    run_setup(skip_compile)
+    run_setup(get_ext_modules(skip_compile))
 except ext_errors:
     BUILD_EXT_WARNING = ("WARNING: The C extension could not be compiled, "
                          "pixel functions will not be available.")
@@ -251,7 +280,7 @@ except ext_errors:
     print("I'm retrying the build without the C extension now.")
     print('*' * 75)
 
-    run_setup(True)
+    run_setup([])
 
     print('*' * 75)
     print(BUILD_EXT_WARNING)